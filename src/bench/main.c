@@ -0,0 +1,439 @@
+/* /////////////////////////////////////////////////////////////////////////// */
+/* (c) copyright 2024 Lawrence D. Kern /////////////////////////////////////// */
+/* /////////////////////////////////////////////////////////////////////////// */
+
+#include <stdarg.h>
+#include <string.h>
+#include <shared.h>
+
+// NOTE: The kernel's freestanding memory functions are pulled in under other
+// names, so that they can be measured next to the C library's.
+#define memmove libc_memmove
+#define memcmp libc_memcmp
+#define memset libc_memset
+#define memcpy libc_memcpy
+#define strlen libc_strlen
+#define abort libc_abort
+#include <libc.h>
+#undef memmove
+#undef memcmp
+#undef memset
+#undef memcpy
+#undef strlen
+#undef abort
+
+#include "platform.h"
+
+// NOTE: Every measurement moves about BENCH_BYTES in total, split into as many
+// calls as the span size requires, and keeps the fastest of BENCH_REPEATS runs.
+#define BENCH_BYTES MEGABYTES(32)
+#define BENCH_REPEATS 3
+#define BENCH_SPAN_MAXIMUM MEGABYTES(8)
+#define BENCH_SLACK KILOBYTES(4)
+
+#define BENCH_CHECK_TRIALS 20000
+#define BENCH_CHECK_SPAN 2048
+
+global volatile int bench_sink;
+global u32 bench_random = 0x9E3779B9;
+
+function u32 random_u32(void)
+{
+   bench_random ^= bench_random << 13;
+   bench_random ^= bench_random >> 17;
+   bench_random ^= bench_random << 5;
+   return(bench_random);
+}
+
+// NOTE: Byte loops, as the memory functions were written before they moved to
+// words and string instructions. They double as the reference that the checks
+// compare against. The empty asm hides the pointer from the optimizer, which
+// would otherwise turn the loops back into calls to the C library.
+#define BENCH_OPAQUE(pointer) __asm__("" : "+r"(pointer))
+
+function void byte_zero(u8 *destination, u8 *source, size count)
+{
+   (void)source;
+   for(size index = 0; index < count; ++index)
+   {
+      destination[index] = 0;
+      BENCH_OPAQUE(destination);
+   }
+}
+
+function void byte_set(u8 *destination, u8 *source, size count)
+{
+   (void)source;
+   for(size index = 0; index < count; ++index)
+   {
+      destination[index] = 0x5A;
+      BENCH_OPAQUE(destination);
+   }
+}
+
+function void byte_copy(u8 *destination, u8 *source, size count)
+{
+   for(size index = 0; index < count; ++index)
+   {
+      destination[index] = source[index];
+      BENCH_OPAQUE(destination);
+   }
+}
+
+function void byte_move(u8 *destination, u8 *source, size count)
+{
+   if(destination < source)
+   {
+      byte_copy(destination, source, count);
+   }
+   else
+   {
+      for(size index = count; index != 0; --index)
+      {
+         destination[index - 1] = source[index - 1];
+         BENCH_OPAQUE(destination);
+      }
+   }
+}
+
+function int byte_compare(u8 *a, u8 *b, size count)
+{
+   for(size index = 0; index < count; ++index)
+   {
+      if(a[index] != b[index])
+      {
+         return((a[index] < b[index]) ? -1 : 1);
+      }
+      BENCH_OPAQUE(a);
+   }
+   return(0);
+}
+
+function void byte_compare_sink(u8 *a, u8 *b, size count) {bench_sink = byte_compare(a, b, count);}
+
+function void exo_zero(u8 *destination, u8 *source, size count) {(void)source; zero_memory(destination, count);}
+function void exo_set(u8 *destination, u8 *source, size count) {(void)source; libc_memset(destination, 0x5A, count);}
+function void exo_copy(u8 *destination, u8 *source, size count) {libc_memcpy(destination, source, count);}
+function void exo_move(u8 *destination, u8 *source, size count) {libc_memmove(destination, source, count);}
+function void exo_compare(u8 *a, u8 *b, size count) {bench_sink = libc_memcmp(a, b, count);}
+
+function void glibc_zero(u8 *destination, u8 *source, size count) {(void)source; memset(destination, 0, count);}
+function void glibc_set(u8 *destination, u8 *source, size count) {(void)source; memset(destination, 0x5A, count);}
+function void glibc_copy(u8 *destination, u8 *source, size count) {memcpy(destination, source, count);}
+function void glibc_move(u8 *destination, u8 *source, size count) {memmove(destination, source, count);}
+function void glibc_compare(u8 *a, u8 *b, size count) {bench_sink = memcmp(a, b, count);}
+
+typedef void bench_procedure(u8 *destination, u8 *source, size count);
+
+typedef struct {
+   char *name;
+
+   // NOTE: The old byte loop, the version used by exo, and the C library's.
+   bench_procedure *procedures[3];
+
+   // NOTE: Moves overlap, with the destination just past the source so that
+   // they have to copy backwards.
+   b32 overlapping;
+} bench_memory_operation;
+
+function int sign(int value)
+{
+   int result = (value > 0) - (value < 0);
+   return(result);
+}
+
+function b32 check_memory_functions(u8 *expected, u8 *actual, u8 *source)
+{
+   // NOTE: Compare each function against its byte loop on random alignments
+   // and lengths, including the bytes around the span, so that writing past
+   // either end is caught too. Lengths cross the word, vector and string
+   // instruction thresholds.
+   b32 result = true;
+
+   size buffer_size = BENCH_CHECK_SPAN + 2*BENCH_SLACK;
+   for(size index = 0; index < buffer_size; ++index)
+   {
+      source[index] = (u8)random_u32();
+   }
+
+   for(u32 trial = 0; result && trial < BENCH_CHECK_TRIALS; ++trial)
+   {
+      u32 type = trial % 5;
+      size offset = BENCH_SLACK + (random_u32() % 64);
+      size other = BENCH_SLACK + (random_u32() % 64);
+      size count = random_u32() % BENCH_CHECK_SPAN;
+      if(type == 3)
+      {
+         // NOTE: Overlapping moves in either direction.
+         other = offset + (random_u32() % 128) - 64;
+      }
+
+      for(size index = 0; index < buffer_size; ++index)
+      {
+         expected[index] = actual[index] = (u8)(index * 7);
+      }
+
+      switch(type)
+      {
+         case 0:
+         {
+            byte_zero(expected + offset, 0, count);
+            zero_memory(actual + offset, count);
+         } break;
+
+         case 1:
+         {
+            byte_set(expected + offset, 0, count);
+            libc_memset(actual + offset, 0x5A, count);
+         } break;
+
+         case 2:
+         {
+            byte_copy(expected + offset, source + other, count);
+            libc_memcpy(actual + offset, source + other, count);
+         } break;
+
+         case 3:
+         {
+            byte_move(expected + offset, expected + other, count);
+            libc_memmove(actual + offset, actual + other, count);
+         } break;
+
+         case 4:
+         {
+            // NOTE: Make the spans differ at a random position, if at all.
+            for(size index = 0; index < count; ++index)
+            {
+               actual[offset + index] = expected[other + index];
+            }
+            if(count && (random_u32() & 1))
+            {
+               actual[offset + (random_u32() % count)] ^= (u8)(1 + random_u32() % 255);
+            }
+
+            int wanted = byte_compare(actual + offset, expected + other, count);
+            int got = libc_memcmp(actual + offset, expected + other, count);
+            if(sign(wanted) != sign(got))
+            {
+               platform_log("CHECK memcmp failed: offset %td, other %td, count %td (%d instead of %d)\n",
+                            offset, other, count, got, wanted);
+               result = false;
+            }
+            continue;
+         } break;
+      }
+
+      for(size index = 0; result && index < buffer_size; ++index)
+      {
+         if(expected[index] != actual[index])
+         {
+            char *names[] = {"zero_memory", "memset", "memcpy", "memmove"};
+            platform_log("CHECK %s failed: offset %td, other %td, count %td (byte %td)\n",
+                         names[type], offset, other, count, index);
+            result = false;
+         }
+      }
+   }
+
+   if(result)
+   {
+      platform_log("CHECK %u random spans match the byte loops\n", BENCH_CHECK_TRIALS);
+   }
+
+   return(result);
+}
+
+function double measure_memory(bench_procedure *procedure, u8 *destination, u8 *source, size span)
+{
+   // NOTE: Returns gigabytes per second.
+   size calls = MAXIMUM(1, BENCH_BYTES / span);
+
+   u64 best_ns = (u64)-1;
+   for(u32 repeat = 0; repeat < BENCH_REPEATS; ++repeat)
+   {
+      u64 begin = platform_time_ns();
+      for(size call = 0; call < calls; ++call)
+      {
+         procedure(destination, source, span);
+      }
+      u64 elapsed = platform_time_ns() - begin;
+      best_ns = MINIMUM(best_ns, elapsed);
+   }
+
+   double result = (double)(calls * span) / (double)MAXIMUM(best_ns, 1);
+   return(result);
+}
+
+function void bench_memory(void)
+{
+   bench_memory_operation operations[] =
+   {
+      {"zero",    {byte_zero, exo_zero, glibc_zero}},
+      {"memset",  {byte_set, exo_set, glibc_set}},
+      {"memcpy",  {byte_copy, exo_copy, glibc_copy}},
+      {"memmove", {byte_move, exo_move, glibc_move}, true},
+      {"memcmp",  {byte_compare_sink, exo_compare, glibc_compare}},
+   };
+
+   size spans[] = {16, 64, 256, KILOBYTES(1), KILOBYTES(4), KILOBYTES(64), MEGABYTES(1), BENCH_SPAN_MAXIMUM};
+
+   size buffer_size = BENCH_SPAN_MAXIMUM + 2*BENCH_SLACK;
+   u8 *destination = platform_allocate(buffer_size);
+   u8 *source = platform_allocate(buffer_size);
+   u8 *check = platform_allocate(buffer_size);
+   assert(destination && source && check);
+
+   if(!check_memory_functions(check, destination, source))
+   {
+      platform_flush_log();
+      assert(0);
+   }
+
+   platform_log("MEMORY %-8s %10s %12s %12s %12s %8s\n", "", "span", "bytes GB/s", "exo GB/s", "libc GB/s", "speedup");
+   for(u32 operation_index = 0; operation_index < countof(operations); ++operation_index)
+   {
+      bench_memory_operation *operation = operations + operation_index;
+
+      // NOTE: Equal contents, so that memcmp has to look at every byte.
+      for(size index = 0; index < buffer_size; ++index)
+      {
+         destination[index] = source[index] = (u8)index;
+      }
+
+      for(u32 span_index = 0; span_index < countof(spans); ++span_index)
+      {
+         size span = spans[span_index];
+         u8 *to = destination + BENCH_SLACK;
+         u8 *from = (operation->overlapping) ? to - 1 : source + BENCH_SLACK;
+
+         double rates[countof(operation->procedures)];
+         for(u32 index = 0; index < countof(rates); ++index)
+         {
+            rates[index] = measure_memory(operation->procedures[index], to, from, span);
+         }
+
+         platform_log("MEMORY %-8s %10td %12.2f %12.2f %12.2f %7.1fx\n",
+                      operation->name, span, rates[0], rates[1], rates[2], rates[1] / rates[0]);
+      }
+   }
+}
+
+// NOTE: parallel_for scaling. A fixed, compute-bound workload is split into as
+// many equal slices as the thread count being measured, so that at most that
+// many threads can work on it at once, and the speedup is relative to running
+// it all on one. Each element's result is checked against a serial run.
+#define BENCH_JOB_ELEMENTS (1 << 22)
+#define BENCH_JOB_ROUNDS 64
+
+typedef struct {
+   u32 *results;
+   size count;
+   size slices;
+} bench_job_workload;
+
+function u32 hash_element(size index)
+{
+   u32 result = (u32)index;
+   for(u32 round = 0; round < BENCH_JOB_ROUNDS; ++round)
+   {
+      result = (result * 1664525u) + 1013904223u;
+      result ^= result >> 16;
+   }
+   return(result);
+}
+
+function void hash_slices(void *data, size first, size last)
+{
+   bench_job_workload *workload = (bench_job_workload *)data;
+   for(size slice = first; slice < last; ++slice)
+   {
+      size begin = (slice * workload->count) / workload->slices;
+      size end = ((slice + 1) * workload->count) / workload->slices;
+      for(size index = begin; index < end; ++index)
+      {
+         workload->results[index] = hash_element(index);
+      }
+   }
+}
+
+function void bench_jobs(void)
+{
+   u32 thread_count = platform_get_thread_count();
+
+   bench_job_workload workload = {0};
+   workload.count = BENCH_JOB_ELEMENTS;
+   workload.results = platform_allocate(workload.count * sizeof(u32));
+   assert(workload.results);
+
+   platform_log("JOBS %7s %12s %8s\n", "threads", "ms", "speedup");
+
+   double serial_ms = 0.0;
+   for(u32 threads = 1; threads <= thread_count; ++threads)
+   {
+      workload.slices = threads;
+
+      u64 best_ns = (u64)-1;
+      for(u32 repeat = 0; repeat < BENCH_REPEATS; ++repeat)
+      {
+         zero_memory(workload.results, workload.count * sizeof(u32));
+
+         u64 begin = platform_time_ns();
+         parallel_for(workload.slices, 1, hash_slices, &workload);
+         u64 elapsed = platform_time_ns() - begin;
+         best_ns = MINIMUM(best_ns, elapsed);
+      }
+
+      for(size index = 0; index < workload.count; ++index)
+      {
+         if(workload.results[index] != hash_element(index))
+         {
+            platform_log("CHECK parallel_for over %u threads failed at element %td\n", threads, index);
+            platform_flush_log();
+            assert(0);
+         }
+      }
+
+      double ms = (double)best_ns / 1e6;
+      if(threads == 1)
+      {
+         serial_ms = ms;
+      }
+      platform_log("JOBS %7u %12.3f %7.2fx\n", threads, ms, serial_ms / ms);
+   }
+}
+
+int main(int argument_count, char **arguments)
+{
+   // NOTE: Run every benchmark by default, or just the ones named.
+   b32 run_memory = (argument_count == 1);
+   b32 run_jobs = (argument_count == 1);
+   for(int index = 1; index < argument_count; ++index)
+   {
+      if(strcmp(arguments[index], "memory") == 0)
+      {
+         run_memory = true;
+      }
+      else if(strcmp(arguments[index], "jobs") == 0)
+      {
+         run_jobs = true;
+      }
+      else
+      {
+         platform_log("USAGE: bench [memory] [jobs]\n");
+         platform_flush_log();
+         return(1);
+      }
+   }
+
+   if(run_memory)
+   {
+      bench_memory();
+   }
+   if(run_jobs)
+   {
+      bench_jobs();
+   }
+
+   platform_flush_log();
+   return(0);
+}
@@ -17,28 +17,31 @@ KEYWORDS_NAMES
 
 function char *intern_string_length(char *data, size length)
 {
-   char *result = 0;
-
    string8 string = {(u8 *)data, length};
+   hashed_string8 key = string8hashed(string);
+
+   u64 mask = STRING_TABLE_COUNT - 1;
+   u64 index = key.hash & mask;
 
-   // TODO: Replace this with a hash lookup.
-   for(size index = 0; index < global_strings.count; index++)
+   hashed_string8 *slot = global_strings.strings + index;
+   while(slot->string.data)
    {
-      string8 compare = global_strings.strings[index];
-      if(string8equals(string, compare))
+      if(hashed_string8equals(*slot, key))
       {
-         result = (char *)compare.data;
-         break;
+         return((char *)slot->string.data);
       }
-   }
 
-   if(!result)
-   {
-      string8 string8result = string8allocate(&string_arena, (u8 *)data, length);
-      global_strings.strings[global_strings.count++] = string8result;
-      result = (char *)string8result.data;
+      index = (index + 1) & mask;
+      slot = global_strings.strings + index;
    }
 
+   assert(global_strings.count < (STRING_TABLE_COUNT / 2));
+   global_strings.count++;
+
+   slot->string = string8allocate(&string_arena, (u8 *)data, length);
+   slot->hash = key.hash;
+
+   char *result = (char *)slot->string.data;
    return(result);
 }
 
@@ -295,7 +298,16 @@ function void lex(text_stream text)
          break;
       }
 
-      global_tokens.tokens[global_tokens.count++] = token;
+      lexical_token *slot = arena_allocate(&token_arena, lexical_token, 1);
+      assert(slot);
+
+      if(!global_tokens.tokens)
+      {
+         global_tokens.tokens = slot;
+      }
+
+      *slot = token;
+      global_tokens.count++;
    }
 }
 
@@ -173,11 +173,17 @@ typedef struct {
 typedef struct {
    size index;
    size count;
-   lexical_token tokens[4096];
+
+   // NOTE: Tokens are appended to token_arena as they're lexed. Nothing else
+   // is allocated from it, so they stay contiguous.
+   lexical_token *tokens;
 } token_stream;
 
+// NOTE: The string table is open addressed with linear probing. It's kept at
+// most half full, so probe sequences stay short.
+#define STRING_TABLE_COUNT 8192
+
 typedef struct {
-   size index;
    size count;
-   string8 strings[4096];
+   hashed_string8 strings[STRING_TABLE_COUNT];
 } string_table;
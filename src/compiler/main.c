@@ -5,9 +5,10 @@
 #include <stdarg.h>
 #include <shared.h>
 
-#define syntax_error(format, ...) do { platform_log("SYNTAX ERROR: " format, ##__VA_ARGS__); assert(0); } while(0)
+#define syntax_error(format, ...) do { platform_log("SYNTAX ERROR: " format, ##__VA_ARGS__); platform_flush_log(); assert(0); } while(0)
 
 global arena text_arena;
+global arena source_arena;
 global arena string_arena;
 global arena token_arena;
 global arena ast_arena;
@@ -20,22 +21,23 @@ global arena ast_arena;
 
 function arena generate_arena(size cap)
 {
-   u8 *base = platform_allocate(cap);
-   assert(base);
-
+   // NOTE: Arenas only reserve address space, and commit memory as they fill
+   // up. The reservations can be generous without costing anything for small
+   // inputs.
    arena result;
-   arena_initialize(&result, base, cap);
+   b32 reserved = arena_reserve(&result, cap);
+   assert(reserved);
 
    return(result);
 }
 
-function text_stream generate_text_stream(arena *a, char *path)
+function text_stream generate_text_stream(mapped_file *file)
 {
-   string8 file = platform_load_file(a, path);
-
+   // NOTE: The lexer reads straight out of the file view, relying on the zero
+   // byte that always follows the contents to stop scanning.
    text_stream result = {0};
-   result.count = file.length;
-   result.characters = (char *)file.data;
+   result.count = file->contents.length;
+   result.characters = (char *)file->contents.data;
 
    return(result);
 }
@@ -48,39 +50,107 @@ int main(int argument_count, char **arguments)
    }
    else
    {
-      text_arena   = generate_arena(KILOBYTES(64));
-      string_arena = generate_arena(KILOBYTES(64));
-      token_arena  = generate_arena(MEGABYTES(1));
-      ast_arena    = generate_arena(KILOBYTES(64));
+      text_arena   = generate_arena(GIGABYTES(4));
+      source_arena = generate_arena(GIGABYTES(16));
+      string_arena = generate_arena(GIGABYTES(1));
+      token_arena  = generate_arena(GIGABYTES(16));
+      ast_arena    = generate_arena(GIGABYTES(16));
 
       // NOTE: Initialize the keyword global values with interned strings.
 #define X(keyword) keyword_##keyword = intern_stringz(#keyword);
       KEYWORDS_NAMES;
 #undef X
 
+      // NOTE: The first source file is mapped, and every file after it is
+      // loaded in the background while the ones before it compile. Prefetched
+      // files stay in the source arena until the end.
+      platform_io_batch prefetch = {&source_arena};
+      for(int source_file_index = 2; source_file_index < argument_count && prefetch.count < PLATFORM_IO_BATCH_COUNT; source_file_index++)
+      {
+         queue_file_load(&prefetch, arguments[source_file_index]);
+      }
+      platform_submit_io(&prefetch);
+
+      // NOTE: Each phase is totalled across every source file, and the totals
+      // are logged at the end alongside the arena statistics.
+      performance_sample load_performance = {0};
+      performance_sample lex_performance = {0};
+      performance_sample parse_performance = {0};
+      performance_sample codegen_performance = {0};
+      performance_sample print_performance = {0};
+
       for(int source_file_index = 1; source_file_index < argument_count; source_file_index++)
       {
          char *path = arguments[source_file_index];
          platform_log("COMPILING SOURCE FILE: %s\n", path);
 
-         text_stream text = generate_text_stream(&text_arena, path);
+         performance_sample begin = sample_performance();
+
+         mapped_file source = {0};
+         u32 prefetch_index = (u32)(source_file_index - 2);
+         if(source_file_index > 1 && prefetch_index < prefetch.count)
+         {
+            source.contents = wait_for_io(&prefetch, prefetch_index)->contents;
+         }
+         else
+         {
+            source = platform_map_file(&text_arena, path);
+         }
+
+         text_stream text = generate_text_stream(&source);
+
+         performance_sample end = sample_performance();
+         accumulate_performance(&load_performance, begin, end);
 
          // NOTE: Tokenize source code text stream.
+         begin = end;
          lex(text);
+         end = sample_performance();
+         accumulate_performance(&lex_performance, begin, end);
+
+         begin = end;
          print_token_stream();
+         end = sample_performance();
+         accumulate_performance(&print_performance, begin, end);
 
          // NOTE: Parse tokens to generate AST.
+         begin = end;
          ast_program program = parse_program(&global_tokens);
+         end = sample_performance();
+         accumulate_performance(&parse_performance, begin, end);
+
+         begin = end;
          ast_print_program(&program);
+         end = sample_performance();
+         accumulate_performance(&print_performance, begin, end);
 
          // NOTE: Generate assembly code from AST.
+         begin = end;
          generate_asm_program(&program);
+         end = sample_performance();
+         accumulate_performance(&codegen_performance, begin, end);
 
          // NOTE: The text and token arenas can be flushed between source code
          // files. Just the string table and AST should stick around.
+         platform_unmap_file(&source);
          arena_reset(&text_arena);
          arena_reset(&token_arena);
+
+         token_stream cleared_tokens = {0};
+         global_tokens = cleared_tokens;
       }
+
+      log_arena_statistics("text", &text_arena);
+      log_arena_statistics("source", &source_arena);
+      log_arena_statistics("string", &string_arena);
+      log_arena_statistics("token", &token_arena);
+      log_arena_statistics("ast", &ast_arena);
+
+      log_performance_statistics("load", &load_performance);
+      log_performance_statistics("lex", &lex_performance);
+      log_performance_statistics("parse", &parse_performance);
+      log_performance_statistics("codegen", &codegen_performance);
+      log_performance_statistics("print", &print_performance);
    }
 
    return(0);
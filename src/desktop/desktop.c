@@ -1,8 +1,13 @@
 /* (c) copyright 2024 Lawrence D. Kern /////////////////////////////////////// */
 
 #include "desktop.h"
+#include "platform.h"
 #include "renderer.h"
 #include "text.c"
+#include "profiler.c"
+#include "texture_pool.c"
+#include "terminal.c"
+#include "ui.c"
 
 function bool is_pressed(input_state button)
 {
@@ -29,39 +34,57 @@ function bool was_released(input_state button)
    return(result);
 }
 
-function rectangle create_rectangle(s32 x, s32 y, s32 width, s32 height)
+function bool input_changed(desktop_input *input)
 {
-   rectangle result = {x, y, width, height};
+   // NOTE: Check if anything was reported by the host since the previous
+   // frame, either through the mouse moving or a button changing state.
+   bool result = (input->mousex != input->previous_mousex ||
+                  input->mousey != input->previous_mousey);
+
+   result = result || input->text_length > 0 || input->wheel_delta != 0;
+
+   for(u32 key_index = 0; !result && key_index < INPUT_KEY_COUNT; ++key_index)
+   {
+      result = input->keys[key_index].changed_state;
+   }
+
    return(result);
 }
 
-function bool in_rectangle(rectangle rect, s32 x, s32 y)
+function void schedule_desktop_wakeup(desktop_context *desktop, float seconds)
 {
-   bool result = (x >= rect.x && x < (rect.x + rect.width) &&
-                  y >= rect.y && y < (rect.y + rect.height));
+   // NOTE: Request another update after the given delay, even if no input
+   // arrives in the meantime. The earliest pending request wins.
+   double wakeup = desktop->input.time_seconds + MAXIMUM(seconds, 0.0f);
+   if(desktop->wakeup_time_seconds == 0.0 || wakeup < desktop->wakeup_time_seconds)
+   {
+      desktop->wakeup_time_seconds = wakeup;
+   }
+}
 
-   return(result);
+function void compute_idle_timeout(desktop_context *desktop)
+{
+   desktop->idle_timeout_ms = -1;
+   if(desktop->animations.count > 0)
+   {
+      desktop->idle_timeout_ms = 0;
+   }
+   else if(desktop->wakeup_time_seconds != 0.0)
+   {
+      double remaining_ms = (desktop->wakeup_time_seconds - desktop->input.time_seconds) * 1000.0;
+      desktop->idle_timeout_ms = (s32)MAXIMUM(remaining_ms + 0.5, 0.0);
+   }
 }
 
-function texture load_bitmap(desktop_context *desktop, char *file_path, u32 offsetx, u32 offsety)
+function texture load_bitmap(desktop_context *desktop, string8 file, u32 offsetx, u32 offsety)
 {
    texture result = {0};
    result.offsetx = offsetx;
    result.offsety = offsety;
 
-   FILE *file = fopen(file_path, "rb");
-   assert(file);
-
-   fseek(file, 0, SEEK_END);
-   size_t size = ftell(file);
-   fseek(file, 0, SEEK_SET);
-
-   arena_marker marker = arena_marker_set(&desktop->scratch_arena);
-   u8 *memory = (u8 *)arena_allocate(&desktop->scratch_arena, u8, size);
-
-   size_t bytes_read = fread(memory, 1, size, file);
-   assert(bytes_read == size);
+   assert(file.length >= (size)sizeof(bitmap_header));
 
+   u8 *memory = file.data;
    bitmap_header *header = (bitmap_header *)memory;
 
    assert(header->file_type == 0x4D42); // "BM"
@@ -98,9 +121,6 @@ function texture load_bitmap(desktop_context *desktop, char *file_path, u32 offs
       row -= result.width;
    }
 
-   arena_marker_restore(marker);
-   fclose(file);
-
    return(result);
 }
 
@@ -195,10 +215,10 @@ function void compute_region_size(rectangle *result, desktop_window *window, win
 
 #endif
 
-function rectangle get_canvas_rect(desktop_window *window)
+function rectangle get_canvas_rect(rectangle bounds, bool display_infobar)
 {
    // TODO: Consolidate border thickness information.
-   rectangle result = window->bounds;
+   rectangle result = bounds;
 
    result.x += 1;
    result.y += DESKTOP_WINDOW_DIM_TITLEBAR + 1;
@@ -206,7 +226,7 @@ function rectangle get_canvas_rect(desktop_window *window)
    result.width -= 2;
    result.height -= (DESKTOP_WINDOW_DIM_TITLEBAR + 2);
 
-   if(window->display_infobar)
+   if(display_infobar)
    {
       result.y += DESKTOP_WINDOW_DIM_TITLEBAR + 1;
       result.height -= (DESKTOP_WINDOW_DIM_TITLEBAR + 2);
@@ -225,19 +245,7 @@ function void draw_outline_rect(texture *destination, rectangle bounds, vec4 col
    draw_outline(destination, bounds.x, bounds.y, bounds.width, bounds.height, color);
 }
 
-#if 0
-function DRAW_REGION(draw_border_n);
-function DRAW_REGION(draw_border_s);
-function DRAW_REGION(draw_border_w);
-function DRAW_REGION(draw_border_e);
-function DRAW_REGION(draw_corner_nw);
-function DRAW_REGION(draw_corner_ne);
-function DRAW_REGION(draw_corner_sw);
-function DRAW_REGION(draw_corner_se);
-function DRAW_REGION(draw_content);
-function DRAW_REGION(draw_titlebar);
-
-window_region_entry region_invariants[] =
+global window_region_entry region_invariants[] =
 {
    // IMPORTANT(law): Keep these entries in the same order as the
    // window_region_type enum. Or switch back to C for array designated
@@ -245,21 +253,21 @@ window_region_entry region_invariants[] =
    {WINDOW_INTERACTION_CLOSE,     CURSOR_ARROW},
    {WINDOW_INTERACTION_MAXIMIZE,  CURSOR_ARROW},
    {WINDOW_INTERACTION_MINIMIZE,  CURSOR_ARROW},
-   {WINDOW_INTERACTION_MOVE,      CURSOR_MOVE, draw_titlebar},
-   {WINDOW_INTERACTION_RAISE,     CURSOR_ARROW, draw_content},
-
-   {WINDOW_INTERACTION_RESIZE_NW, CURSOR_RESIZE_DIAG_L, draw_corner_nw},
-   {WINDOW_INTERACTION_RESIZE_NE, CURSOR_RESIZE_DIAG_R, draw_corner_ne},
-   {WINDOW_INTERACTION_RESIZE_SW, CURSOR_RESIZE_DIAG_R, draw_corner_sw},
-   {WINDOW_INTERACTION_RESIZE_SE, CURSOR_RESIZE_DIAG_L, draw_corner_se},
-
-   {WINDOW_INTERACTION_RESIZE_N,  CURSOR_RESIZE_VERT, draw_border_n},
-   {WINDOW_INTERACTION_RESIZE_S,  CURSOR_RESIZE_VERT, draw_border_s},
-   {WINDOW_INTERACTION_RESIZE_W,  CURSOR_RESIZE_HORI, draw_border_w},
-   {WINDOW_INTERACTION_RESIZE_E,  CURSOR_RESIZE_HORI, draw_border_e},
+   {WINDOW_INTERACTION_MOVE,      CURSOR_MOVE},
+   {WINDOW_INTERACTION_RAISE,     CURSOR_ARROW},
+
+   {WINDOW_INTERACTION_RESIZE_NW, CURSOR_RESIZE_DIAG_L},
+   {WINDOW_INTERACTION_RESIZE_NE, CURSOR_RESIZE_DIAG_R},
+   {WINDOW_INTERACTION_RESIZE_SW, CURSOR_RESIZE_DIAG_R},
+   {WINDOW_INTERACTION_RESIZE_SE, CURSOR_RESIZE_DIAG_L},
+
+   {WINDOW_INTERACTION_RESIZE_N,  CURSOR_RESIZE_VERT},
+   {WINDOW_INTERACTION_RESIZE_S,  CURSOR_RESIZE_VERT},
+   {WINDOW_INTERACTION_RESIZE_W,  CURSOR_RESIZE_HORI},
+   {WINDOW_INTERACTION_RESIZE_E,  CURSOR_RESIZE_HORI},
 };
 
-
+#if 0
 #define HLDIM 2
 
 function DRAW_REGION(draw_border_n)
@@ -356,585 +364,1735 @@ function DRAW_REGION(draw_titlebar)
 }
 #endif
 
-function bool is_window_visible(desktop_window *window)
+function bool is_window_visible(window_table *windows, u32 index)
 {
-   bool result = (window->state != WINDOW_STATE_CLOSED && window->state != WINDOW_STATE_MINIMIZED);
+   window_state state = windows->state[index];
+   bool result = (state != WINDOW_STATE_CLOSED && state != WINDOW_STATE_MINIMIZED);
    return(result);
 }
 
-function rectangle get_close_button_rect(desktop_window *window)
+function window_handle get_window_handle(window_table *windows, u32 index)
 {
-   int x = window->x + window->width - 20;
-   int y = window->y + 6;
-   int width = 9;
-   int height = 9;
+   window_handle result;
+   result.value = ((u32)windows->generation[index] << WINDOW_HANDLE_INDEX_BITS) | index;
 
-   return create_rectangle(x, y, width, height);
+   return(result);
 }
 
-function rectangle get_maximize_button_rect(desktop_window *window)
+function u32 get_window_index(window_table *windows, window_handle handle)
 {
-   rectangle result = get_close_button_rect(window);
-   result.x -= 16;
+   // NOTE: Resolve a handle to its slot, or DESKTOP_WINDOW_NULL_INDEX if the
+   // handle is null or the window it referred to has since been closed.
+   u32 result = DESKTOP_WINDOW_NULL_INDEX;
+
+   u32 index = handle.value & WINDOW_HANDLE_INDEX_MASK;
+   u32 generation = handle.value >> WINDOW_HANDLE_INDEX_BITS;
+
+   if(generation && index < windows->slot_count && windows->generation[index] == generation)
+   {
+      result = index;
+   }
 
    return(result);
 }
 
-function rectangle get_titlebar_rect(desktop_window *window)
+function bool is_window_handle(window_table *windows, window_handle handle, u32 index)
 {
-   return create_rectangle(window->x, window->y, window->width, DESKTOP_WINDOW_DIM_TITLEBAR);
+   bool result = (get_window_index(windows, handle) == index);
+   return(result);
 }
 
-function rectangle resize_rectangle(rectangle rect, int offset)
+function rectangle get_close_button_rect(window_table *windows, u32 index)
 {
-   rectangle result = rect;
-   result.x -= offset;
-   result.y -= offset;
+   rectangle bounds = windows->bounds[index];
 
-   result.width += (offset*2);
-   result.height += (offset*2);
+   int x = bounds.x + bounds.width - 20;
+   int y = bounds.y + 6;
+   int width = 9;
+   int height = 9;
 
-   return(result);
+   return create_rectangle(x, y, width, height);
 }
 
-function void draw_window(desktop_context *desktop, desktop_window *window, texture *destination)
+function rectangle get_maximize_button_rect(window_table *windows, u32 index)
 {
-   if(is_window_visible(window))
-   {
-      int window_width  = MAXIMUM(MINIMUM(window->width, desktop->backbuffer.width), 100);
-      int window_height = MAXIMUM(MINIMUM(window->height, desktop->backbuffer.height), 100);
-
-      int x = window->x;
-      int y = window->y;
+   rectangle result = get_close_button_rect(windows, index);
+   result.x -= 16;
 
-	  vec4 color0 = (desktop->config.dark_mode) ? DEBUG_COLOR_BLACK : DEBUG_COLOR_WHITE;
-	  vec4 color1 = (desktop->config.dark_mode) ? DEBUG_COLOR_WHITE : DEBUG_COLOR_BLACK;
+   return(result);
+}
 
-      draw_outline(destination, x, y, window_width, window_height, color1);
-      draw_outline(destination, x+window_width, y+1, 1, window_height, color1);
-      draw_outline(destination, x+1, y+window_height, window_width, 1, color1);
-      draw_rectangle(destination, x+1, y+1, window_width-2, window_height-2, color0);
+function rectangle get_minimize_button_rect(window_table *windows, u32 index)
+{
+   rectangle result = get_maximize_button_rect(windows, index);
+   result.x -= 16;
 
-      if(window == desktop->active_window)
-      {
-         draw_outline(destination, x, y, window_width, window_height, DEBUG_COLOR_BLUE);
-      }
+   return(result);
+}
 
-      // NOTE: Draw title bar.
-      {
-         int w = window_width;
-         int h = DESKTOP_WINDOW_DIM_TITLEBAR;
+function rectangle get_titlebar_rect(window_table *windows, u32 index)
+{
+   rectangle bounds = windows->bounds[index];
+   return create_rectangle(bounds.x, bounds.y, bounds.width, DESKTOP_WINDOW_DIM_TITLEBAR);
+}
 
-         draw_rectangle(destination, x+1, y+h-1, w-2, 1, color1);
-         // draw_rectangle(destination, x+1, y+h+1, w-2, 1, color1);
-         if(window == desktop->hot_window)
-         {
-            for(int index = 0; index < 6; index++)
-            {
-               int offset = (index * 2) + 5;
-               draw_rectangle(destination, x+2, y+offset, w-4, 1, color1);
-            }
+function u32 get_window_region(window_table *windows, u32 index, s32 x, s32 y)
+{
+   // NOTE: Classify a point inside the window bounds. The borders and corners
+   // are bands along the inside of the window edge, so they share the window's
+   // hit testing. Maximized windows can't be resized.
+   u32 result = DESKTOP_REGION_NULL_INDEX;
 
-            rectangle close = get_close_button_rect(window);
-            draw_rectangle_rect(destination, close, color0);
-            draw_outline_rect(destination, resize_rectangle(close, 1), color1);
-            draw_outline_rect(destination, resize_rectangle(close, 2), color0);
+   rectangle bounds = windows->bounds[index];
+   if(!in_rectangle(bounds, x, y))
+   {
+      return(result);
+   }
 
-            rectangle maximize = get_maximize_button_rect(window);
-            draw_rectangle_rect(destination, maximize, color0);
-            draw_outline_rect(destination, resize_rectangle(maximize, 1), color1);
-            draw_outline_rect(destination, resize_rectangle(maximize, 2), color0);
-         }
+   s32 e = DESKTOP_WINDOW_DIM_EDGE;
+   s32 c = DESKTOP_WINDOW_DIM_CORNER;
 
-         rectangle rect;
-         get_text_bounds(&rect, window->title);
+   s32 left = x - bounds.x;
+   s32 top = y - bounds.y;
+   s32 right = (bounds.x + bounds.width - 1) - x;
+   s32 bottom = (bounds.y + bounds.height - 1) - y;
 
-         int textx = x + w/2 - rect.width/2;
-         int texty = ALIGN_TEXT_VERTICALLY(y+1, h);
+   bool n = (top < e);
+   bool s = (bottom < e);
+   bool w = (left < e);
+   bool east = (right < e);
 
-         draw_rectangle(destination, textx-4, texty-1, rect.width+8, rect.height+2, color0);
-         draw_text(destination, textx, texty, color1, window->title);
+   if(in_rectangle(get_close_button_rect(windows, index), x, y))
+   {
+      result = WINDOW_REGION_BUTTON_CLOSE;
+   }
+   else if(in_rectangle(get_maximize_button_rect(windows, index), x, y))
+   {
+      result = WINDOW_REGION_BUTTON_MAXIMIZE;
+   }
+   else if(in_rectangle(get_minimize_button_rect(windows, index), x, y))
+   {
+      result = WINDOW_REGION_BUTTON_MINIMIZE;
+   }
+   else if(windows->state[index] != WINDOW_STATE_MAXIMIZED && (n || s || w || east))
+   {
+      if((n && left < c) || (w && top < c))
+      {
+         result = WINDOW_REGION_CORNER_NW;
       }
-
-      // NOTE: Draw info bar.
-      if(window->display_infobar)
+      else if((n && right < c) || (east && top < c))
       {
-         int w = window_width;
-         int h = DESKTOP_WINDOW_DIM_TITLEBAR;
-         int infoy = y + h;
-
-         draw_rectangle(destination, x+1, infoy+h-1, w-2, 1, color1);
-         draw_rectangle(destination, x+1, infoy+h+1, w-2, 1, color1);
+         result = WINDOW_REGION_CORNER_NE;
       }
-
-      // NOTE: Draw canvas.
+      else if((s && left < c) || (w && bottom < c))
       {
-         rectangle bounds = get_canvas_rect(window);
-         draw_rectangle_rect(destination, bounds, PALETTE[4]);
-
-         texture *canvas = &window->canvas;
-         clear(canvas, color0);
-
-         s32 x = 3;
-         s32 y = 6;
-
-         char text_line[64];
-         char *format = "{x:%d y:%d w:%d h:%d}";
-
-         int length = sprintf(text_line, format, window->x, window->y, window->width, window->height);
-         draw_text_line(canvas, x, &y, color1, string8new((u8 *)text_line, length));
-
-         length = sprintf(text_line, format, bounds.x, bounds.y, bounds.width, bounds.height);
-         draw_text_line(canvas, x, &y, color1, string8new((u8 *)text_line, length));
-
-         length = sprintf(text_line, "state:%d", window->state);
-         draw_text_line(canvas, x, &y, color1, string8new((u8 *)text_line, length));
-
-         y = ADVANCE_TEXT_LINE(y);
-         draw_text_line(canvas, x, &y, color1, string8("+----------------------------+"));
-         draw_text_line(canvas, x, &y, color1, string8("| ASCII FONT TEST            |"));
-         draw_text_line(canvas, x, &y, color1, string8("|----------------------------|"));
-         draw_text_line(canvas, x, &y, color1, string8("| ABCDEFGHIJKLMNOPQRSTUVWXYZ |"));
-         draw_text_line(canvas, x, &y, color1, string8("| abcdefghijklmnopqrstuvwxyz |"));
-         draw_text_line(canvas, x, &y, color1, string8("| AaBbCcDdEeFfGgHhIiJjKkLlMm |"));
-         draw_text_line(canvas, x, &y, color1, string8("| NnOoPpQqRrSsTtUuVvWwXxYyZz |"));
-         draw_text_line(canvas, x, &y, color1, string8("| 0123456789!\"#$%&'()*+,-./: |"));
-         draw_text_line(canvas, x, &y, color1, string8("| ;<=>?@[\\]^_`{|}~           |"));
-         draw_text_line(canvas, x, &y, color1, string8("+----------------------------+"));
-
-         draw_texture_bounded(destination, canvas, bounds.x, bounds.y, bounds.width, bounds.height);
+         result = WINDOW_REGION_CORNER_SW;
+      }
+      else if((s && right < c) || (east && bottom < c))
+      {
+         result = WINDOW_REGION_CORNER_SE;
+      }
+      else if(n)
+      {
+         result = WINDOW_REGION_BORDER_N;
+      }
+      else if(s)
+      {
+         result = WINDOW_REGION_BORDER_S;
+      }
+      else if(w)
+      {
+         result = WINDOW_REGION_BORDER_W;
+      }
+      else
+      {
+         result = WINDOW_REGION_BORDER_E;
       }
    }
+   else if(top < DESKTOP_WINDOW_DIM_TITLEBAR)
+   {
+      result = WINDOW_REGION_TITLEBAR;
+   }
+   else
+   {
+      result = WINDOW_REGION_CONTENT;
+   }
+
+   return(result);
 }
 
-function void get_default_window_location(desktop_context *desktop, s32 *posx, s32 *posy)
+function bool is_resize_interaction(window_interaction_type interaction)
 {
-   static s32 x = 120;
-   static s32 y = 80;
-
-   *posx = x;
-   *posy = y;
+   bool result = (interaction >= WINDOW_INTERACTION_RESIZE_N && interaction <= WINDOW_INTERACTION_RESIZE_SE);
+   return(result);
+}
 
-   x -= 32/2;
-   y += 20/2;
+function bool is_window_resizing(desktop_context *desktop, u32 index)
+{
+   bool result = false;
+   if(desktop->active_region_index != DESKTOP_REGION_NULL_INDEX &&
+      is_window_handle(desktop->windows, desktop->active_window, index))
+   {
+      result = is_resize_interaction(region_invariants[desktop->active_region_index].interaction);
+   }
 
-   x %= desktop->backbuffer.width;
-   y %= desktop->backbuffer.height;
+   return(result);
 }
 
-function void remove_window_from_list(desktop_context *desktop, desktop_window *window)
+function bool reserve_window_canvas(desktop_context *desktop, u32 index, u32 pixel_count, bool allow_shrink)
 {
-   // NOTE: Patch up list at removal site.
-   if(window->prev)
+   // NOTE: Grow the canvas memory geometrically, so that a resize drag only
+   // hits the pool a handful of times. When shrinking is allowed, capacity is
+   // released again once the canvas settles at less than a quarter of it.
+   desktop_window *window = desktop->windows->windows + index;
+
+   u32 capacity = window->canvas_capacity;
+   if(pixel_count > capacity)
    {
-      window->prev->next = window->next;
+      capacity = MAXIMUM(pixel_count, capacity * 2);
    }
-   if(window->next)
+   else if(allow_shrink && pixel_count < capacity / 4)
    {
-      window->next->prev = window->prev;
+      capacity = pixel_count;
    }
 
-   // NOTE: Update first and last window in desktop state.
-   if(desktop->first_window == window)
-   {
-      desktop->first_window = window->next;
-   }
-   if(desktop->last_window == window)
+   bool result = true;
+   if(capacity != window->canvas_capacity)
    {
-      desktop->last_window = window->prev;
+      u32 *memory = texture_pool_reallocate(&desktop->canvas_pool, window->canvas.memory, sizeof(u32) * MAXIMUM(capacity, 1));
+      if(memory)
+      {
+         window->canvas.memory = memory;
+         window->canvas_capacity = capacity;
+      }
+      else
+      {
+         result = (pixel_count <= window->canvas_capacity);
+      }
    }
+
+   return(result);
 }
 
-function void raise_window(desktop_context *desktop, desktop_window *window)
+function void build_widgets_window(desktop_context *desktop, u32 index, vec4 background, vec4 foreground)
 {
-   remove_window_from_list(desktop, window);
+   // NOTE: A demonstration of the widgets, including a list long enough that
+   // building every item each frame would be noticeable.
+   window_table *windows = desktop->windows;
+   desktop_window *window = windows->windows + index;
+   desktop_input *desktop_input = &desktop->input;
+   ui_state *state = window->ui;
+
+   rectangle bounds = get_canvas_rect(windows->bounds[index], window->display_infobar);
+
+   ui_input input = {0};
+   input.mousex = desktop_input->mousex - bounds.x;
+   input.mousey = desktop_input->mousey - bounds.y;
+   if(state->has_mouse)
+   {
+      input_state left = desktop_input->keys[INPUT_KEY_MBLEFT];
+
+      input.has_mouse = true;
+      input.mouse_down = is_pressed(left);
+      input.mouse_pressed = was_pressed(left);
+      input.mouse_released = was_released(left);
+      input.wheel_delta = desktop_input->wheel_delta;
+   }
 
-   // if(!desktop->first_window)
-   // {
-   //    desktop->first_window = window;
-   // }
-   // else
-   // {
-   //    window->next = desktop->first_window;
-   //    desktop->first_window->prev = window;
-   //    desktop->first_window = window;
-   // }
+   ui_context ui;
+   ui_begin(&ui, state, &window->canvas, &desktop->scratch_arena, input, background, foreground);
 
-   window->next = desktop->first_window;
-   if(window->next)
+   if(desktop->widgets_selected >= 0)
    {
-      window->next->prev = window;
+      ui_label(&ui, ui_format(&ui, "Selected: Item %05d", desktop->widgets_selected));
    }
-   window->prev = 0;
-   desktop->first_window = window;
-
-   if(!desktop->last_window)
+   else
    {
-      desktop->last_window = window;
+      ui_label(&ui, string8("Selected: None"));
    }
 
-   // if(!desktop->config.focus_follows_mouse)
+   if(ui_button(&ui, string8("Scroll to top")))
    {
-      desktop->hot_window = window;
+      ui_set_scroll(&ui, string8("Items"), 0);
+   }
+   if(ui_button(&ui, string8("Clear selection")))
+   {
+      desktop->widgets_selected = -1;
    }
-}
-
-function void minimize_window(desktop_context *desktop, desktop_window *window)
-{
-   window->state = WINDOW_STATE_MINIMIZED;
 
-   if(window == desktop->active_window)
+   u32 first, last;
+   ui_begin_list(&ui, string8("Items"), DESKTOP_WIDGETS_ITEM_COUNT, ui_get_remaining_height(&ui), &first, &last);
+   for(u32 item = first; item < last; ++item)
    {
-      desktop->active_window = 0;
-      for(desktop_window *test = desktop->first_window; test; test = test->next)
-      {
-         if(is_window_visible(test))
-         {
-            desktop->active_window = test;
-            break;
-         }
-      }
+      ui_list_item(&ui, item, ui_format(&ui, "Item %05u", item), &desktop->widgets_selected);
    }
+   ui_end_list(&ui);
+
+   ui_end(&ui);
 }
 
-function void create_window_position(desktop_context *desktop, string8 title, s32 x, s32 y)
+function void rasterize_window_canvas(desktop_context *desktop, u32 index)
 {
-   desktop_window *window = 0;
-   if(desktop->free_window)
+   window_table *windows = desktop->windows;
+   desktop_window *window = windows->windows + index;
+   texture *canvas = &window->canvas;
+
+   vec4 color0 = (desktop->config.dark_mode) ? DEBUG_COLOR_BLACK : DEBUG_COLOR_WHITE;
+   vec4 color1 = (desktop->config.dark_mode) ? DEBUG_COLOR_WHITE : DEBUG_COLOR_BLACK;
+
+   if(window->terminal)
    {
-      window = desktop->free_window;
-      desktop->free_window = desktop->free_window->next;
+      rasterize_terminal(window->terminal, canvas, color0, color1);
+      return;
    }
-   else
+
+   if(window->ui)
    {
-      window = arena_allocate(&desktop->window_arena, desktop_window, 1);
+      build_widgets_window(desktop, index, color0, color1);
+      return;
    }
 
-   desktop_window cleared_window = {0};
-   *window = cleared_window;
-   window->state = WINDOW_STATE_NORMAL;
-   window->title = title;
+   rectangle window_bounds = windows->bounds[index];
+   rectangle bounds = get_canvas_rect(window_bounds, window->display_infobar);
 
-   window->x = x;
-   window->y = y;
-   window->width = 400;
-   window->height = 300;
+   clear(canvas, color0);
 
-   window->display_infobar = true;
+   s32 x = 3;
+   s32 y = 6;
 
-   // BUG: Decouple texture creation from window creation. Right now texture
-   // memory does not get reused after windows are recreated.
-   texture canvas = {0};
-   canvas.width = window->width;
-   canvas.height = window->height;
-   canvas.memory = arena_allocate(&desktop->texture_arena, u32, canvas.width*canvas.height);
-   window->canvas = canvas;
+   char text_line[64];
+   char *format = "{x:%d y:%d w:%d h:%d}";
 
-   raise_window(desktop, window);
-}
+   int length = sprintf(text_line, format, window_bounds.x, window_bounds.y, window_bounds.width, window_bounds.height);
+   draw_text_line(canvas, x, &y, color1, string8new((u8 *)text_line, length));
 
-function void create_window(desktop_context *desktop, string8 title)
-{
-   s32 posx, posy;
-   get_default_window_location(desktop, &posx, &posy);
-   create_window_position(desktop, title, posx, posy);
+   length = sprintf(text_line, format, bounds.x, bounds.y, bounds.width, bounds.height);
+   draw_text_line(canvas, x, &y, color1, string8new((u8 *)text_line, length));
+
+   length = sprintf(text_line, "state:%d", windows->state[index]);
+   draw_text_line(canvas, x, &y, color1, string8new((u8 *)text_line, length));
+
+   y = ADVANCE_TEXT_LINE(y);
+   draw_text_line(canvas, x, &y, color1, string8("+----------------------------+"));
+   draw_text_line(canvas, x, &y, color1, string8("| ASCII FONT TEST            |"));
+   draw_text_line(canvas, x, &y, color1, string8("|----------------------------|"));
+   draw_text_line(canvas, x, &y, color1, string8("| ABCDEFGHIJKLMNOPQRSTUVWXYZ |"));
+   draw_text_line(canvas, x, &y, color1, string8("| abcdefghijklmnopqrstuvwxyz |"));
+   draw_text_line(canvas, x, &y, color1, string8("| AaBbCcDdEeFfGgHhIiJjKkLlMm |"));
+   draw_text_line(canvas, x, &y, color1, string8("| NnOoPpQqRrSsTtUuVvWwXxYyZz |"));
+   draw_text_line(canvas, x, &y, color1, string8("| 0123456789!\"#$%&'()*+,-./: |"));
+   draw_text_line(canvas, x, &y, color1, string8("| ;<=>?@[\\]^_`{|}~           |"));
+   draw_text_line(canvas, x, &y, color1, string8("+----------------------------+"));
 }
 
-function desktop_window *close_window(desktop_context *desktop, desktop_window *window)
+function void update_window_canvas(desktop_context *desktop, u32 index)
 {
-   desktop_window *result = window->prev;
-
-   remove_window_from_list(desktop, window);
+   // NOTE: Match the canvas to the window's content area and re-rasterize it
+   // if needed. Both are deferred while a resize drag is in progress, so the
+   // drag itself only costs a blit of the previous contents.
+   if(is_window_resizing(desktop, index))
+   {
+      return;
+   }
 
-   // NOTE: Add the closed window to the front of the free list.
-   window->prev = 0;
-   window->next = desktop->free_window;
-   desktop->free_window = window;
+   window_table *windows = desktop->windows;
+   desktop_window *window = windows->windows + index;
+   texture *canvas = &window->canvas;
 
-   return(result);
-}
+   rectangle bounds = get_canvas_rect(windows->bounds[index], window->display_infobar);
+   s32 width = MAXIMUM(bounds.width, 1);
+   s32 height = MAXIMUM(bounds.height, 1);
 
-function bool in_visible_window(desktop_context *desktop, desktop_window *window, int x, int y)
-{
-   bool result = false;
-   if(in_rectangle(window->bounds, x, y))
+   if(canvas->width != width || canvas->height != height)
    {
-      for(desktop_window *test = desktop->first_window; test; test = test->next)
+      if(reserve_window_canvas(desktop, index, (u32)(width * height), true))
       {
-         if(window == test)
-         {
-            result = true;
-            break;
-         }
-         else if(in_rectangle(test->bounds, x, y))
+         canvas->width = width;
+         canvas->height = height;
+         window->canvas_dirty = true;
+
+         if(window->terminal)
          {
-            break;
+            resize_terminal(window->terminal, width / TERMINAL_CELL_WIDTH, height / TERMINAL_CELL_HEIGHT);
+            window->terminal->needs_full_redraw = true;
          }
       }
    }
 
-   return(result);
-}
-
-function void store_active_window_mouse_offset(desktop_context *desktop, desktop_window *window, int x, int y)
-{
-   if(window)
-   {
-      desktop->active_window_mouse_offsetx = x - window->x;
-      desktop->active_window_mouse_offsety = y - window->y;
-   }
-   else
+   if(window->canvas_dirty)
    {
-      desktop->active_window_mouse_offsetx = 0;
-      desktop->active_window_mouse_offsetx = 0;
+      rasterize_window_canvas(desktop, index);
+      window->canvas_dirty = false;
+      window->canvas_version++;
    }
 }
 
-function bool window_wants_interaction(desktop_context *desktop, desktop_window *window)
+function void initialize_window_shadow(desktop_context *desktop)
 {
-   bool result = false;
-
-   input_state left = desktop->input.keys[INPUT_KEY_MBLEFT];
-   bool inside = in_visible_window(desktop, window, desktop->input.mousex, desktop->input.mousey);
-
-   if(window == desktop->active_window)
+   // NOTE: Blur a silhouette that spans the full height of the mask and
+   // DESKTOP_SHADOW_SLICE of its width. The middle row is then unaffected by
+   // the top and bottom of the mask, leaving the horizontal edge profile of a
+   // window at least that wide. The vertical profile is the same.
+   shadow_slices *shadow = &desktop->shadow;
+   s32 length = 2 * DESKTOP_SHADOW_SLICE;
+
+   arena_marker scratch = scratch_begin(0);
+
+   alpha_mask mask = {0};
+   mask.width = length;
+   mask.height = length;
+   mask.stride = length;
+   mask.memory = arena_allocate(scratch.a, float, length * length);
+   float *blur_scratch = arena_allocate(scratch.a, float, length * length);
+
+   for(s32 y = 0; y < length; ++y)
    {
-      if(was_released(left))
-      {
-         desktop->active_window = 0;
-      }
-      else
+      float *row = mask.memory + (y * mask.stride);
+      for(s32 x = 0; x < length; ++x)
       {
-         result = true;
+         row[x] = (x >= DESKTOP_SHADOW_RADIUS && x < DESKTOP_SHADOW_RADIUS + DESKTOP_SHADOW_SLICE) ? 1.0f : 0.0f;
       }
    }
-   else if(window == desktop->hot_window)
+   gaussian_blur_mask(&mask, blur_scratch, DESKTOP_SHADOW_SIGMA);
+
+   float *profile = mask.memory + (DESKTOP_SHADOW_SLICE * mask.stride);
+
+   shadow->profile = arena_allocate(&desktop->texture_arena, u8, length);
+   for(s32 index = 0; index < length; ++index)
    {
-      if(was_pressed(left) && inside)
-      {
-         desktop->active_window = window;
-         result = true;
-      }
+      shadow->profile[index] = (u8)(profile[index] * 255.0f + 0.5f);
    }
 
-   if(inside)
+   shadow->corners.width = length;
+   shadow->corners.height = length;
+   shadow->corners.stride = length;
+   shadow->corners.memory = arena_allocate(&desktop->texture_arena, u8, length * length);
+   for(s32 y = 0; y < length; ++y)
    {
-      desktop->hot_window = window;
+      u8 *row = shadow->corners.memory + (y * shadow->corners.stride);
+      for(s32 x = 0; x < length; ++x)
+      {
+         row[x] = (u8)(profile[x] * profile[y] * 255.0f + 0.5f);
+      }
    }
 
-   return(result);
+   scratch_end(scratch);
 }
 
-function void interact_with_window(desktop_context *desktop, desktop_window *window)
+function void draw_window_shadow_region(texture *destination, shadow_slices *shadow, s32 originx, s32 originy,
+                                        s32 width, s32 height, rectangle region, vec4 color)
 {
-   raise_window(desktop, window);
-
-   input_state left = desktop->input.keys[INPUT_KEY_MBLEFT];
-
-   int mousex = desktop->input.mousex;
-   int mousey = desktop->input.mousey;
+   // NOTE: The region is in the coordinates of the full shadow of a width by
+   // height window, whose top left corner is at the origin. Each axis splits
+   // into the leading slice, the stretched middle, and the trailing slice.
+   s32 boundsx[] = {0, DESKTOP_SHADOW_SLICE, width, width + DESKTOP_SHADOW_SLICE};
+   s32 boundsy[] = {0, DESKTOP_SHADOW_SLICE, height, height + DESKTOP_SHADOW_SLICE};
 
-   if(was_pressed(left))
+   for(u32 row = 0; row < 3; ++row)
    {
-      store_active_window_mouse_offset(desktop, window, mousex, mousey);
-
-      if(in_rectangle(get_close_button_rect(window), mousex, mousey))
+      s32 miny = MAXIMUM(region.y, boundsy[row]);
+      s32 maxy = MINIMUM(region.y + region.height, boundsy[row + 1]);
+      if(miny >= maxy)
       {
-         window->state = WINDOW_STATE_CLOSED;
-         desktop->active_window = 0;
+         continue;
       }
-      else if(in_rectangle(get_maximize_button_rect(window), mousex, mousey))
+
+      for(u32 column = 0; column < 3; ++column)
       {
-         if(window->state == WINDOW_STATE_NORMAL)
+         s32 minx = MAXIMUM(region.x, boundsx[column]);
+         s32 maxx = MINIMUM(region.x + region.width, boundsx[column + 1]);
+         if(minx >= maxx)
          {
-            window->state = WINDOW_STATE_MAXIMIZED;
-            window->unmaximized = window->bounds;
+            continue;
+         }
 
-            // TODO: Stop hard-coding offsets here.
-            window->x = 0;
-            window->y = DESKTOP_WINDOW_DIM_TITLEBAR;
-            window->width = desktop->backbuffer.width;
-            window->height = desktop->backbuffer.height - window->y;
+         // NOTE: Trailing slices come from the second half of the corners and
+         // the profile.
+         s32 slicex = (column == 2) ? (minx - width + DESKTOP_SHADOW_SLICE) : minx;
+         s32 slicey = (row == 2) ? (miny - height + DESKTOP_SHADOW_SLICE) : miny;
+
+         s32 x = originx + minx;
+         s32 y = originy + miny;
+
+         if(row != 1 && column != 1)
+         {
+            coverage_mask corner = shadow->corners;
+            corner.width = maxx - minx;
+            corner.height = maxy - miny;
+            corner.memory += (slicey * corner.stride) + slicex;
+
+            draw_coverage_mask(destination, &corner, x, y, color);
          }
-         else
+         else if(row != 1)
          {
-            window->state = WINDOW_STATE_NORMAL;
-            window->bounds = window->unmaximized;
+            // NOTE: Along the top and bottom edges, each row is one coverage.
+            for(s32 offset = 0; offset < maxy - miny; ++offset)
+            {
+               vec4 row_color = color;
+               row_color.a *= (float)shadow->profile[slicey + offset] / 255.0f;
+               if(row_color.a > 0.0f)
+               {
+                  draw_rectangle(destination, x, y + offset, maxx - minx, 1, row_color);
+               }
+            }
          }
-
-         desktop->active_window = 0;
-      }
-      else if(in_rectangle(get_titlebar_rect(window), mousex, mousey))
-      {
-         if(window->state == WINDOW_STATE_MAXIMIZED)
+         else if(column != 1)
          {
-            window->state = WINDOW_STATE_NORMAL;
-            window->bounds = window->unmaximized;
-
-            store_active_window_mouse_offset(desktop, window, window->width/2, DESKTOP_WINDOW_HALFDIM_TITLEBAR);
+            // NOTE: Along the left and right edges, every row is the same.
+            coverage_mask edge = {maxx - minx, maxy - miny, 0, shadow->profile + slicex};
+            draw_coverage_mask(destination, &edge, x, y, color);
+         }
+         else
+         {
+            draw_rectangle(destination, x, y, maxx - minx, maxy - miny, color);
          }
       }
    }
+}
 
-   if(desktop->active_window)
-   {
-      if(in_rectangle(get_titlebar_rect(window), desktop->input.previous_mousex, desktop->input.previous_mousey))
-      {
-         window->x = mousex - desktop->active_window_mouse_offsetx;
-         window->y = mousey - desktop->active_window_mouse_offsety;
-      }
-   }
+function void draw_window_shadow(texture *destination, shadow_slices *shadow, s32 x, s32 y, s32 width, s32 height)
+{
+   // NOTE: The window is opaque, so only the band of the shadow outside of it
+   // is composited. It's drawn as four strips around the window rectangle.
+   assert(width >= DESKTOP_SHADOW_SLICE && height >= DESKTOP_SHADOW_SLICE);
+
+   vec4 color = {0, 0, 0, DESKTOP_SHADOW_OPACITY};
+
+   s32 originx = x - DESKTOP_SHADOW_RADIUS + DESKTOP_SHADOW_OFFSET;
+   s32 originy = y - DESKTOP_SHADOW_RADIUS + DESKTOP_SHADOW_OFFSET;
+   s32 inset = DESKTOP_SHADOW_RADIUS - DESKTOP_SHADOW_OFFSET;
+
+   s32 shadow_width = width + DESKTOP_SHADOW_SLICE;
+   s32 shadow_height = height + DESKTOP_SHADOW_SLICE;
+
+   rectangle top = create_rectangle(0, 0, shadow_width, inset);
+   rectangle bottom = create_rectangle(0, inset + height, shadow_width, shadow_height - inset - height);
+   rectangle left = create_rectangle(0, inset, inset, height);
+   rectangle right = create_rectangle(inset + width, inset, shadow_width - inset - width, height);
+
+   draw_window_shadow_region(destination, shadow, originx, originy, width, height, top, color);
+   draw_window_shadow_region(destination, shadow, originx, originy, width, height, bottom, color);
+   draw_window_shadow_region(destination, shadow, originx, originy, width, height, left, color);
+   draw_window_shadow_region(destination, shadow, originx, originy, width, height, right, color);
+}
+
+function void draw_window(desktop_context *desktop, u32 index, texture *destination)
+{
+   window_table *windows = desktop->windows;
+   if(is_window_visible(windows, index))
+   {
+      desktop_window *window = windows->windows + index;
+      rectangle window_bounds = windows->bounds[index];
+
+      int window_width  = MAXIMUM(MINIMUM(window_bounds.width, desktop->backbuffer.width), 100);
+      int window_height = MAXIMUM(MINIMUM(window_bounds.height, desktop->backbuffer.height), 100);
+
+      int x = window_bounds.x;
+      int y = window_bounds.y;
+
+	  vec4 color0 = (desktop->config.dark_mode) ? DEBUG_COLOR_BLACK : DEBUG_COLOR_WHITE;
+	  vec4 color1 = (desktop->config.dark_mode) ? DEBUG_COLOR_WHITE : DEBUG_COLOR_BLACK;
+
+      // NOTE: A maximized window covers its own shadow, so skip it.
+      if(windows->state[index] != WINDOW_STATE_MAXIMIZED)
+      {
+         draw_window_shadow(destination, &desktop->shadow, x, y, window_width, window_height);
+      }
+
+      draw_outline(destination, x, y, window_width, window_height, color1);
+      draw_rectangle(destination, x+1, y+1, window_width-2, window_height-2, color0);
+
+      if(is_window_handle(windows, desktop->active_window, index))
+      {
+         draw_outline(destination, x, y, window_width, window_height, DEBUG_COLOR_BLUE);
+      }
+
+      // NOTE: Draw title bar.
+      {
+         int w = window_width;
+         int h = DESKTOP_WINDOW_DIM_TITLEBAR;
+
+         draw_rectangle(destination, x+1, y+h-1, w-2, 1, color1);
+         // draw_rectangle(destination, x+1, y+h+1, w-2, 1, color1);
+         if(is_window_handle(windows, desktop->hot_window, index))
+         {
+            for(int line = 0; line < 6; line++)
+            {
+               int offset = (line * 2) + 5;
+               draw_rectangle(destination, x+2, y+offset, w-4, 1, color1);
+            }
+
+            rectangle close = get_close_button_rect(windows, index);
+            draw_rectangle_rect(destination, close, color0);
+            draw_outline_rect(destination, resize_rectangle(close, 1), color1);
+            draw_outline_rect(destination, resize_rectangle(close, 2), color0);
+
+            rectangle maximize = get_maximize_button_rect(windows, index);
+            draw_rectangle_rect(destination, maximize, color0);
+            draw_outline_rect(destination, resize_rectangle(maximize, 1), color1);
+            draw_outline_rect(destination, resize_rectangle(maximize, 2), color0);
+
+            rectangle minimize = get_minimize_button_rect(windows, index);
+            draw_rectangle_rect(destination, minimize, color0);
+            draw_outline_rect(destination, resize_rectangle(minimize, 1), color1);
+            draw_outline_rect(destination, resize_rectangle(minimize, 2), color0);
+         }
+
+         rectangle rect;
+         get_text_bounds(&rect, window->title);
+
+         int textx = x + w/2 - rect.width/2;
+         int texty = ALIGN_TEXT_VERTICALLY(y+1, h);
+
+         // NOTE: Keep long titles from spilling past the edges of the window.
+         push_clip(destination, x+1, y+1, w-2, h-2);
+         draw_rectangle(destination, textx-4, texty-1, rect.width+8, rect.height+2, color0);
+         draw_text(destination, textx, texty, color1, window->title);
+         pop_clip(destination);
+      }
+
+      // NOTE: Draw info bar.
+      if(window->display_infobar)
+      {
+         int w = window_width;
+         int h = DESKTOP_WINDOW_DIM_TITLEBAR;
+         int infoy = y + h;
+
+         draw_rectangle(destination, x+1, infoy+h-1, w-2, 1, color1);
+         draw_rectangle(destination, x+1, infoy+h+1, w-2, 1, color1);
+      }
+
+      // NOTE: Draw canvas. While the window is being resized the canvas keeps
+      // its old contents, and the newly exposed area is filled with the
+      // background color until the drag settles.
+      {
+         rectangle bounds = get_canvas_rect(window_bounds, window->display_infobar);
+         draw_rectangle_rect(destination, bounds, color0);
+
+         update_window_canvas(desktop, index);
+         draw_texture_bounded(destination, &window->canvas, bounds.x, bounds.y, bounds.width, bounds.height);
+      }
+   }
+}
+
+function void initialize_window_grid(desktop_context *desktop)
+{
+   window_grid *grid = &desktop->grid;
+
+   grid->columns = (desktop->backbuffer.width + DESKTOP_GRID_CELL_DIM - 1) / DESKTOP_GRID_CELL_DIM;
+   grid->rows = (desktop->backbuffer.height + DESKTOP_GRID_CELL_DIM - 1) / DESKTOP_GRID_CELL_DIM;
+   grid->cells = arena_allocate(&desktop->window_arena, window_bitset, grid->columns * grid->rows);
+   assert(grid->cells);
+
+   zero_memory(grid->cells, sizeof(*grid->cells) * grid->columns * grid->rows);
+}
+
+function bool get_grid_cell_range(window_grid *grid, rectangle bounds, s32 *minx, s32 *miny, s32 *maxx, s32 *maxy)
+{
+   // NOTE: Convert the bounds to an inclusive range of cells, clamped to the
+   // grid. Windows can hang off the edges of the backbuffer, but the mouse
+   // can't, so the clipped portion never needs to be indexed.
+   *minx = MAXIMUM(bounds.x, 0) / DESKTOP_GRID_CELL_DIM;
+   *miny = MAXIMUM(bounds.y, 0) / DESKTOP_GRID_CELL_DIM;
+   *maxx = MINIMUM((bounds.x + bounds.width - 1) / DESKTOP_GRID_CELL_DIM, grid->columns - 1);
+   *maxy = MINIMUM((bounds.y + bounds.height - 1) / DESKTOP_GRID_CELL_DIM, grid->rows - 1);
+
+   bool result = (bounds.width > 0 && bounds.height > 0 &&
+                  (bounds.x + bounds.width) > 0 && (bounds.y + bounds.height) > 0 &&
+                  *minx <= *maxx && *miny <= *maxy);
+
+   return(result);
+}
+
+function void set_grid_cells(window_grid *grid, rectangle bounds, u32 index, bool value)
+{
+   s32 minx, miny, maxx, maxy;
+   if(get_grid_cell_range(grid, bounds, &minx, &miny, &maxx, &maxy))
+   {
+      u32 word = index / 64;
+      u64 bit = 1ULL << (index % 64);
+
+      for(s32 y = miny; y <= maxy; ++y)
+      {
+         window_bitset *row = grid->cells + (y * grid->columns);
+         for(s32 x = minx; x <= maxx; ++x)
+         {
+            if(value)
+            {
+               row[x].bits[word] |= bit;
+            }
+            else
+            {
+               row[x].bits[word] &= ~bit;
+            }
+         }
+      }
+   }
+}
+
+function void update_window_index(desktop_context *desktop, u32 index)
+{
+   // NOTE: Re-insert the window into the grid after its bounds or visibility
+   // changed. Only the cells covered by the old and new bounds are touched.
+   window_table *windows = desktop->windows;
+   window_grid *grid = &desktop->grid;
+
+   if(grid->is_indexed[index])
+   {
+      set_grid_cells(grid, grid->indexed_bounds[index], index, false);
+      grid->is_indexed[index] = false;
+   }
+
+   if(is_window_visible(windows, index))
+   {
+      set_grid_cells(grid, windows->bounds[index], index, true);
+      grid->is_indexed[index] = true;
+      grid->indexed_bounds[index] = windows->bounds[index];
+   }
+}
+
+function u32 find_window_at(desktop_context *desktop, s32 x, s32 y)
+{
+   // NOTE: Return the topmost visible window containing the point, or
+   // DESKTOP_WINDOW_NULL_INDEX if there isn't one.
+   u32 result = DESKTOP_WINDOW_NULL_INDEX;
+   s32 result_z = 0;
+
+   window_table *windows = desktop->windows;
+   window_grid *grid = &desktop->grid;
+   s32 column = x / DESKTOP_GRID_CELL_DIM;
+   s32 row = y / DESKTOP_GRID_CELL_DIM;
+
+   if(x >= 0 && y >= 0 && column < grid->columns && row < grid->rows)
+   {
+      window_bitset *cell = grid->cells + (row * grid->columns) + column;
+      for(u32 word = 0; word < DESKTOP_WINDOW_BITSET_COUNT; ++word)
+      {
+         u64 bits = cell->bits[word];
+         while(bits)
+         {
+            u32 index = (word * 64) + find_lowest_set_bit(bits);
+            bits &= (bits - 1);
+
+            if(in_rectangle(windows->bounds[index], x, y) &&
+               (result == DESKTOP_WINDOW_NULL_INDEX || windows->z[index] > result_z))
+            {
+               result = index;
+               result_z = windows->z[index];
+            }
+         }
+      }
+   }
+
+   return(result);
+}
+
+function void get_default_window_location(desktop_context *desktop, s32 *posx, s32 *posy)
+{
+   static s32 x = 120;
+   static s32 y = 80;
+
+   *posx = x;
+   *posy = y;
+
+   x -= 32/2;
+   y += 20/2;
+
+   x %= desktop->backbuffer.width;
+   y %= desktop->backbuffer.height;
+}
+
+function void raise_window(desktop_context *desktop, u32 index)
+{
+   window_table *windows = desktop->windows;
+
+   // NOTE: Shift every window above this one down a position, then place it at
+   // the front of the sorting order.
+   u32 position = 0;
+   while(position < windows->order_count && windows->order[position] != index)
+   {
+      position++;
+   }
+   assert(position < windows->order_count);
+
+   memmove(windows->order + 1, windows->order, position * sizeof(*windows->order));
+   windows->order[0] = index;
+   windows->z[index] = ++windows->next_z;
+
+   // if(!desktop->config.focus_follows_mouse)
+   {
+      desktop->hot_window = get_window_handle(windows, index);
+   }
+}
+
+function rectangle get_taskbar_tab_rect(desktop_context *desktop, u32 tab)
+{
+   // NOTE: Tabs for minimized windows are laid out right to left from the end
+   // of the taskbar.
+   s32 width = 120;
+   s32 height = DESKTOP_TASKBAR_HEIGHT - 4;
+   s32 x = desktop->backbuffer.width - ((s32)(tab + 1) * (width + 4));
+
+   rectangle result = create_rectangle(x, 2, width, height);
+   return(result);
+}
+
+function u32 get_window_taskbar_tab(desktop_context *desktop, u32 index)
+{
+   // NOTE: Tabs are assigned in slot order, so they don't shuffle around
+   // as windows are raised.
+   window_table *windows = desktop->windows;
+
+   u32 result = 0;
+   for(u32 test = 0; test < index; ++test)
+   {
+      if(windows->state[test] == WINDOW_STATE_MINIMIZED)
+      {
+         result++;
+      }
+   }
+
+   return(result);
+}
+
+function u32 find_taskbar_tab_at(desktop_context *desktop, s32 x, s32 y)
+{
+   window_table *windows = desktop->windows;
+
+   u32 result = DESKTOP_WINDOW_NULL_INDEX;
+   u32 tab = 0;
+   for(u32 index = 0; index < windows->slot_count; ++index)
+   {
+      if(windows->state[index] == WINDOW_STATE_MINIMIZED)
+      {
+         if(in_rectangle(get_taskbar_tab_rect(desktop, tab), x, y))
+         {
+            result = index;
+            break;
+         }
+         tab++;
+      }
+   }
+
+   return(result);
+}
+
+function window_animation *get_window_animation(desktop_context *desktop, u32 index)
+{
+   window_animation *result = 0;
+
+   window_animation_scheduler *animations = &desktop->animations;
+   for(u32 animation_index = 0; animation_index < animations->count; ++animation_index)
+   {
+      window_animation *animation = animations->entries + animation_index;
+      if(is_window_handle(desktop->windows, animation->window, index))
+      {
+         result = animation;
+         break;
+      }
+   }
+
+   return(result);
+}
+
+function float get_animation_progress(window_animation *animation)
+{
+   // NOTE: Smoothstep easing, so transitions start and finish gently.
+   float t = animation->elapsed_seconds / animation->duration_seconds;
+   t = MAXIMUM(0.0f, MINIMUM(t, 1.0f));
+
+   float result = t * t * (3.0f - 2.0f * t);
+   return(result);
+}
+
+function s32 lerp_s32(s32 a, s32 b, float t)
+{
+   s32 result = a + (s32)((float)(b - a) * t + 0.5f);
+   return(result);
+}
+
+function void get_animation_frame(window_animation *animation, rectangle *bounds, float *opacity)
+{
+   float t = get_animation_progress(animation);
+
+   bounds->x = lerp_s32(animation->from_bounds.x, animation->to_bounds.x, t);
+   bounds->y = lerp_s32(animation->from_bounds.y, animation->to_bounds.y, t);
+   bounds->width = lerp_s32(animation->from_bounds.width, animation->to_bounds.width, t);
+   bounds->height = lerp_s32(animation->from_bounds.height, animation->to_bounds.height, t);
+
+   *opacity = animation->from_opacity + (animation->to_opacity - animation->from_opacity) * t;
+}
+
+function void start_window_animation(desktop_context *desktop, u32 index, window_animation_type type,
+                                     rectangle from_bounds, rectangle to_bounds, float from_opacity, float to_opacity)
+{
+   window_animation_scheduler *animations = &desktop->animations;
+
+   // NOTE: Retarget a transition that is still in flight from wherever it
+   // currently is, rather than snapping back to its starting point.
+   window_animation *animation = get_window_animation(desktop, index);
+   if(animation)
+   {
+      get_animation_frame(animation, &from_bounds, &from_opacity);
+   }
+   else if(animations->count < countof(animations->entries))
+   {
+      animation = animations->entries + animations->count++;
+   }
+   else
+   {
+      return;
+   }
+
+   animation->window = get_window_handle(desktop->windows, index);
+   animation->type = type;
+   animation->from_bounds = from_bounds;
+   animation->to_bounds = to_bounds;
+   animation->from_opacity = from_opacity;
+   animation->to_opacity = to_opacity;
+   animation->elapsed_seconds = 0.0f;
+   animation->duration_seconds = DESKTOP_ANIMATION_SECONDS;
+}
+
+function void update_window_animations(desktop_context *desktop)
+{
+   // NOTE: Advance every live transition, dropping those that finished or
+   // whose window was closed. Frame time is clamped so that a long idle wait
+   // before the first frame doesn't skip the transition entirely.
+   window_animation_scheduler *animations = &desktop->animations;
+   float seconds = MINIMUM(desktop->input.frame_seconds_elapsed, 1.0f / 30.0f);
+
+   u32 animation_index = 0;
+   while(animation_index < animations->count)
+   {
+      window_animation *animation = animations->entries + animation_index;
+      animation->elapsed_seconds += seconds;
+
+      u32 index = get_window_index(desktop->windows, animation->window);
+      if(index == DESKTOP_WINDOW_NULL_INDEX || animation->elapsed_seconds >= animation->duration_seconds)
+      {
+         *animation = animations->entries[--animations->count];
+      }
+      else
+      {
+         animation_index++;
+      }
+   }
+}
+
+function void draw_window_animation(desktop_context *desktop, u32 index, window_animation *animation, texture *destination)
+{
+   // NOTE: Draw a translucent preview of the window at its in-between bounds.
+   window_table *windows = desktop->windows;
+   desktop_window *window = windows->windows + index;
+
+   rectangle bounds;
+   float opacity;
+   get_animation_frame(animation, &bounds, &opacity);
+
+   vec4 color0 = (desktop->config.dark_mode) ? DEBUG_COLOR_BLACK : DEBUG_COLOR_WHITE;
+   vec4 color1 = (desktop->config.dark_mode) ? DEBUG_COLOR_WHITE : DEBUG_COLOR_BLACK;
+   color0.a = opacity;
+   color1.a = opacity;
+
+   draw_rectangle_rect(destination, bounds, color0);
+   draw_outline_rect(destination, bounds, color1);
+
+   // NOTE: Scale the canvas into the in-between content area. The box filter
+   // is used once the preview shrinks to less than half the canvas size,
+   // where bilinear would start to skip texels.
+   rectangle content = get_canvas_rect(bounds, window->display_infobar);
+   if(content.width > 0 && content.height > 0)
+   {
+      texture *canvas = &window->canvas;
+
+      texture_filter filter = TEXTURE_FILTER_BILINEAR;
+      if(content.width * 2 <= canvas->width && content.height * 2 <= canvas->height)
+      {
+         filter = TEXTURE_FILTER_BOX;
+      }
+
+      draw_texture_scaled(destination, canvas, content.x, content.y, content.width, content.height, filter, opacity);
+   }
+}
+
+function void minimize_window(desktop_context *desktop, u32 index)
+{
+   window_table *windows = desktop->windows;
+
+   windows->windows[index].restore_state = windows->state[index];
+   windows->state[index] = WINDOW_STATE_MINIMIZED;
+   update_window_index(desktop, index);
+
+   rectangle tab = get_taskbar_tab_rect(desktop, get_window_taskbar_tab(desktop, index));
+   start_window_animation(desktop, index, WINDOW_ANIMATION_MINIMIZE, windows->bounds[index], tab, 1.0f, 0.0f);
+
+   if(is_window_handle(windows, desktop->active_window, index))
+   {
+      window_handle null_handle = {0};
+      desktop->active_window = null_handle;
+      desktop->active_region_index = DESKTOP_REGION_NULL_INDEX;
+
+      for(u32 position = 0; position < windows->order_count; ++position)
+      {
+         u32 test = windows->order[position];
+         if(is_window_visible(windows, test))
+         {
+            desktop->active_window = get_window_handle(windows, test);
+            break;
+         }
+      }
+   }
+}
+
+function void restore_window(desktop_context *desktop, u32 index)
+{
+   window_table *windows = desktop->windows;
+   rectangle tab = get_taskbar_tab_rect(desktop, get_window_taskbar_tab(desktop, index));
+
+   windows->state[index] = windows->windows[index].restore_state;
+   if(windows->state[index] == WINDOW_STATE_MINIMIZED || windows->state[index] == WINDOW_STATE_CLOSED)
+   {
+      windows->state[index] = WINDOW_STATE_NORMAL;
+   }
+
+   raise_window(desktop, index);
+   update_window_index(desktop, index);
+
+   start_window_animation(desktop, index, WINDOW_ANIMATION_RESTORE, tab, windows->bounds[index], 0.0f, 1.0f);
+}
+
+function u32 create_window_position(desktop_context *desktop, string8 title, s32 x, s32 y)
+{
+   window_table *windows = desktop->windows;
+
+   u32 index;
+   if(windows->free_count)
+   {
+      index = windows->free_slots[--windows->free_count];
+   }
+   else if(windows->slot_count < DESKTOP_WINDOW_MAX_COUNT)
+   {
+      index = windows->slot_count++;
+   }
+   else
+   {
+      // NOTE: The window limit was reached.
+      return(DESKTOP_WINDOW_NULL_INDEX);
+   }
+
+   if(!windows->generation[index])
+   {
+      windows->generation[index] = 1;
+   }
+
+   windows->state[index] = WINDOW_STATE_NORMAL;
+   windows->bounds[index] = create_rectangle(x, y, 400, 300);
+
+   desktop_window cleared_window = {0};
+   desktop_window *window = windows->windows + index;
+   *window = cleared_window;
+
+   window->title = title;
+   window->display_infobar = true;
+
+   // NOTE: Canvas memory comes from the pool, and is returned to it when the
+   // window is closed.
+   texture canvas = {0};
+   canvas.width = windows->bounds[index].width;
+   canvas.height = windows->bounds[index].height;
+   canvas.memory = texture_pool_allocate(&desktop->canvas_pool, sizeof(u32) * canvas.width*canvas.height);
+   if(!canvas.memory)
+   {
+      // NOTE: The canvas pool is exhausted, so release the slot again.
+      windows->state[index] = WINDOW_STATE_CLOSED;
+      windows->free_slots[windows->free_count++] = index;
+      return(DESKTOP_WINDOW_NULL_INDEX);
+   }
+   window->canvas = canvas;
+   window->canvas_capacity = canvas.width*canvas.height;
+   window->canvas_dirty = true;
+
+   // NOTE: Blank the thumbnail left behind by the slot's previous window.
+   clear(desktop->thumbnails.textures + index, PALETTE[2]);
+   desktop->thumbnails.versions[index] = 0;
+
+   // NOTE: Append to the sorting order, then raise to the front.
+   windows->order[windows->order_count++] = index;
+
+   raise_window(desktop, index);
+   update_window_index(desktop, index);
+
+   return(index);
+}
+
+function u32 create_window(desktop_context *desktop, string8 title)
+{
+   s32 posx, posy;
+   get_default_window_location(desktop, &posx, &posy);
+
+   u32 result = create_window_position(desktop, title, posx, posy);
+   return(result);
+}
+
+function void update_terminal_window(desktop_context *desktop)
+{
+   // NOTE: Typed text goes to the terminal while it's the front window, and
+   // the wheel scrolls through its history while the mouse is over it.
+   desktop_input *input = &desktop->input;
+   desktop_terminal *terminal = &desktop->terminal;
+   window_table *windows = desktop->windows;
+
+   u32 index = get_window_index(windows, desktop->terminal_window);
+   if(index == DESKTOP_WINDOW_NULL_INDEX)
+   {
+      return;
+   }
+
+   if(input->text_length && windows->order_count && windows->order[0] == index && is_window_visible(windows, index))
+   {
+      queue_terminal_input(terminal, input->text, input->text_length);
+   }
+
+   if(input->wheel_delta && find_window_at(desktop, input->mousex, input->mousey) == index)
+   {
+      s32 offset = (s32)terminal->view_offset + (input->wheel_delta * TERMINAL_WHEEL_LINES);
+      set_terminal_view_offset(terminal, offset);
+   }
+
+   if(terminal_has_changes(terminal))
+   {
+      windows->windows[index].canvas_dirty = true;
+   }
+
+   update_terminal_throughput(terminal, input->time_seconds);
+}
+
+function void update_widgets_window(desktop_context *desktop)
+{
+   // NOTE: The widgets are rebuilt only when the input could affect them: the
+   // mouse is or was over their canvas, or one of them is being dragged.
+   desktop_input *input = &desktop->input;
+   ui_state *ui = &desktop->widgets_ui;
+   window_table *windows = desktop->windows;
+
+   u32 index = get_window_index(windows, desktop->widgets_window);
+   if(index == DESKTOP_WINDOW_NULL_INDEX)
+   {
+      return;
+   }
+
+   desktop_window *window = windows->windows + index;
+   rectangle bounds = get_canvas_rect(windows->bounds[index], window->display_infobar);
+
+   bool over = (in_rectangle(bounds, input->mousex, input->mousey) &&
+                find_window_at(desktop, input->mousex, input->mousey) == index);
+   bool was_over = (in_rectangle(bounds, input->previous_mousex, input->previous_mousey) &&
+                    find_window_at(desktop, input->previous_mousex, input->previous_mousey) == index);
+
+   ui->has_mouse = (over || ui->active_id);
+   if(input_changed(input) && (over || was_over || ui->active_id))
+   {
+      window->canvas_dirty = true;
+   }
+}
+
+function void close_window(desktop_context *desktop, u32 index)
+{
+   // NOTE: The caller is responsible for removing the slot from the sorting
+   // order. Bumping the generation invalidates any outstanding handles.
+   window_table *windows = desktop->windows;
+
+   windows->state[index] = WINDOW_STATE_CLOSED;
+   update_window_index(desktop, index);
+
+   desktop_window *window = windows->windows + index;
+   texture_pool_free(&desktop->canvas_pool, window->canvas.memory);
+   window->canvas.memory = 0;
+
+   windows->generation[index]++;
+   if(!windows->generation[index])
+   {
+      windows->generation[index] = 1;
+   }
+
+   windows->free_slots[windows->free_count++] = index;
+}
+
+function bool in_visible_window(desktop_context *desktop, u32 index, int x, int y)
+{
+   bool result = (find_window_at(desktop, x, y) == index);
+   return(result);
+}
+
+function void store_active_window_mouse_offset(desktop_context *desktop, u32 index, int x, int y)
+{
+   rectangle bounds = desktop->windows->bounds[index];
+
+   desktop->active_window_mouse_offsetx = x - bounds.x;
+   desktop->active_window_mouse_offsety = y - bounds.y;
+}
+
+function void clear_active_window(desktop_context *desktop)
+{
+   window_handle null_handle = {0};
+   desktop->active_window = null_handle;
+   desktop->active_region_index = DESKTOP_REGION_NULL_INDEX;
+}
+
+function bool window_wants_interaction(desktop_context *desktop, u32 index)
+{
+   bool result = false;
+
+   window_table *windows = desktop->windows;
+
+   input_state left = desktop->input.keys[INPUT_KEY_MBLEFT];
+   bool inside = in_visible_window(desktop, index, desktop->input.mousex, desktop->input.mousey);
+
+   if(is_window_handle(windows, desktop->active_window, index))
+   {
+      if(was_released(left))
+      {
+         // NOTE: Plain windows also print their position, so redraw them once
+         // when a move ends rather than on every frame of the drag.
+         desktop_window *window = windows->windows + index;
+         rectangle bounds = windows->bounds[index];
+         rectangle start = desktop->drag_start_bounds;
+         if(!window->terminal && !window->ui && (bounds.x != start.x || bounds.y != start.y))
+         {
+            window->canvas_dirty = true;
+         }
+
+         clear_active_window(desktop);
+      }
+      else
+      {
+         result = true;
+      }
+   }
+   else if(is_window_handle(windows, desktop->hot_window, index))
+   {
+      if(was_pressed(left) && inside)
+      {
+         desktop->active_window = get_window_handle(windows, index);
+         result = true;
+      }
+   }
+
+   if(inside)
+   {
+      desktop->hot_window = get_window_handle(windows, index);
+   }
+
+   return(result);
+}
+
+function rectangle compute_resized_bounds(rectangle start, window_interaction_type interaction, s32 deltax, s32 deltay)
+{
+   bool move_n = (interaction == WINDOW_INTERACTION_RESIZE_N || interaction == WINDOW_INTERACTION_RESIZE_NW || interaction == WINDOW_INTERACTION_RESIZE_NE);
+   bool move_s = (interaction == WINDOW_INTERACTION_RESIZE_S || interaction == WINDOW_INTERACTION_RESIZE_SW || interaction == WINDOW_INTERACTION_RESIZE_SE);
+   bool move_w = (interaction == WINDOW_INTERACTION_RESIZE_W || interaction == WINDOW_INTERACTION_RESIZE_NW || interaction == WINDOW_INTERACTION_RESIZE_SW);
+   bool move_e = (interaction == WINDOW_INTERACTION_RESIZE_E || interaction == WINDOW_INTERACTION_RESIZE_NE || interaction == WINDOW_INTERACTION_RESIZE_SE);
+
+   s32 left = start.x;
+   s32 top = start.y;
+   s32 right = start.x + start.width;
+   s32 bottom = start.y + start.height;
+
+   if(move_n) top += deltay;
+   if(move_s) bottom += deltay;
+   if(move_w) left += deltax;
+   if(move_e) right += deltax;
+
+   // NOTE: Clamp the dragged edge rather than the size, so that the opposite
+   // edge stays put once the window reaches its minimum dimensions.
+   if(right - left < DESKTOP_WINDOW_MIN_WIDTH)
+   {
+      if(move_w)
+      {
+         left = right - DESKTOP_WINDOW_MIN_WIDTH;
+      }
+      else
+      {
+         right = left + DESKTOP_WINDOW_MIN_WIDTH;
+      }
+   }
+   if(bottom - top < DESKTOP_WINDOW_MIN_HEIGHT)
+   {
+      if(move_n)
+      {
+         top = bottom - DESKTOP_WINDOW_MIN_HEIGHT;
+      }
+      else
+      {
+         bottom = top + DESKTOP_WINDOW_MIN_HEIGHT;
+      }
+   }
+
+   rectangle result = create_rectangle(left, top, right - left, bottom - top);
+   return(result);
+}
+
+function void interact_with_window(desktop_context *desktop, u32 index)
+{
+   raise_window(desktop, index);
+
+   window_table *windows = desktop->windows;
+   desktop_window *window = windows->windows + index;
+   rectangle *bounds = windows->bounds + index;
+   window_state *state = windows->state + index;
+   window_state previous_state = *state;
+
+   input_state left = desktop->input.keys[INPUT_KEY_MBLEFT];
+
+   int mousex = desktop->input.mousex;
+   int mousey = desktop->input.mousey;
+
+   if(was_pressed(left))
+   {
+      store_active_window_mouse_offset(desktop, index, mousex, mousey);
+
+      desktop->active_region_index = get_window_region(windows, index, mousex, mousey);
+      desktop->drag_start_bounds = *bounds;
+      desktop->drag_startx = mousex;
+      desktop->drag_starty = mousey;
+
+      window_interaction_type interaction = WINDOW_INTERACTION_NONE;
+      if(desktop->active_region_index != DESKTOP_REGION_NULL_INDEX)
+      {
+         interaction = region_invariants[desktop->active_region_index].interaction;
+      }
+
+      if(interaction == WINDOW_INTERACTION_CLOSE)
+      {
+         *state = WINDOW_STATE_CLOSED;
+         clear_active_window(desktop);
+      }
+      else if(interaction == WINDOW_INTERACTION_MAXIMIZE)
+      {
+         rectangle from_bounds = *bounds;
+         if(*state == WINDOW_STATE_NORMAL)
+         {
+            *state = WINDOW_STATE_MAXIMIZED;
+            window->unmaximized = *bounds;
+
+            // TODO: Stop hard-coding offsets here.
+            bounds->x = 0;
+            bounds->y = DESKTOP_WINDOW_DIM_TITLEBAR;
+            bounds->width = desktop->backbuffer.width;
+            bounds->height = desktop->backbuffer.height - bounds->y;
+
+            start_window_animation(desktop, index, WINDOW_ANIMATION_MAXIMIZE, from_bounds, *bounds, 1.0f, 1.0f);
+         }
+         else
+         {
+            *state = WINDOW_STATE_NORMAL;
+            *bounds = window->unmaximized;
+
+            start_window_animation(desktop, index, WINDOW_ANIMATION_UNMAXIMIZE, from_bounds, *bounds, 1.0f, 1.0f);
+         }
+
+         clear_active_window(desktop);
+      }
+      else if(interaction == WINDOW_INTERACTION_MINIMIZE)
+      {
+         clear_active_window(desktop);
+         minimize_window(desktop, index);
+      }
+      else if(interaction == WINDOW_INTERACTION_MOVE)
+      {
+         if(*state == WINDOW_STATE_MAXIMIZED)
+         {
+            *state = WINDOW_STATE_NORMAL;
+            *bounds = window->unmaximized;
+
+            store_active_window_mouse_offset(desktop, index, bounds->width/2, DESKTOP_WINDOW_HALFDIM_TITLEBAR);
+         }
+      }
+   }
+
+   if(is_window_handle(windows, desktop->active_window, index) &&
+      desktop->active_region_index != DESKTOP_REGION_NULL_INDEX)
+   {
+      window_interaction_type interaction = region_invariants[desktop->active_region_index].interaction;
+      if(interaction == WINDOW_INTERACTION_MOVE)
+      {
+         bounds->x = mousex - desktop->active_window_mouse_offsetx;
+         bounds->y = mousey - desktop->active_window_mouse_offsety;
+      }
+      else if(is_resize_interaction(interaction))
+      {
+         s32 deltax = mousex - desktop->drag_startx;
+         s32 deltay = mousey - desktop->drag_starty;
+
+         rectangle resized = compute_resized_bounds(desktop->drag_start_bounds, interaction, deltax, deltay);
+         rectangle content = get_canvas_rect(resized, window->display_infobar);
+
+         // NOTE: Only reserve memory for the canvas during the drag. Resizing
+         // the canvas itself and re-rasterizing waits until the button is
+         // released. If the pool is exhausted, the window keeps its size.
+         if(reserve_window_canvas(desktop, index, (u32)(content.width * content.height), false))
+         {
+            *bounds = resized;
+         }
+      }
+   }
+
+   // NOTE: Size changes are picked up by update_window_canvas once any resize
+   // drag ends, so the canvas only needs redrawing here when the state that
+   // plain windows print changes.
+   if(*state != previous_state)
+   {
+      window->canvas_dirty = true;
+   }
+   update_window_index(desktop, index);
+}
+
+function rectangle get_thumbnail_strip_rect(desktop_context *desktop)
+{
+   s32 height = DESKTOP_THUMBNAIL_HEIGHT + (2 * DESKTOP_THUMBNAIL_PADDING);
+   rectangle result = create_rectangle(0, desktop->backbuffer.height - height, desktop->backbuffer.width, height);
+
+   return(result);
+}
+
+function u32 get_thumbnail_capacity(desktop_context *desktop)
+{
+   s32 stride = DESKTOP_THUMBNAIL_WIDTH + DESKTOP_THUMBNAIL_PADDING;
+   u32 result = (u32)MAXIMUM((desktop->backbuffer.width - DESKTOP_THUMBNAIL_PADDING) / stride, 0);
+
+   return(result);
+}
+
+function rectangle get_thumbnail_rect(desktop_context *desktop, u32 position)
+{
+   rectangle strip = get_thumbnail_strip_rect(desktop);
+
+   s32 x = DESKTOP_THUMBNAIL_PADDING + (s32)position * (DESKTOP_THUMBNAIL_WIDTH + DESKTOP_THUMBNAIL_PADDING);
+   s32 y = strip.y + DESKTOP_THUMBNAIL_PADDING;
+
+   rectangle result = create_rectangle(x, y, DESKTOP_THUMBNAIL_WIDTH, DESKTOP_THUMBNAIL_HEIGHT);
+   return(result);
+}
+
+function u32 find_thumbnail_at(desktop_context *desktop, s32 x, s32 y)
+{
+   // NOTE: Thumbnails are laid out in slot order, one per open window, up to
+   // as many as fit across the strip.
+   window_table *windows = desktop->windows;
+
+   u32 result = DESKTOP_WINDOW_NULL_INDEX;
+   u32 capacity = get_thumbnail_capacity(desktop);
+
+   if(windows->order_count && in_rectangle(get_thumbnail_strip_rect(desktop), x, y))
+   {
+      u32 position = 0;
+      for(u32 index = 0; index < windows->slot_count && position < capacity; ++index)
+      {
+         if(windows->state[index] != WINDOW_STATE_CLOSED)
+         {
+            if(in_rectangle(get_thumbnail_rect(desktop, position), x, y))
+            {
+               result = index;
+               break;
+            }
+            position++;
+         }
+      }
+   }
+
+   return(result);
+}
+
+function void generate_window_thumbnail(desktop_context *desktop, u32 index)
+{
+   // NOTE: Fit the canvas inside the thumbnail, preserving its aspect ratio.
+   // Canvases are always larger than thumbnails, so the box filter averages
+   // every texel instead of sampling a few of them.
+   desktop_window *window = desktop->windows->windows + index;
+   texture *canvas = &window->canvas;
+   texture *thumbnail = desktop->thumbnails.textures + index;
+
+   clear(thumbnail, PALETTE[2]);
+
+   if(canvas->width > 0 && canvas->height > 0)
+   {
+      s32 width = DESKTOP_THUMBNAIL_WIDTH;
+      s32 height = (canvas->height * DESKTOP_THUMBNAIL_WIDTH) / canvas->width;
+      if(height > DESKTOP_THUMBNAIL_HEIGHT)
+      {
+         height = DESKTOP_THUMBNAIL_HEIGHT;
+         width = (canvas->width * DESKTOP_THUMBNAIL_HEIGHT) / canvas->height;
+      }
+
+      s32 x = (DESKTOP_THUMBNAIL_WIDTH - width) / 2;
+      s32 y = (DESKTOP_THUMBNAIL_HEIGHT - height) / 2;
+      draw_texture_scaled(thumbnail, canvas, x, y, width, height, TEXTURE_FILTER_BOX, 1.0f);
+   }
+
+   desktop->thumbnails.versions[index] = window->canvas_version;
+}
+
+function void generate_window_thumbnails(void *data, size first, size last)
+{
+   thumbnail_updates *updates = (thumbnail_updates *)data;
+   for(size index = first; index < last; ++index)
+   {
+      generate_window_thumbnail(updates->desktop, updates->indices[index]);
+   }
+}
+
+function void update_window_thumbnails(desktop_context *desktop)
+{
+   // NOTE: Walk the slots round-robin from where the previous frame stopped,
+   // so that a window that changes every frame can't starve the others.
+   window_table *windows = desktop->windows;
+   thumbnail_cache *thumbnails = &desktop->thumbnails;
+
+   thumbnails->updated_count = 0;
+   thumbnails->stale_count = 0;
+
+   thumbnail_updates updates = {desktop};
+
+   u32 slot_count = windows->slot_count;
+   u32 start = (slot_count) ? (thumbnails->next_update_index % slot_count) : 0;
+
+   for(u32 offset = 0; offset < slot_count; ++offset)
+   {
+      u32 index = (start + offset) % slot_count;
+      desktop_window *window = windows->windows + index;
+
+      if(windows->state[index] != WINDOW_STATE_CLOSED && thumbnails->versions[index] != window->canvas_version)
+      {
+         if(thumbnails->updated_count < DESKTOP_THUMBNAIL_UPDATES_PER_FRAME)
+         {
+            updates.indices[thumbnails->updated_count++] = index;
+            thumbnails->next_update_index = index + 1;
+         }
+         else
+         {
+            thumbnails->stale_count++;
+         }
+      }
+   }
+
+   parallel_for(thumbnails->updated_count, 1, generate_window_thumbnails, &updates);
+
+   // NOTE: Keep updating on the following frames until every thumbnail has
+   // caught up.
+   if(thumbnails->stale_count)
+   {
+      desktop->needs_redraw = true;
+   }
+}
+
+function void draw_thumbnail_strip(desktop_context *desktop, texture *destination)
+{
+   window_table *windows = desktop->windows;
+   if(!windows->order_count)
+   {
+      return;
+   }
+
+   vec4 color0 = (desktop->config.dark_mode) ? DEBUG_COLOR_BLACK : DEBUG_COLOR_WHITE;
+   vec4 color1 = (desktop->config.dark_mode) ? DEBUG_COLOR_WHITE : DEBUG_COLOR_BLACK;
+
+   rectangle strip = get_thumbnail_strip_rect(desktop);
+   draw_rectangle_rect(destination, strip, color0);
+   draw_rectangle(destination, strip.x, strip.y, strip.width, 1, color1);
+
+   u32 active_index = get_window_index(windows, desktop->active_window);
+   u32 capacity = get_thumbnail_capacity(desktop);
+   u32 position = 0;
+
+   for(u32 index = 0; index < windows->slot_count; ++index)
+   {
+      if(windows->state[index] == WINDOW_STATE_CLOSED)
+      {
+         continue;
+      }
+      if(position == capacity)
+      {
+         break;
+      }
 
-#if 0
-   // TODO: This resize logic correctly maps the mouse to the window in
-   // terms of positioning, but does not correctly account for the minimum
-   // window size - it causes the window to move instead.
+      rectangle rect = get_thumbnail_rect(desktop, position++);
+      texture *thumbnail = desktop->thumbnails.textures + index;
 
-   int deltax = (desktop->input.mousex - desktop->input.previous_mousex);
-   int deltay = (desktop->input.mousey - desktop->input.previous_mousey);
+      // NOTE: Minimized windows are drawn faded.
+      float opacity = (windows->state[index] == WINDOW_STATE_MINIMIZED) ? 0.4f : 1.0f;
+      draw_texture_translucent(destination, thumbnail, rect.x, rect.y, rect.width, rect.height, opacity);
+
+      vec4 outline = (index == active_index) ? DEBUG_COLOR_BLUE : color1;
+      draw_outline_rect(destination, resize_rectangle(rect, 1), outline);
+   }
 
-   switch(region_invariants[desktop->hot_region_index].interaction)
+   if(windows->order_count > capacity)
    {
-      case WINDOW_INTERACTION_NONE:
-      {
-         assert(!"Interacting with window without interaction type.");
-      } break;
+      char text[16];
+      int length = sprintf(text, "+%u", windows->order_count - capacity);
 
-      case WINDOW_INTERACTION_RAISE:
-      {
-         // NOTE: The window is raised for all interactions, so no need to do
-         // anything here.
-      } break;
+      s32 x = DESKTOP_THUMBNAIL_PADDING + (s32)capacity * (DESKTOP_THUMBNAIL_WIDTH + DESKTOP_THUMBNAIL_PADDING);
+      draw_text(destination, x, ALIGN_TEXT_VERTICALLY(strip.y, strip.height), color1, string8new((u8 *)text, length));
+   }
+}
 
-      case WINDOW_INTERACTION_MOVE:
-      {
-         if(window->state == WINDOW_STATE_MAXIMIZED)
-         {
-            window->state = WINDOW_STATE_NORMAL;
-            // window->content = window->unmaximized;
+function void draw_frame_timing_graph(texture *destination, desktop_input *input, s32 x, s32 y, s32 height)
+{
+   // NOTE: Each recorded frame is drawn as a stacked column of work, present
+   // and sleep time, scaled so that the target frame time fills the graph
+   // height. Frames that overshot their deadline get a red marker across the
+   // top of their column, longer the further they overshot.
+   float target_seconds = input->target_seconds_per_frame;
+   if(target_seconds <= 0.0f)
+   {
+      return;
+   }
 
-            window->x = input->mousex - (window->width / 2);
-            window->y = input->mousey + DESKTOP_WINDOW_HALFDIM_TITLEBAR;
-         }
+   float pixels_per_second = (float)height / target_seconds;
+   s32 width = DESKTOP_FRAME_TIMING_COUNT;
 
-         window->x += deltax;
-         window->y += deltay;
-      } break;
+   draw_rectangle(destination, x, y, width, height, DEBUG_COLOR_BLACK);
 
-      case WINDOW_INTERACTION_CLOSE:
-      {
-         if(was_released(input->keys[INPUT_KEY_MBLEFT]))
-         {
-            window->state = WINDOW_STATE_CLOSED;
-         }
-      } break;
+   // NOTE: Slow frames stack up past the target, so keep them inside the graph.
+   push_clip(destination, x, y, width, height);
+   for(u32 column = 0; column < DESKTOP_FRAME_TIMING_COUNT; ++column)
+   {
+      // NOTE: Start from the oldest entry so the graph scrolls left.
+      u32 index = (input->frame_timing_index + column) % DESKTOP_FRAME_TIMING_COUNT;
+      frame_timing *timing = input->frame_timings + index;
 
-      case WINDOW_INTERACTION_MAXIMIZE:
-      {
-         if(was_released(input->keys[INPUT_KEY_MBLEFT]))
-         {
-            if(window->state == WINDOW_STATE_NORMAL)
-            {
-               window->state = WINDOW_STATE_MAXIMIZED;
-               // window->unmaximized = window->content;
+      s32 work = (s32)(timing->work_seconds * pixels_per_second);
+      s32 present = (s32)(timing->present_seconds * pixels_per_second);
+      s32 sleep = (s32)(timing->sleep_seconds * pixels_per_second);
 
-               // TODO: Stop hard-coding offsets here.
-               window->x = DESKTOP_WINDOW_DIM_EDGE;
-               window->y = DESKTOP_WINDOW_DIM_EDGE + DESKTOP_WINDOW_DIM_TITLEBAR;
-               window->width = desktop->backbuffer.width - (2 * DESKTOP_WINDOW_DIM_EDGE);
-               window->height = desktop->backbuffer.height - window->y - DESKTOP_TASKBAR_HEIGHT - DESKTOP_WINDOW_DIM_EDGE;
+      s32 columnx = x + (s32)column;
+      s32 bottom = y + height;
 
-            }
-            else
-            {
-               window->state = WINDOW_STATE_NORMAL;
-               // window->content = window->unmaximized;
-            }
-         }
-      } break;
+      draw_rectangle(destination, columnx, bottom - work, 1, work, DEBUG_COLOR_GREEN);
+      bottom -= work;
+      draw_rectangle(destination, columnx, bottom - present, 1, present, DEBUG_COLOR_YELLOW);
+      bottom -= present;
+      draw_rectangle(destination, columnx, bottom - sleep, 1, sleep, DEBUG_COLOR_BLUE);
 
-      case WINDOW_INTERACTION_MINIMIZE:
+      if(timing->overshoot_seconds > 0.0f)
       {
-         if(was_released(input->keys[INPUT_KEY_MBLEFT]))
-         {
-            if(window->state != WINDOW_STATE_MINIMIZED)
-            {
-               minimize_window(desktop, window);
-            }
-            else
-            {
-               window->state = WINDOW_STATE_NORMAL;
-            }
-         }
-      } break;
+         s32 overshoot = MAXIMUM(1, (s32)(timing->overshoot_seconds * pixels_per_second));
+         overshoot = MINIMUM(overshoot, MAXIMUM(1, height/8));
+         draw_rectangle(destination, columnx, y, 1, overshoot, DEBUG_COLOR_RED);
+      }
+   }
+   pop_clip(destination);
 
-      case WINDOW_INTERACTION_RESIZE_N:
-      {
-         window->y += deltay;
-         window->height -= deltay;
-      } break;
+   draw_outline(destination, x - 1, y - 1, width + 2, height + 2, DEBUG_COLOR_WHITE);
+}
 
-      case WINDOW_INTERACTION_RESIZE_S:
-      {
-         window->height += deltay;
-      } break;
+#define FRAME_HISTOGRAM_BUCKET_COUNT 32
 
-      case WINDOW_INTERACTION_RESIZE_W:
-      {
-         window->x += deltax;
-         window->width -= deltax;
-      } break;
+function void draw_frame_time_histogram(texture *destination, desktop_input *input, s32 x, s32 y, s32 width, s32 height)
+{
+   // NOTE: Bucket the busy portion (work plus present) of every recorded frame.
+   // The buckets span twice the target frame time, so the target lands in the
+   // middle of the graph and anything slower piles up in the last bucket.
+   float target_seconds = input->target_seconds_per_frame;
+   if(target_seconds <= 0.0f)
+   {
+      return;
+   }
 
-      case WINDOW_INTERACTION_RESIZE_E:
-      {
-         window->width += deltax;
-      } break;
+   u32 buckets[FRAME_HISTOGRAM_BUCKET_COUNT] = {0};
+   float seconds_per_bucket = (2.0f * target_seconds) / FRAME_HISTOGRAM_BUCKET_COUNT;
 
-      case WINDOW_INTERACTION_RESIZE_NW:
-      {
-         window->width -= deltax;
-         window->height -= deltay;
+   u32 max_count = 1;
+   for(u32 index = 0; index < DESKTOP_FRAME_TIMING_COUNT; ++index)
+   {
+      frame_timing *timing = input->frame_timings + index;
+      float busy_seconds = timing->work_seconds + timing->present_seconds;
 
-         window->x += deltax;
-         window->y += deltay;
-      } break;
+      u32 bucket = (u32)(busy_seconds / seconds_per_bucket);
+      bucket = MINIMUM(bucket, FRAME_HISTOGRAM_BUCKET_COUNT - 1);
 
-      case WINDOW_INTERACTION_RESIZE_NE:
-      {
-         window->y += deltay;
-         window->width += deltax;
-         window->height -= deltay;
-      } break;
+      buckets[bucket]++;
+      max_count = MAXIMUM(max_count, buckets[bucket]);
+   }
 
-      case WINDOW_INTERACTION_RESIZE_SW:
-      {
-         window->x += deltax;
-         window->width -= deltax;
-         window->height += deltay;
-      } break;
+   draw_rectangle(destination, x, y, width, height, DEBUG_COLOR_BLACK);
 
-      case WINDOW_INTERACTION_RESIZE_SE:
-      {
-         window->width += deltax;
-         window->height += deltay;
-      } break;
+   s32 bucket_width = MAXIMUM(1, width / FRAME_HISTOGRAM_BUCKET_COUNT);
+   for(u32 bucket = 0; bucket < FRAME_HISTOGRAM_BUCKET_COUNT; ++bucket)
+   {
+      s32 bar_height = (s32)(buckets[bucket] * height / max_count);
+      vec4 bar_color = (bucket < FRAME_HISTOGRAM_BUCKET_COUNT / 2) ? DEBUG_COLOR_GREEN : DEBUG_COLOR_RED;
 
-      default:
+      draw_rectangle(destination, x + (bucket * bucket_width), y + height - bar_height, bucket_width - 1, bar_height, bar_color);
+   }
+
+   draw_rectangle(destination, x + (width / 2), y, 1, height, DEBUG_COLOR_YELLOW);
+   draw_outline(destination, x - 1, y - 1, width + 2, height + 2, DEBUG_COLOR_WHITE);
+}
+
+#if DEVELOPMENT_BUILD
+function s32 draw_profile_flame_graph(texture *destination, desktop_input *input, s32 x, s32 y, s32 width)
+{
+   // NOTE: Draw the scopes of the last completed frame as horizontal bars, one
+   // row per nesting depth. The full width corresponds to the target frame
+   // time, so bars keep a consistent scale from frame to frame.
+   profile_frame *frame = get_previous_profile_frame();
+
+   double ticks_per_frame = profiler.ticks_per_second * input->target_seconds_per_frame;
+   if(ticks_per_frame <= 0.0)
+   {
+      return(y);
+   }
+
+   vec4 bar_colors[] = {
+      {0.85f, 0.35f, 0.20f, 1.0f},
+      {0.90f, 0.60f, 0.20f, 1.0f},
+      {0.80f, 0.75f, 0.25f, 1.0f},
+   };
+
+   s32 row_height = FONT_LEADING;
+   u32 max_depth = 0;
+
+   for(u32 event_index = 0; event_index < frame->event_count; ++event_index)
+   {
+      profile_event *event = frame->events + event_index;
+      max_depth = MAXIMUM(max_depth, event->depth);
+
+      s32 barx = x + (s32)((double)(event->begin - frame->begin) * width / ticks_per_frame);
+      s32 bary = y + (s32)event->depth * row_height;
+      s32 bar_width = MAXIMUM(1, (s32)((double)(event->end - event->begin) * width / ticks_per_frame));
+
+      draw_rectangle(destination, barx, bary, bar_width, row_height - 1, bar_colors[event_index % countof(bar_colors)]);
+
+      string8 name = string8new((u8 *)event->name, strlen(event->name));
+      rectangle text_bounds;
+      get_text_bounds(&text_bounds, name);
+      if(text_bounds.width + 4 <= bar_width)
       {
-         assert(!"Invalid default case.");
-      } break;
+         draw_text(destination, barx + 2, bary + 1, DEBUG_COLOR_BLACK, name);
+      }
    }
-#endif
+
+   s32 result = y + ((s32)max_depth + 1) * row_height;
+   draw_outline(destination, x - 1, y - 1, width + 2, (result - y) + 2, DEBUG_COLOR_WHITE);
+
+   return(result);
 }
+#endif
 
 function void draw_debug_overlay(desktop_context *desktop, texture *destination, desktop_input *input)
 {
    char overlay_text[32];
    vec4 color = (desktop->config.dark_mode) ? DEBUG_COLOR_BLACK : DEBUG_COLOR_WHITE;
+   vec4 panel_color = (desktop->config.dark_mode) ? DEBUG_COLOR_WHITE : DEBUG_COLOR_BLACK;
+   panel_color.a = 0.75f;
 
    s32 x = destination->width - (FONT_WIDTH * FONT_SCALE * sizeof(overlay_text));
    s32 y = 30;
 
+   draw_rectangle(destination, x - 8, y - 8, destination->width - x + 8, destination->height - y + 8, panel_color);
+
    draw_text_line(destination, x, &y, color, string8("DEBUG INFORMATION"));
    draw_text_line(destination, x, &y, color, string8("-----------------"));
 
@@ -949,7 +2107,7 @@ function void draw_debug_overlay(desktop_context *desktop, texture *destination,
    float frame_ms = input->frame_seconds_elapsed * 1000.0f;
    float target_ms = input->target_seconds_per_frame * 1000.0f;
 
-   u32 sleep_ms = input->sleep_ms;
+   float sleep_ms = input->sleep_seconds_elapsed * 1000.0f;
    float frame_utilization = ((frame_ms - sleep_ms) / target_ms * 100.0f);
 
    int length = sprintf(overlay_text, "Frame time:  %.04fms\n", frame_ms);
@@ -958,7 +2116,7 @@ function void draw_debug_overlay(desktop_context *desktop, texture *destination,
    length = sprintf(overlay_text, "Target time: %.04fms\n", target_ms);
    draw_text_line(destination, x, &y, color, string8new((u8 *)overlay_text, length));
 
-   length = sprintf(overlay_text, "Sleep time:  %ums\n", sleep_ms);
+   length = sprintf(overlay_text, "Sleep time:  %.04fms\n", sleep_ms);
    draw_text_line(destination, x, &y, color, string8new((u8 *)overlay_text, length));
 
    length = sprintf(overlay_text, "Work time:  %.2f%%\n", frame_utilization);
@@ -966,24 +2124,113 @@ function void draw_debug_overlay(desktop_context *desktop, texture *destination,
 
    length = sprintf(overlay_text, "Cursor Position: %d, %d\n", input->mousex, input->mousey);
    draw_text_line(destination, x, &y, color, string8new((u8 *)overlay_text, length));
+
+   texture_pool_stats pool_stats = get_texture_pool_stats(&desktop->canvas_pool);
+
+   length = sprintf(overlay_text, "Canvases: %u\n", pool_stats.allocation_count);
+   draw_text_line(destination, x, &y, color, string8new((u8 *)overlay_text, length));
+
+   length = sprintf(overlay_text, "Thumbnails: %u new %u stale\n",
+                    desktop->thumbnails.updated_count, desktop->thumbnails.stale_count);
+   draw_text_line(destination, x, &y, color, string8new((u8 *)overlay_text, length));
+
+   length = sprintf(overlay_text, "Terminal: %.1fMB/s\n", desktop->terminal.megabytes_per_second);
+   draw_text_line(destination, x, &y, color, string8new((u8 *)overlay_text, length));
+
+   length = snprintf(overlay_text, sizeof(overlay_text), "UI layout: %u hit %u miss\n",
+                     desktop->widgets_ui.layout_hit_count, desktop->widgets_ui.layout_miss_count);
+   draw_text_line(destination, x, &y, color, string8new((u8 *)overlay_text, length));
+
+   length = sprintf(overlay_text, "Canvas pool: %.1f/%.0fMB\n",
+                    (float)pool_stats.used_bytes / (float)MEGABYTES(1),
+                    (float)pool_stats.capacity / (float)MEGABYTES(1));
+   draw_text_line(destination, x, &y, color, string8new((u8 *)overlay_text, length));
+
+   length = sprintf(overlay_text, "Fragmentation: %.0f%% %.0f%%\n",
+                    pool_stats.internal_fragmentation * 100.0f,
+                    pool_stats.external_fragmentation * 100.0f);
+   draw_text_line(destination, x, &y, color, string8new((u8 *)overlay_text, length));
+
+   y = ADVANCE_TEXT_LINE(y);
+   draw_frame_timing_graph(destination, input, x, y, 64);
+   y += 64 + FONT_LEADING;
+
+   draw_text_line(destination, x, &y, color, string8("Frame time histogram"));
+   draw_frame_time_histogram(destination, input, x, y, 128, 48);
+   y += 48 + FONT_LEADING;
+
+#if DEVELOPMENT_BUILD
+   draw_text_line(destination, x, &y, color, string8("Profile (F2 writes trace)"));
+
+   profile_frame *frame = get_previous_profile_frame();
+   for(u32 event_index = 0; event_index < frame->event_count; ++event_index)
+   {
+      profile_event *event = frame->events + event_index;
+      if(event->depth == 0)
+      {
+         float ms = profile_ticks_to_ms(event->end - event->begin);
+
+         // NOTE: Show instructions per cycle too when the counters were read.
+         double ipc = 0.0;
+         if(event->counters_index < PROFILE_COUNTED_EVENT_MAX)
+         {
+            platform_counters *counters = frame->counted_events + event->counters_index;
+            u64 cycles = counters->values[PLATFORM_COUNTER_CYCLES];
+            if(cycles && (counters->available & (1 << PLATFORM_COUNTER_INSTRUCTIONS)))
+            {
+               ipc = (double)counters->values[PLATFORM_COUNTER_INSTRUCTIONS] / (double)cycles;
+            }
+         }
+
+         if(ipc > 0.0)
+         {
+            length = snprintf(overlay_text, sizeof(overlay_text), "%-10s %7.3fms %4.2fipc", event->name, ms, ipc);
+         }
+         else
+         {
+            length = snprintf(overlay_text, sizeof(overlay_text), "%-12s %8.4fms", event->name, ms);
+         }
+         length = MINIMUM(length, (int)sizeof(overlay_text) - 1);
+         draw_text_line(destination, x, &y, color, string8new((u8 *)overlay_text, length));
+      }
+   }
+
+   y = ADVANCE_TEXT_LINE(y);
+   draw_profile_flame_graph(destination, input, x, y, FONT_WIDTH * FONT_SCALE * sizeof(overlay_text) - 8);
+#endif
 }
 
 DESKTOP_INITIALIZE(desktop_initialize)
 {
-   // TODO: It would be nice if the desktop environment had no dynamic
-   // allocations. Get rid of the stdlib heap allocations.
-   memindex size = KILOBYTES(64);
-   arena_initialize(&desktop->window_arena, calloc(1, size), size);
-
-   size = MEGABYTES(256);
-   arena_initialize(&desktop->texture_arena, calloc(1, size), size);
-
-   size = KILOBYTES(64);
-   arena_initialize(&desktop->scratch_arena, calloc(1, size), size);
+   // NOTE: The arenas only reserve address space up front, and commit memory
+   // as they fill up.
+   b32 reserved = (arena_reserve(&desktop->window_arena, MEGABYTES(64)) &&
+                   arena_reserve(&desktop->texture_arena, GIGABYTES(1)) &&
+                   arena_reserve(&desktop->scratch_arena, MEGABYTES(64)));
+   assert(reserved);
 
    desktop->backbuffer.width = width;
    desktop->backbuffer.height = height;
    desktop->backbuffer.memory = arena_allocate(&desktop->texture_arena, u32, width*height);
+   desktop->backbuffer.clip = &desktop->backbuffer_clip;
+
+   texture_pool_initialize(&desktop->canvas_pool, &desktop->texture_arena, MEGABYTES(128));
+   initialize_window_shadow(desktop);
+
+   u32 thumbnail_pixel_count = DESKTOP_THUMBNAIL_WIDTH * DESKTOP_THUMBNAIL_HEIGHT;
+   u32 *thumbnail_memory = arena_allocate(&desktop->texture_arena, u32, DESKTOP_WINDOW_MAX_COUNT * thumbnail_pixel_count);
+   for(u32 index = 0; index < DESKTOP_WINDOW_MAX_COUNT; ++index)
+   {
+      texture *thumbnail = desktop->thumbnails.textures + index;
+      thumbnail->width = DESKTOP_THUMBNAIL_WIDTH;
+      thumbnail->height = DESKTOP_THUMBNAIL_HEIGHT;
+      thumbnail->memory = thumbnail_memory + (index * thumbnail_pixel_count);
+   }
+
+   desktop->windows = arena_allocate(&desktop->window_arena, window_table, 1);
+   zero_memory(desktop->windows, sizeof(*desktop->windows));
+
+   initialize_window_grid(desktop);
 
    create_window(desktop, string8("Test Window 0"));
    create_window(desktop, string8("Test Window 1"));
@@ -991,119 +2238,399 @@ DESKTOP_INITIALIZE(desktop_initialize)
    create_window(desktop, string8("Test Window 3"));
    create_window(desktop, string8("Test Window 4"));
 
-   desktop->hot_window = 0;
-   // desktop->hot_region_index = DESKTOP_REGION_NULL_INDEX;
+   initialize_terminal(&desktop->terminal, &desktop->texture_arena);
+   u32 terminal_index = create_window(desktop, string8("Terminal"));
+   if(terminal_index != DESKTOP_WINDOW_NULL_INDEX)
+   {
+      desktop->windows->windows[terminal_index].terminal = &desktop->terminal;
+      desktop->terminal_window = get_window_handle(desktop->windows, terminal_index);
+   }
+
+   u32 widgets_index = create_window(desktop, string8("Widgets"));
+   if(widgets_index != DESKTOP_WINDOW_NULL_INDEX)
+   {
+      desktop->windows->windows[widgets_index].ui = &desktop->widgets_ui;
+      desktop->widgets_window = get_window_handle(desktop->windows, widgets_index);
+   }
+   desktop->widgets_selected = -1;
+
+   window_handle null_handle = {0};
+   desktop->hot_window = null_handle;
+   desktop->active_region_index = DESKTOP_REGION_NULL_INDEX;
+
+   // NOTE: Read all the bitmaps in one batch, then decode them as they arrive.
+   struct {
+      texture *destination;
+      char *path;
+      u32 offsetx;
+      u32 offsety;
+   } bitmaps[] = {
+      {desktop->cursor_textures + CURSOR_ARROW,                  "cursor_arrow.bmp",             0, 0},
+      {desktop->cursor_textures + CURSOR_MOVE,                   "cursor_move.bmp",              8, 8},
+      {desktop->cursor_textures + CURSOR_RESIZE_VERT,            "cursor_vertical_resize.bmp",   4, 8},
+      {desktop->cursor_textures + CURSOR_RESIZE_HORI,            "cursor_horizontal_resize.bmp", 8, 4},
+      {desktop->cursor_textures + CURSOR_RESIZE_DIAG_L,          "cursor_diagonal_left.bmp",     7, 7},
+      {desktop->cursor_textures + CURSOR_RESIZE_DIAG_R,          "cursor_diagonal_right.bmp",    7, 7},
+      {desktop->region_textures + WINDOW_REGION_BUTTON_CLOSE,    "close.bmp",                    0, 0},
+      {desktop->region_textures + WINDOW_REGION_BUTTON_MAXIMIZE, "maximize.bmp",                 0, 0},
+      {desktop->region_textures + WINDOW_REGION_BUTTON_MINIMIZE, "minimize.bmp",                 0, 0},
+   };
+
+   arena_marker marker = arena_marker_set(&desktop->scratch_arena);
+   platform_io_batch bitmap_files = {&desktop->scratch_arena};
+   for(u32 index = 0; index < countof(bitmaps); ++index)
+   {
+      queue_file_load(&bitmap_files, bitmaps[index].path);
+   }
+   platform_submit_io(&bitmap_files);
 
-   desktop->cursor_textures[CURSOR_ARROW]         = load_bitmap(desktop, "cursor_arrow.bmp", 0, 0);
-   desktop->cursor_textures[CURSOR_MOVE]          = load_bitmap(desktop, "cursor_move.bmp", 8, 8);
-   desktop->cursor_textures[CURSOR_RESIZE_VERT]   = load_bitmap(desktop, "cursor_vertical_resize.bmp", 4, 8);
-   desktop->cursor_textures[CURSOR_RESIZE_HORI]   = load_bitmap(desktop, "cursor_horizontal_resize.bmp", 8, 4);
-   desktop->cursor_textures[CURSOR_RESIZE_DIAG_L] = load_bitmap(desktop, "cursor_diagonal_left.bmp", 7, 7);
-   desktop->cursor_textures[CURSOR_RESIZE_DIAG_R] = load_bitmap(desktop, "cursor_diagonal_right.bmp", 7, 7);
+   for(u32 index = 0; index < countof(bitmaps); ++index)
+   {
+      platform_io_request *request = wait_for_io(&bitmap_files, index);
+      assert(request->status == PLATFORM_IO_COMPLETE);
 
-   desktop->region_textures[WINDOW_REGION_BUTTON_CLOSE]    = load_bitmap(desktop, "close.bmp", 0, 0);
-   desktop->region_textures[WINDOW_REGION_BUTTON_MAXIMIZE] = load_bitmap(desktop, "maximize.bmp", 0, 0);
-   desktop->region_textures[WINDOW_REGION_BUTTON_MINIMIZE] = load_bitmap(desktop, "minimize.bmp", 0, 0);
+      *bitmaps[index].destination = load_bitmap(desktop, request->contents, bitmaps[index].offsetx, bitmaps[index].offsety);
+   }
+   arena_marker_restore(marker);
 
    initialize_font();
 
    // desktop->config.focus_follows_mouse = true;
 
+   desktop->needs_redraw = true;
+   desktop->wakeup_time_seconds = 0.0;
+   desktop->idle_timeout_ms = -1;
+
    desktop->is_initialized = true;
 }
 
+function void draw_background_bands(void *data, size first, size last)
+{
+   // NOTE: The fill pattern is anchored to the destination rather than the
+   // clip, so the bands line up seamlessly.
+   background_bands *bands = (background_bands *)data;
+
+   clip_stack clip = {0};
+   clip.entries[clip.count++] = get_clip_rectangle(bands->destination);
+
+   texture band = *bands->destination;
+   band.clip = &clip;
+
+   s32 miny = (s32)first * DESKTOP_BAND_HEIGHT;
+   s32 maxy = MINIMUM((s32)last * DESKTOP_BAND_HEIGHT, band.height);
+   push_clip(&band, 0, miny, band.width, maxy - miny);
+
+   draw_rectangle_25(&band, 0, 0, band.width, band.height, bands->color0, bands->color1);
+}
+
 DESKTOP_UPDATE(desktop_update)
 {
    desktop_input *input = &desktop->input;
 
-   if(was_pressed(input->keys[INPUT_KEY_MBRIGHT]))
+   // NOTE: A frame without input or a due timer can be skipped entirely. The
+   // debug overlay is the exception, since it graphs frame timings as they
+   // arrive.
+   bool timer_due = (desktop->wakeup_time_seconds != 0.0 &&
+                     input->time_seconds >= desktop->wakeup_time_seconds);
+
+   bool redraw = (desktop->needs_redraw ||
+                  desktop->config.display_debug_overlay ||
+                  desktop->animations.count > 0 ||
+                  timer_due ||
+                  input_changed(input));
+   if(!redraw)
    {
-      create_window_position(desktop, string8("New Window"), input->mousex, input->mousey);
+      compute_idle_timeout(desktop);
+      return(false);
    }
-   if(was_pressed(input->keys[INPUT_KEY_TAB]))
+
+   desktop->needs_redraw = false;
+   if(timer_due)
    {
-	  desktop->config.dark_mode = !desktop->config.dark_mode;
+      desktop->wakeup_time_seconds = 0.0;
    }
 
-   desktop->frame_cursor = CURSOR_ARROW;
+   PROFILE_FRAME_BEGIN();
 
-   // NOTE: Handle window interactions.
-   for(desktop_window *window = desktop->first_window; window; window = window->next)
+   PROFILE_SCOPE("input")
    {
-      if(window_wants_interaction(desktop, window))
+      if(was_pressed(input->keys[INPUT_KEY_MBRIGHT]))
+      {
+         create_window_position(desktop, string8("New Window"), input->mousex, input->mousey);
+      }
+      if(was_pressed(input->keys[INPUT_KEY_TAB]))
+      {
+         desktop->config.dark_mode = !desktop->config.dark_mode;
+
+         window_table *windows = desktop->windows;
+         for(u32 position = 0; position < windows->order_count; ++position)
+         {
+            windows->windows[windows->order[position]].canvas_dirty = true;
+         }
+      }
+      if(was_pressed(input->keys[INPUT_KEY_F1]))
+      {
+         desktop->config.display_debug_overlay = !desktop->config.display_debug_overlay;
+      }
+
+      update_terminal_window(desktop);
+      update_widgets_window(desktop);
+#if DEVELOPMENT_BUILD
+      if(was_pressed(input->keys[INPUT_KEY_F2]))
       {
-         interact_with_window(desktop, window);
+         char *trace_path = "desktop_trace.json";
+         if(profile_write_chrome_trace(trace_path))
+         {
+            log_info("Wrote profile trace to %s.\n", trace_path);
+         }
+         else
+         {
+            log_error("ERROR: Failed to write profile trace to %s.\n", trace_path);
+         }
       }
+#endif
    }
 
-   // NOTE: Defer "closing" the windows until after interactions are complete,
-   // so that shuffling the list doesn't impact the loop.
-   for(desktop_window *window = desktop->first_window; window; window = window->next)
+   desktop->frame_cursor = CURSOR_ARROW;
+
+   PROFILE_SCOPE("interaction")
    {
-      if(window->state == WINDOW_STATE_CLOSED)
+      // NOTE: Clicking a taskbar tab or thumbnail brings its window to the
+      // front, restoring it if minimized. The click is not passed on to the
+      // windows underneath.
+      bool click_consumed = false;
+      if(was_pressed(input->keys[INPUT_KEY_MBLEFT]))
       {
-         window = close_window(desktop, window);
+         u32 clicked_index = find_taskbar_tab_at(desktop, input->mousex, input->mousey);
+         if(clicked_index == DESKTOP_WINDOW_NULL_INDEX)
+         {
+            clicked_index = find_thumbnail_at(desktop, input->mousex, input->mousey);
+         }
+
+         if(clicked_index != DESKTOP_WINDOW_NULL_INDEX)
+         {
+            if(desktop->windows->state[clicked_index] == WINDOW_STATE_MINIMIZED)
+            {
+               restore_window(desktop, clicked_index);
+            }
+            else
+            {
+               raise_window(desktop, clicked_index);
+            }
+            click_consumed = true;
+         }
+      }
+
+      // NOTE: Handle window interactions. Interacting raises windows, so walk
+      // a snapshot of the sorting order rather than the live array.
+      window_table *windows = desktop->windows;
 
-         desktop->active_window = 0;
-         desktop->hot_window = 0;
+      u32 order_count = windows->order_count;
+      u32 order[DESKTOP_WINDOW_MAX_COUNT];
+      memcpy(order, windows->order, order_count * sizeof(*order));
 
-         if(!window)
+      for(u32 position = 0; position < order_count && !click_consumed; ++position)
+      {
+         if(window_wants_interaction(desktop, order[position]))
          {
-            break;
+            interact_with_window(desktop, order[position]);
+         }
+      }
+
+      // NOTE: Defer "closing" the windows until after interactions are
+      // complete, then compact the sorting order in place.
+      u32 open_count = 0;
+      for(u32 position = 0; position < windows->order_count; ++position)
+      {
+         u32 index = windows->order[position];
+         if(windows->state[index] == WINDOW_STATE_CLOSED)
+         {
+            close_window(desktop, index);
+         }
+         else
+         {
+            windows->order[open_count++] = index;
          }
       }
+      windows->order_count = open_count;
    }
 
    // NOTE: Don't let other windows grab focus when dragging a window around,
    // always give precedence to the active window.
-   if(desktop->active_window && is_window_visible(desktop->active_window))
+   u32 active_index = get_window_index(desktop->windows, desktop->active_window);
+   if(active_index != DESKTOP_WINDOW_NULL_INDEX && is_window_visible(desktop->windows, active_index))
    {
       desktop->hot_window = desktop->active_window;
    }
 
+   // NOTE: Pick the cursor from the region being dragged, or otherwise the
+   // region under the mouse.
+   u32 cursor_region = DESKTOP_REGION_NULL_INDEX;
+   if(active_index != DESKTOP_WINDOW_NULL_INDEX)
+   {
+      cursor_region = desktop->active_region_index;
+   }
+   else
+   {
+      u32 hover_index = find_window_at(desktop, input->mousex, input->mousey);
+      if(hover_index != DESKTOP_WINDOW_NULL_INDEX)
+      {
+         cursor_region = get_window_region(desktop->windows, hover_index, input->mousex, input->mousey);
+      }
+   }
+   if(cursor_region != DESKTOP_REGION_NULL_INDEX)
+   {
+      desktop->frame_cursor = region_invariants[cursor_region].cursor;
+   }
+
+   PROFILE_SCOPE("animation")
+   {
+      update_window_animations(desktop);
+   }
+
    // NOTE: Draw desktop.
    vec4 color0 = (desktop->config.dark_mode) ? DEBUG_COLOR_BLACK : DEBUG_COLOR_WHITE;
    vec4 color1 = (desktop->config.dark_mode) ? DEBUG_COLOR_WHITE : DEBUG_COLOR_BLACK;
 
-   draw_rectangle_25(&desktop->backbuffer, 0, 0, desktop->backbuffer.width, desktop->backbuffer.height, color0, color1);
-   // draw_debug_overlay(&desktop->backbuffer, &input);
+   PROFILE_SCOPE("background")
+   {
+      background_bands bands = {&desktop->backbuffer, color0, color1};
+      size band_count = (desktop->backbuffer.height + DESKTOP_BAND_HEIGHT - 1) / DESKTOP_BAND_HEIGHT;
+      parallel_for(band_count, 1, draw_background_bands, &bands);
+   }
 
-   // NOTE: Draw windows and their regions in reverse order, so that the earlier
-   // elements in the list appear on top.
-   for(desktop_window *window = desktop->last_window; window; window = window->prev)
+   PROFILE_SCOPE("windows")
    {
-      draw_window(desktop, window, &desktop->backbuffer);
+      // NOTE: Draw windows and their regions in reverse order, so that the
+      // earlier elements in the sorting order appear on top.
+      window_table *windows = desktop->windows;
+      for(u32 position = windows->order_count; position > 0; --position)
+      {
+         PROFILE_SCOPE("draw_window")
+         {
+            u32 index = windows->order[position - 1];
+
+            window_animation *animation = get_window_animation(desktop, index);
+            if(animation)
+            {
+               draw_window_animation(desktop, index, animation, &desktop->backbuffer);
+            }
+            else
+            {
+               draw_window(desktop, index, &desktop->backbuffer);
+            }
+         }
+      }
    }
 
-   // NOTE: Draw desktop menu bar.
-   rectangle taskbar = create_rectangle(0, 0, desktop->backbuffer.width, DESKTOP_TASKBAR_HEIGHT);
-   draw_rectangle_rect(&desktop->backbuffer, taskbar, color0);
-   draw_rectangle(&desktop->backbuffer, 0, taskbar.height, desktop->backbuffer.width, 1, color1);
+   PROFILE_SCOPE("thumbnails")
+   {
+      update_window_thumbnails(desktop);
+      draw_thumbnail_strip(desktop, &desktop->backbuffer);
+   }
 
-   string8 menu_items[] = {
-      string8("Exo"),
-      string8("::"),
-      string8("File"),
-      string8("Edit"),
-      string8("View"),
-   };
+   PROFILE_SCOPE("taskbar")
+   {
+      // NOTE: Draw desktop menu bar.
+      rectangle taskbar = create_rectangle(0, 0, desktop->backbuffer.width, DESKTOP_TASKBAR_HEIGHT);
+      draw_rectangle_rect(&desktop->backbuffer, taskbar, color0);
+      draw_rectangle(&desktop->backbuffer, 0, taskbar.height, desktop->backbuffer.width, 1, color1);
+
+      string8 menu_items[] = {
+         string8("Exo"),
+         string8("::"),
+         string8("File"),
+         string8("Edit"),
+         string8("View"),
+      };
+
+      int menu_item_padding = 16;
+      int menu_itemx = menu_item_padding;
+
+      for(int index = 0; index < countof(menu_items); ++index)
+      {
+         rectangle rect;
+         string8 text = menu_items[index];
+         get_text_bounds(&rect, text);
+
+         int menu_itemy = ALIGN_TEXT_VERTICALLY(0, DESKTOP_TASKBAR_HEIGHT);
+
+         draw_text(&desktop->backbuffer, menu_itemx, menu_itemy, color1, text);
+         menu_itemx += rect.width + menu_item_padding;
+      }
+
+      // NOTE: Draw a tab for each minimized window.
+      window_table *windows = desktop->windows;
+      u32 tab = 0;
+      for(u32 index = 0; index < windows->slot_count; ++index)
+      {
+         if(windows->state[index] == WINDOW_STATE_MINIMIZED)
+         {
+            rectangle tab_rect = get_taskbar_tab_rect(desktop, tab++);
+            draw_outline_rect(&desktop->backbuffer, tab_rect, color1);
+
+            string8 title = windows->windows[index].title;
+            title.length = MINIMUM(title.length, (memindex)((tab_rect.width - 8) / (FONT_WIDTH * FONT_SCALE)));
 
-   int menu_item_padding = 16;
-   int menu_itemx = menu_item_padding;
+            int taby = ALIGN_TEXT_VERTICALLY(tab_rect.y, tab_rect.height);
+            draw_text(&desktop->backbuffer, tab_rect.x + 4, taby, color1, title);
+         }
+      }
+   }
+
+   if(desktop->config.display_debug_overlay)
+   {
+      PROFILE_SCOPE("overlay")
+      {
+         draw_debug_overlay(desktop, &desktop->backbuffer, input);
+      }
+   }
 
-   for(int index = 0; index < countof(menu_items); ++index)
+   PROFILE_SCOPE("cursor")
    {
-      rectangle rect;
-      string8 text = menu_items[index];
-      get_text_bounds(&rect, text);
+      texture *cursor_texture = desktop->cursor_textures + desktop->frame_cursor;
 
-      int menu_itemy = ALIGN_TEXT_VERTICALLY(0, DESKTOP_TASKBAR_HEIGHT);
+      float scale = desktop->config.cursor_scale;
+      if(scale > 0.0f && scale != 1.0f)
+      {
+         // NOTE: Integer scales keep the cursor's hard pixel edges.
+         texture_filter filter = (scale == (float)(s32)scale) ? TEXTURE_FILTER_NEAREST : TEXTURE_FILTER_BILINEAR;
 
-      draw_text(&desktop->backbuffer, menu_itemx, menu_itemy, color1, text);
-      menu_itemx += rect.width + menu_item_padding;
+         s32 width = (s32)(cursor_texture->width * scale + 0.5f);
+         s32 height = (s32)(cursor_texture->height * scale + 0.5f);
+         draw_texture_scaled(&desktop->backbuffer, cursor_texture, input->mousex, input->mousey, width, height, filter, 1.0f);
+      }
+      else
+      {
+         draw_texture(&desktop->backbuffer, cursor_texture, input->mousex, input->mousey);
+      }
    }
 
-   // NOTE: Draw cursor.
-   texture *cursor_texture = desktop->cursor_textures + desktop->frame_cursor;
-   draw_texture(&desktop->backbuffer, cursor_texture, input->mousex, input->mousey);
+   compute_idle_timeout(desktop);
+
+   PROFILE_FRAME_END();
+
+   return(true);
+}
+
+DESKTOP_SHUTDOWN(desktop_shutdown)
+{
+   log_arena_statistics("window", &desktop->window_arena);
+   log_arena_statistics("texture", &desktop->texture_arena);
+   log_arena_statistics("scratch", &desktop->scratch_arena);
+}
+
+DESKTOP_TERMINAL_WRITE(desktop_terminal_write)
+{
+   desktop_terminal *terminal = &desktop->terminal;
+   write_terminal(terminal, data, count);
+
+   // NOTE: Output for a closed or minimized terminal window is still recorded,
+   // but doesn't need to be shown.
+   u32 index = get_window_index(desktop->windows, desktop->terminal_window);
+   if(index != DESKTOP_WINDOW_NULL_INDEX && terminal_has_changes(terminal))
+   {
+      desktop->windows->windows[index].canvas_dirty = true;
+      desktop->needs_redraw |= is_window_visible(desktop->windows, index);
+   }
 }
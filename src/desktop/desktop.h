@@ -6,6 +6,7 @@
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 
 // TODO(law): Make these configurable.
 #define DESKTOP_TASKBAR_HEIGHT 20
@@ -56,6 +57,16 @@ typedef struct {
 } bitmap_header;
 #pragma pack(pop)
 
+// NOTE: Drawing into a texture is restricted to the top of its clip stack, if
+// it has one. Each pushed rectangle is intersected with the one below it, so
+// the top entry is always the effective clip.
+#define TEXTURE_CLIP_STACK_MAX 16
+
+typedef struct {
+   u32 count;
+   rectangle entries[TEXTURE_CLIP_STACK_MAX];
+} clip_stack;
+
 typedef struct texture {
    s32 width;
    s32 height;
@@ -63,8 +74,29 @@ typedef struct texture {
 
    s32 offsetx;
    s32 offsety;
+
+   clip_stack *clip;
 } texture;
 
+// NOTE: Single channel coverage values in the range [0, 1], used for effects
+// like blurred drop shadows. The stride allows drawing a sub-rectangle of a
+// larger mask without copying it.
+typedef struct {
+   s32 width;
+   s32 height;
+   s32 stride;
+   float *memory;
+} alpha_mask;
+
+// NOTE: Coverage stored as bytes from 0 to 255, for masks that are kept
+// around rather than rebuilt. A stride of zero repeats the first row.
+typedef struct {
+   s32 width;
+   s32 height;
+   s32 stride;
+   u8 *memory;
+} coverage_mask;
+
 typedef struct {
    bool is_pressed;
    bool changed_state;
@@ -72,6 +104,8 @@ typedef struct {
 
 typedef enum {
    INPUT_KEY_TAB,
+   INPUT_KEY_F1,
+   INPUT_KEY_F2,
    INPUT_KEY_MBLEFT,
    INPUT_KEY_MBMIDDLE,
    INPUT_KEY_MBRIGHT,
@@ -81,6 +115,21 @@ typedef enum {
    INPUT_KEY_COUNT,
 } input_key_type;
 
+#define DESKTOP_TEXT_INPUT_MAX 64
+
+// NOTE: The host records how each frame was spent into a small ring buffer, so
+// that the debug overlay can graph pacing behavior over time. All values are in
+// seconds. Overshoot is how late the frame ended relative to its target
+// deadline, and can be negative when the host wakes up slightly early.
+#define DESKTOP_FRAME_TIMING_COUNT 128
+
+typedef struct {
+   float work_seconds;
+   float sleep_seconds;
+   float present_seconds;
+   float overshoot_seconds;
+} frame_timing;
+
 typedef struct {
    s32 mousex;
    s32 mousey;
@@ -90,10 +139,25 @@ typedef struct {
 
    input_state keys[INPUT_KEY_COUNT];
 
+   // NOTE: Text typed since the previous frame, already translated by the host
+   // into the bytes a terminal expects (e.g. '\r' for return). The wheel delta
+   // is in notches, positive when scrolling away from the user.
+   u32 text_length;
+   u8 text[DESKTOP_TEXT_INPUT_MAX];
+   s32 wheel_delta;
+
+   // NOTE: Monotonic host clock, used to schedule timer-driven updates.
+   double time_seconds;
+
    u32 frame_count;
-   u32 sleep_ms;
+   float sleep_seconds_elapsed;
    float frame_seconds_elapsed;
    float target_seconds_per_frame;
+
+   // NOTE: frame_timing_index refers to the next entry to be written, so the
+   // most recent frame lives at (frame_timing_index - 1).
+   u32 frame_timing_index;
+   frame_timing frame_timings[DESKTOP_FRAME_TIMING_COUNT];
 } desktop_input;
 
 typedef enum {
@@ -164,6 +228,8 @@ global vec4 DEBUG_COLOR_WHITE = {1.0f, 1.0f, 1.0f, 1.0f};
 global vec4 DEBUG_COLOR_BLACK = {0.0f, 0.0f, 0.0f, 1.0f};
 global vec4 DEBUG_COLOR_GREEN = {0.0f, 1.0f, 0.0f, 1.0f};
 global vec4 DEBUG_COLOR_BLUE = {0.0f, 0.0f, 1.0f, 1.0f};
+global vec4 DEBUG_COLOR_RED = {1.0f, 0.0f, 0.0f, 1.0f};
+global vec4 DEBUG_COLOR_YELLOW = {1.0f, 1.0f, 0.0f, 1.0f};
 
 global vec4 PALETTE[] =
 {
@@ -185,37 +251,339 @@ typedef struct {
    u32 region_index;
 } hit_result;
 
+// NOTE: A character cell terminal, drawn with the bitmap font. Lines live in a
+// ring of TERMINAL_SCROLLBACK_LINES, addressed by an absolute line number that
+// only ever increases. The screen shows the last rows lines ending at
+// last_line, shifted back by view_offset while browsing the scrollback.
+//
+// Changes are tracked so that rasterizing costs only what changed: rows whose
+// cells were written are flagged in dirty_rows, and scrolling accumulates in
+// pending_scroll, which is applied to the canvas with a single region copy
+// before the dirty rows are redrawn.
+#define TERMINAL_MAX_COLUMNS 256
+#define TERMINAL_MAX_ROWS 128
+#define TERMINAL_SCROLLBACK_LINES 4096
+#define TERMINAL_INPUT_MAX 1024
+
+// NOTE: The most bytes the host should pass to desktop_terminal_write per
+// frame. Parsing is the only cost that grows with the amount of output, so
+// this bounds the frame time while a large file is streamed through.
+#define TERMINAL_WRITE_BUDGET MEGABYTES(4)
+
+typedef enum {
+   TERMINAL_PARSE_TEXT,
+   TERMINAL_PARSE_ESCAPE,
+   TERMINAL_PARSE_CSI,
+   TERMINAL_PARSE_OSC,
+} terminal_parse_state;
+
+typedef struct {
+   u8 *cells;
+
+   u32 columns;
+   u32 rows;
+
+   u32 last_line;
+   u32 cursor_line;
+   u32 cursor_column;
+   u32 view_offset;
+
+   terminal_parse_state parse_state;
+   u32 parameters[2];
+   u32 parameter_index;
+
+   u64 dirty_rows[TERMINAL_MAX_ROWS / 64];
+   s32 pending_scroll;
+   bool needs_full_redraw;
+   u32 drawn_background;
+
+   // NOTE: Bytes typed into the terminal, waiting for the host to forward them
+   // to the attached process.
+   u32 input_length;
+   u8 input[TERMINAL_INPUT_MAX];
+
+   // NOTE: Output throughput, measured over one second windows.
+   u64 bytes_written;
+   u64 window_bytes;
+   double window_start_seconds;
+   float megabytes_per_second;
+} desktop_terminal;
+
+// NOTE: Persistent state for the immediate-mode widgets in ui.c. Widgets are
+// identified by a hash of their label and their parent's id, and anything that
+// must outlive a frame (scroll offsets, cached layout) is kept in a small open
+// addressed table keyed by that id. Entries that go unused are recycled, oldest
+// first, when the table is full.
+#define UI_CACHE_COUNT 256
+#define UI_CACHE_PROBE_MAX 16
+
+typedef struct {
+   u64 id;
+   u32 last_frame;
+
+   // NOTE: The widget's bounds relative to its parent's content area, valid
+   // while the hash of the inputs that produced them matches layout_key.
+   u64 layout_key;
+   rectangle bounds;
+
+   // NOTE: Only used by scroll areas. The content height is measured while
+   // the area is built, so clamping the scroll offset uses the previous
+   // frame's value.
+   s32 scroll;
+   s32 content_height;
+} ui_cache_entry;
+
+typedef struct {
+   ui_cache_entry entries[UI_CACHE_COUNT];
+   clip_stack clip;
+
+   u64 hot_id;
+   u64 active_id;
+   s32 drag_offset;
+   u32 frame;
+
+   // NOTE: Set by the owner of the state when mouse input should reach the
+   // widgets, e.g. when no other window is covering them.
+   bool has_mouse;
+
+   u32 layout_hit_count;
+   u32 layout_miss_count;
+   u32 widget_count;
+} ui_state;
+
+#define DESKTOP_WIDGETS_ITEM_COUNT 10000
+
 struct desktop_window
 {
+   // NOTE: Cold per-window data, only touched when a specific window is drawn
+   // or interacted with. The fields scanned every frame live in the parallel
+   // arrays of window_table.
    string8 title;
-   window_state state;
-   s32 z;
-
-   union
-   {
-      rectangle bounds;
-      struct
-      {
-         int x;
-         int y;
-         int width;
-         int height;
-      };
-   };
-
    texture canvas;
    rectangle unmaximized;
    bool display_infobar;
 
-   desktop_window *prev;
-   desktop_window *next;
+   // NOTE: The canvas memory block can hold canvas_capacity pixels, which may
+   // exceed the current canvas dimensions while the window is being resized.
+   // The canvas is only re-rasterized when canvas_dirty is set.
+   u32 canvas_capacity;
+   bool canvas_dirty;
+
+   // NOTE: The state to return to when a minimized window is restored.
+   window_state restore_state;
+
+   // NOTE: Incremented every time the canvas is re-rasterized, so that caches
+   // derived from it can tell when they're stale.
+   u32 canvas_version;
+
+   // NOTE: Set for terminal windows, which rasterize the terminal's cell grid
+   // instead of the default contents.
+   desktop_terminal *terminal;
+
+   // NOTE: Set for windows whose contents are built from widgets every time
+   // the canvas is rasterized.
+   ui_state *ui;
 };
 
+// NOTE: Windows are referred to outside of the table by generational handles.
+// The low 16 bits hold the slot index and the high 16 bits hold the generation
+// of the slot when the handle was created. Closing a window bumps the
+// generation of its slot, so stale handles resolve to no window instead of
+// dangling. Generation 0 is never issued, making a zeroed handle null.
+typedef struct {
+   u32 value;
+} window_handle;
+
+#define WINDOW_HANDLE_INDEX_BITS 16
+#define WINDOW_HANDLE_INDEX_MASK ((1u << WINDOW_HANDLE_INDEX_BITS) - 1)
+
+typedef struct {
+   // NOTE: Hot data, stored as parallel arrays indexed by slot. The z values
+   // are monotonically increasing stamps assigned when a window is raised.
+   rectangle bounds[DESKTOP_WINDOW_MAX_COUNT];
+   window_state state[DESKTOP_WINDOW_MAX_COUNT];
+   s32 z[DESKTOP_WINDOW_MAX_COUNT];
+   u16 generation[DESKTOP_WINDOW_MAX_COUNT];
+
+   desktop_window windows[DESKTOP_WINDOW_MAX_COUNT];
+
+   // NOTE: Dense list of open slots in sorting order. order[0] refers to the
+   // top-level window, so it undergoes hit detection first and rendering last.
+   u32 order_count;
+   u32 order[DESKTOP_WINDOW_MAX_COUNT];
+
+   u32 free_count;
+   u32 free_slots[DESKTOP_WINDOW_MAX_COUNT];
+
+   u32 slot_count;
+   s32 next_z;
+} window_table;
+
+// NOTE: Window transitions are tweened from one set of bounds and opacity to
+// another. The window's own state and bounds change immediately when a
+// transition starts, so hit testing is never affected. Only drawing uses the
+// in-between values. The scheduler only does work while transitions are live.
+#define DESKTOP_ANIMATION_SECONDS 0.2f
+
+typedef enum {
+   WINDOW_ANIMATION_MINIMIZE,
+   WINDOW_ANIMATION_RESTORE,
+   WINDOW_ANIMATION_MAXIMIZE,
+   WINDOW_ANIMATION_UNMAXIMIZE,
+} window_animation_type;
+
+typedef struct {
+   window_handle window;
+   window_animation_type type;
+
+   rectangle from_bounds;
+   rectangle to_bounds;
+   float from_opacity;
+   float to_opacity;
+
+   float elapsed_seconds;
+   float duration_seconds;
+} window_animation;
+
+typedef struct {
+   u32 count;
+   window_animation entries[DESKTOP_WINDOW_MAX_COUNT];
+} window_animation_scheduler;
+
+// NOTE: Downscaled copies of each window's canvas, shown in a strip along the
+// bottom of the desktop. A thumbnail is regenerated only when its version no
+// longer matches the canvas, and at most DESKTOP_THUMBNAIL_UPDATES_PER_FRAME
+// are regenerated per frame. Any left over are picked up on later frames.
+#define DESKTOP_THUMBNAIL_WIDTH 64
+#define DESKTOP_THUMBNAIL_HEIGHT 40
+#define DESKTOP_THUMBNAIL_PADDING 4
+#define DESKTOP_THUMBNAIL_UPDATES_PER_FRAME 4
+
+typedef struct {
+   texture textures[DESKTOP_WINDOW_MAX_COUNT];
+   u32 versions[DESKTOP_WINDOW_MAX_COUNT];
+
+   u32 next_update_index;
+   u32 updated_count;
+   u32 stale_count;
+} thumbnail_cache;
+
+// NOTE: Full-screen passes are split into horizontal bands of this many rows
+// and drawn in parallel on the job system. Each band draws through a clip stack
+// of its own, so the bands never touch the same pixels.
+#define DESKTOP_BAND_HEIGHT 64
+
+typedef struct {
+   texture *destination;
+   vec4 color0;
+   vec4 color1;
+} background_bands;
+
+// NOTE: Window drop shadows are a Gaussian blurred window silhouette, padded
+// by DESKTOP_SHADOW_RADIUS on every side. The blur is separable, so the shadow
+// is the product of a horizontal and a vertical edge profile, and a window at
+// least DESKTOP_SHADOW_SLICE on a side can be composed from nine slices: four
+// corners, four edges whose coverage is constant along their length, and a
+// fully covered centre that the window hides anyway. The slices are blurred
+// once at startup and kept as 8-bit coverage, so no window size ever blurs
+// again. The radius must cover the full extent of the three box passes used to
+// approximate a blur of DESKTOP_SHADOW_SIGMA.
+#define DESKTOP_SHADOW_RADIUS 12
+#define DESKTOP_SHADOW_SIGMA 4.0f
+#define DESKTOP_SHADOW_OFFSET 3
+#define DESKTOP_SHADOW_OPACITY 0.35f
+#define DESKTOP_SHADOW_SLICE (2 * DESKTOP_SHADOW_RADIUS)
+
+typedef struct {
+   // NOTE: The corners are laid out as they'd surround a window exactly
+   // DESKTOP_SHADOW_SLICE on a side, one per quadrant. The profile runs across
+   // the leading edge and then the trailing one, matching a row of corners.
+   coverage_mask corners;
+   u8 *profile;
+} shadow_slices;
+
 typedef struct {
    bool focus_follows_mouse;
    bool dark_mode;
+   bool display_debug_overlay;
+
+   // NOTE: Scale applied to the cursor bitmaps, set by the host from the
+   // display's content scale. Zero is treated as unscaled.
+   float cursor_scale;
 } desktop_configuration;
 
+// NOTE: Uniform grid over the backbuffer, used to accelerate hit testing. Each
+// cell holds a bitset of the visible windows whose bounds overlap it, so that
+// finding the topmost window under a point only considers the handful of
+// windows near it. Entries are updated incrementally whenever a window moves,
+// resizes or changes visibility. Raising a window only touches its z value.
+#define DESKTOP_GRID_CELL_DIM 64
+#define DESKTOP_WINDOW_BITSET_COUNT ((DESKTOP_WINDOW_MAX_COUNT + 63) / 64)
+
+typedef struct {
+   u64 bits[DESKTOP_WINDOW_BITSET_COUNT];
+} window_bitset;
+
+typedef struct {
+   s32 columns;
+   s32 rows;
+   window_bitset *cells;
+
+   // NOTE: The bounds each window was last inserted with, so that it can be
+   // removed from exactly the cells it occupies.
+   bool is_indexed[DESKTOP_WINDOW_MAX_COUNT];
+   rectangle indexed_bounds[DESKTOP_WINDOW_MAX_COUNT];
+} window_grid;
+
+// NOTE: Buddy allocator for window canvases, carved out of texture_arena. The
+// pool is split into power-of-two blocks of at least TEXTURE_POOL_MIN_BLOCK_SIZE
+// bytes. Freed blocks are merged with their buddies, so canvas memory is
+// recycled as windows are closed and resized instead of leaking.
+#define TEXTURE_POOL_MIN_BLOCK_SIZE KILOBYTES(4)
+#define TEXTURE_POOL_ORDER_COUNT 16
+
+typedef struct texture_pool_block texture_pool_block;
+struct texture_pool_block
+{
+   texture_pool_block *prev;
+   texture_pool_block *next;
+};
+
+typedef struct {
+   u8 *base;
+   memindex capacity;
+   u32 block_count;
+   u32 order_count;
+
+   // NOTE: Metadata per minimum-sized block, valid for the first block of each
+   // allocated or free range.
+   u8 *block_orders;
+   bool *block_is_free;
+   u32 *block_requested;
+
+   texture_pool_block *free_lists[TEXTURE_POOL_ORDER_COUNT];
+   u32 free_counts[TEXTURE_POOL_ORDER_COUNT];
+
+   memindex used_bytes;
+   memindex requested_bytes;
+   u32 allocation_count;
+} texture_pool;
+
+typedef struct {
+   memindex capacity;
+   memindex used_bytes;
+   memindex requested_bytes;
+   memindex free_bytes;
+   memindex largest_free_bytes;
+   u32 allocation_count;
+
+   // NOTE: Internal fragmentation is the share of used bytes lost to rounding
+   // up to a block size. External fragmentation is the share of free bytes
+   // that can't be handed out as a single block.
+   float internal_fragmentation;
+   float external_fragmentation;
+} texture_pool_stats;
+
 // TODO(law): Since 0 is a valid index, we're using one outside the valid range
 // of the array. Maybe reserve index 0 instead?
 #define DESKTOP_WINDOW_NULL_INDEX (DESKTOP_WINDOW_MAX_COUNT)
@@ -223,36 +591,79 @@ typedef struct {
 
 typedef struct {
    texture backbuffer;
+   clip_stack backbuffer_clip;
    desktop_input input;
 
    arena window_arena;
    arena texture_arena;
    arena scratch_arena;
+   texture_pool canvas_pool;
 
-   // NOTE: The first_window field refers to the top-level window in sorting
-   // order. Therefore first_window undergoes hit detection first and rendering
-   // last. The opposite is true for last_window.
-   desktop_window *first_window;
-   desktop_window *last_window;
-   desktop_window *free_window;
+   window_table *windows;
+   window_grid grid;
 
    desktop_configuration config;
 
-   desktop_window *active_window; // Undgoing action
-   desktop_window *hot_window;    // Ready for action
+   window_animation_scheduler animations;
+   thumbnail_cache thumbnails;
+   shadow_slices shadow;
+
+   desktop_terminal terminal;
+   window_handle terminal_window;
+
+   ui_state widgets_ui;
+   window_handle widgets_window;
+   s32 widgets_selected;
+
+   window_handle active_window; // Undgoing action
+   window_handle hot_window;    // Ready for action
 
    int active_window_mouse_offsetx;
    int active_window_mouse_offsety;
 
+   // NOTE: The region of the active window that was pressed, along with the
+   // window bounds and mouse position at the time. Resizing is computed
+   // relative to the start of the drag rather than accumulated per frame.
+   u32 active_region_index;
+   rectangle drag_start_bounds;
+   s32 drag_startx;
+   s32 drag_starty;
+
    cursor_type frame_cursor;
    texture cursor_textures[CURSOR_COUNT];
    texture region_textures[WINDOW_REGION_COUNT];
 
+   // NOTE: The desktop only renders when something changed. When an update
+   // reports no changes, the host may block for up to idle_timeout_ms waiting
+   // for input before calling desktop_update again. A negative value means
+   // there are no scheduled timers and the host can wait indefinitely.
+   bool needs_redraw;
+   double wakeup_time_seconds;
+   s32 idle_timeout_ms;
+
    bool is_initialized;
 } desktop_context;
 
+// NOTE: The thumbnails picked for regeneration this frame, which are scaled
+// down in parallel since they don't share any state.
+typedef struct {
+   desktop_context *desktop;
+   u32 indices[DESKTOP_THUMBNAIL_UPDATES_PER_FRAME];
+} thumbnail_updates;
+
 #define DESKTOP_INITIALIZE(name) void name(desktop_context *desktop, int width, int height)
 DESKTOP_INITIALIZE(desktop_initialize);
 
-#define DESKTOP_UPDATE(name) void name(desktop_context *desktop)
+// NOTE: Returns true if the backbuffer was redrawn and should be presented.
+#define DESKTOP_UPDATE(name) bool name(desktop_context *desktop)
 DESKTOP_UPDATE(desktop_update);
+
+// NOTE: Called once by the host before exiting.
+#define DESKTOP_SHUTDOWN(name) void name(desktop_context *desktop)
+DESKTOP_SHUTDOWN(desktop_shutdown);
+
+// NOTE: Feeds output from the process attached to the terminal window. Bytes
+// typed into the terminal accumulate in desktop->terminal.input, and the host
+// is expected to forward and clear them.
+#define DESKTOP_TERMINAL_WRITE(name) void name(desktop_context *desktop, u8 *data, memindex count)
+DESKTOP_TERMINAL_WRITE(desktop_terminal_write);
@@ -0,0 +1,276 @@
+/* /////////////////////////////////////////////////////////////////////////// */
+/* (c) copyright 2024 Lawrence D. Kern /////////////////////////////////////// */
+/* /////////////////////////////////////////////////////////////////////////// */
+
+// NOTE: A small instrumentation profiler for the desktop. Blocks of code are
+// wrapped with PROFILE_SCOPE, which records the CPU timestamp counter on entry
+// and exit:
+//
+//    PROFILE_SCOPE("taskbar")
+//    {
+//       ...
+//    }
+//
+// The scope is implemented as a single-iteration for loop, so leaving it early
+// with break or return skips the closing timestamp. In release builds all of
+// the macros expand to nothing and the wrapped block runs as a plain block.
+//
+// When the platform provides hardware counters, they're also read around each
+// frame and each outermost scope. Reading them costs a system call, so nested
+// scopes only get timestamps.
+
+#if DEVELOPMENT_BUILD
+
+#define PROFILE_EVENT_MAX 4096
+#define PROFILE_COUNTED_EVENT_MAX 64
+#define PROFILE_FRAME_COUNT 64
+
+typedef struct {
+   char *name;
+   u64 begin;
+   u64 end;
+   u32 depth;
+
+   // NOTE: Index into the frame's counters, or PROFILE_COUNTED_EVENT_MAX if
+   // the event wasn't counted.
+   u32 counters_index;
+} profile_event;
+
+typedef struct {
+   u64 begin;
+   u64 end;
+   platform_counters counters;
+
+   u32 event_count;
+   profile_event events[PROFILE_EVENT_MAX];
+
+   u32 counted_event_count;
+   platform_counters counted_events[PROFILE_COUNTED_EVENT_MAX];
+} profile_frame;
+
+typedef struct {
+   // NOTE: frame_index refers to the frame currently being recorded. Every
+   // other frame in the ring is complete.
+   u32 frame_index;
+   u32 depth;
+
+   double ticks_per_second;
+   b32 counters_available;
+
+   profile_frame frames[PROFILE_FRAME_COUNT];
+} profiler_state;
+
+global profiler_state profiler;
+
+function void profile_frame_begin(void)
+{
+   if(profiler.ticks_per_second == 0.0)
+   {
+      profiler.ticks_per_second = (double)get_cpu_timer_frequency();
+
+      platform_counters counters;
+      profiler.counters_available = platform_read_counters(&counters);
+   }
+
+   profile_frame *frame = profiler.frames + profiler.frame_index;
+   if(profiler.counters_available)
+   {
+      platform_read_counters(&frame->counters);
+   }
+   frame->begin = read_cpu_timer();
+   frame->end = frame->begin;
+   frame->event_count = 0;
+   frame->counted_event_count = 0;
+   profiler.depth = 0;
+}
+
+function void profile_frame_end(void)
+{
+   profile_frame *frame = profiler.frames + profiler.frame_index;
+   frame->end = read_cpu_timer();
+   if(profiler.counters_available)
+   {
+      platform_counters end;
+      platform_read_counters(&end);
+      subtract_counters(&frame->counters, &frame->counters, &end);
+   }
+
+   profiler.frame_index = (profiler.frame_index + 1) % PROFILE_FRAME_COUNT;
+}
+
+function u32 profile_begin(char *name)
+{
+   u32 result = PROFILE_EVENT_MAX;
+
+   profile_frame *frame = profiler.frames + profiler.frame_index;
+   if(frame->event_count < PROFILE_EVENT_MAX)
+   {
+      result = frame->event_count++;
+
+      profile_event *event = frame->events + result;
+      event->name = name;
+      event->depth = profiler.depth;
+      event->counters_index = PROFILE_COUNTED_EVENT_MAX;
+
+      if(profiler.counters_available && profiler.depth == 0 && frame->counted_event_count < PROFILE_COUNTED_EVENT_MAX)
+      {
+         event->counters_index = frame->counted_event_count++;
+         platform_read_counters(frame->counted_events + event->counters_index);
+      }
+
+      event->begin = read_cpu_timer();
+      event->end = event->begin;
+   }
+   profiler.depth++;
+
+   return(result);
+}
+
+function void profile_end(u32 event_index)
+{
+   profiler.depth--;
+   if(event_index < PROFILE_EVENT_MAX)
+   {
+      profile_frame *frame = profiler.frames + profiler.frame_index;
+      profile_event *event = frame->events + event_index;
+      event->end = read_cpu_timer();
+
+      if(event->counters_index < PROFILE_COUNTED_EVENT_MAX)
+      {
+         platform_counters end;
+         platform_read_counters(&end);
+
+         platform_counters *counters = frame->counted_events + event->counters_index;
+         subtract_counters(counters, counters, &end);
+      }
+   }
+}
+
+function profile_frame *get_previous_profile_frame(void)
+{
+   u32 index = (profiler.frame_index + PROFILE_FRAME_COUNT - 1) % PROFILE_FRAME_COUNT;
+   profile_frame *result = profiler.frames + index;
+
+   return(result);
+}
+
+function float profile_ticks_to_ms(u64 ticks)
+{
+   float result = 0.0f;
+   if(profiler.ticks_per_second > 0.0)
+   {
+      result = (float)((double)ticks * 1000.0 / profiler.ticks_per_second);
+   }
+
+   return(result);
+}
+
+function void write_chrome_trace_counters(FILE *file, platform_counters *counters)
+{
+   // NOTE: Counters are attached to events as arguments, which trace viewers
+   // show alongside the selected event.
+   char *names[] = {"cycles", "instructions", "cache_misses", "branch_misses"};
+
+   char *separator = "";
+   fprintf(file, ",\"args\":{");
+   for(u32 index = 0; index < PLATFORM_COUNTER_COUNT; ++index)
+   {
+      if(counters->available & (1 << index))
+      {
+         fprintf(file, "%s\"%s\":%llu", separator, names[index], (unsigned long long)counters->values[index]);
+         separator = ",";
+      }
+   }
+   fprintf(file, "}");
+}
+
+function bool profile_write_chrome_trace(char *path)
+{
+   // NOTE: Write every completed frame in the ring buffer using the Chrome
+   // trace event format, which can be loaded by chrome://tracing or Perfetto.
+   // Timestamps are in microseconds relative to the oldest recorded frame.
+   FILE *file = fopen(path, "wb");
+   if(!file)
+   {
+      return(false);
+   }
+
+   u64 origin = 0;
+   for(u32 offset = 1; offset < PROFILE_FRAME_COUNT; ++offset)
+   {
+      profile_frame *frame = profiler.frames + ((profiler.frame_index + offset) % PROFILE_FRAME_COUNT);
+      if(frame->begin && (!origin || frame->begin < origin))
+      {
+         origin = frame->begin;
+      }
+   }
+
+   double us_per_tick = (profiler.ticks_per_second > 0.0) ? (1000000.0 / profiler.ticks_per_second) : 0.0;
+
+   fprintf(file, "{\"traceEvents\":[\n");
+
+   bool first_event = true;
+   for(u32 offset = 1; offset < PROFILE_FRAME_COUNT; ++offset)
+   {
+      profile_frame *frame = profiler.frames + ((profiler.frame_index + offset) % PROFILE_FRAME_COUNT);
+      if(!frame->begin)
+      {
+         // NOTE: Skip frames that were never recorded.
+         continue;
+      }
+
+      double frame_ts = (double)(frame->begin - origin) * us_per_tick;
+      double frame_dur = (double)(frame->end - frame->begin) * us_per_tick;
+
+      fprintf(file, "%s{\"name\":\"frame\",\"ph\":\"X\",\"pid\":0,\"tid\":0,\"ts\":%.3f,\"dur\":%.3f",
+              (first_event) ? "" : ",\n", frame_ts, frame_dur);
+      if(frame->counters.available)
+      {
+         write_chrome_trace_counters(file, &frame->counters);
+      }
+      fprintf(file, "}");
+      first_event = false;
+
+      for(u32 event_index = 0; event_index < frame->event_count; ++event_index)
+      {
+         profile_event *event = frame->events + event_index;
+
+         double ts = (double)(event->begin - origin) * us_per_tick;
+         double dur = (double)(event->end - event->begin) * us_per_tick;
+
+         fprintf(file, ",\n{\"name\":\"%s\",\"ph\":\"X\",\"pid\":0,\"tid\":0,\"ts\":%.3f,\"dur\":%.3f",
+                 event->name, ts, dur);
+         if(event->counters_index < PROFILE_COUNTED_EVENT_MAX)
+         {
+            write_chrome_trace_counters(file, frame->counted_events + event->counters_index);
+         }
+         fprintf(file, "}");
+      }
+   }
+
+   fprintf(file, "\n]}\n");
+   fclose(file);
+
+   return(true);
+}
+
+#define PROFILE_JOIN_(a, b) a##b
+#define PROFILE_JOIN(a, b) PROFILE_JOIN_(a, b)
+#define PROFILE_INDEX PROFILE_JOIN(profile_index_, __LINE__)
+#define PROFILE_ONCE PROFILE_JOIN(profile_once_, __LINE__)
+
+#define PROFILE_SCOPE(name)                                                \
+   for(u32 PROFILE_INDEX = profile_begin(name), PROFILE_ONCE = 1;          \
+       PROFILE_ONCE;                                                       \
+       PROFILE_ONCE = 0, profile_end(PROFILE_INDEX))
+
+#define PROFILE_FRAME_BEGIN() profile_frame_begin()
+#define PROFILE_FRAME_END() profile_frame_end()
+
+#else
+
+#define PROFILE_SCOPE(name)
+#define PROFILE_FRAME_BEGIN()
+#define PROFILE_FRAME_END()
+
+#endif
@@ -36,6 +36,33 @@ function vec4 operator*=(vec4 &vector, float value)
    return(vector);
 }
 
+PUSH_CLIP(push_clip)
+{
+   rectangle clip = get_clip_rectangle(destination);
+
+   s32 minx = MAXIMUM(x, clip.x);
+   s32 miny = MAXIMUM(y, clip.y);
+   s32 maxx = MINIMUM(x + width, clip.x + clip.width);
+   s32 maxy = MINIMUM(y + height, clip.y + clip.height);
+
+   clip_stack *stack = destination->clip;
+   assert(stack && stack->count < TEXTURE_CLIP_STACK_MAX);
+
+   rectangle *entry = stack->entries + stack->count++;
+   entry->x = minx;
+   entry->y = miny;
+   entry->width = MAXIMUM(maxx - minx, 0);
+   entry->height = MAXIMUM(maxy - miny, 0);
+}
+
+POP_CLIP(pop_clip)
+{
+   clip_stack *stack = destination->clip;
+   assert(stack && stack->count > 0);
+
+   stack->count--;
+}
+
 CLEAR(clear)
 {
    color = (color * 255.0f) + 0.5f;
@@ -45,30 +72,44 @@ CLEAR(clear)
 				((u32)color.a << 24));
    u32w pixel_wide = set_u32w(pixel);
 
-   s32 max = destination->width * destination->height;
-   s32 wide_max = max - (max % SIMD_WIDTH);
+   // NOTE: When the clip spans full rows, the cleared region is contiguous and
+   // can be filled in one run. Otherwise each row is filled separately.
+   rectangle clip = get_clip_rectangle(destination);
 
-   u32 *memory = destination->memory;
-   for(s32 index = 0; index < wide_max; index += SIMD_WIDTH)
+   s32 row_count = 1;
+   s32 row_length = clip.width * clip.height;
+   if(clip.width != destination->width)
    {
-      storeu_u32w((u32w *)(memory + index), pixel_wide);
+      row_count = clip.height;
+      row_length = clip.width;
    }
-   for(s32 index = wide_max; index < max; ++index)
+
+   s32 wide_max = row_length - (row_length % SIMD_WIDTH);
+
+   for(s32 row = 0; row < row_count; ++row)
    {
-      memory[index] = pixel;
+      u32 *memory = destination->memory + ((clip.y + row) * destination->width) + clip.x;
+      for(s32 index = 0; index < wide_max; index += SIMD_WIDTH)
+      {
+         storeu_u32w((u32w *)(memory + index), pixel_wide);
+      }
+      for(s32 index = wide_max; index < row_length; ++index)
+      {
+         memory[index] = pixel;
+      }
    }
 }
 
 DRAW_RECTANGLE(draw_rectangle)
 {
    s32 target_width = destination->width;
-   s32 target_height = destination->height;
    u32 *target_memory = destination->memory;
 
-   s32 minx = MAXIMUM(posx, 0);
-   s32 miny = MAXIMUM(posy, 0);
-   s32 maxx = MINIMUM(posx + width, target_width);
-   s32 maxy = MINIMUM(posy + height, target_height);
+   rectangle clip = get_clip_rectangle(destination);
+   s32 minx = MAXIMUM(posx, clip.x);
+   s32 miny = MAXIMUM(posy, clip.y);
+   s32 maxx = MINIMUM(posx + width, clip.x + clip.width);
+   s32 maxy = MINIMUM(posy + height, clip.y + clip.height);
 
    s32 runoff = (maxx - minx) % SIMD_WIDTH;
    s32 wide_maxx = MAXIMUM(minx, maxx - runoff);
@@ -164,18 +205,22 @@ DRAW_RECTANGLE(draw_rectangle)
    }
 }
 
-DRAW_TEXTURE_BOUNDED(draw_texture_bounded)
+function void blit_texture(texture *destination, texture *texture, int posx, int posy, int width, int height, float opacity)
 {
+   // NOTE: Composite a premultiplied texture over the destination. The source
+   // is scaled by opacity before blending, which leaves fully opaque blits
+   // unchanged.
    posx -= texture->offsetx;
    posy -= texture->offsety;
 
    width = MINIMUM(width, texture->width);
    height = MINIMUM(height, texture->height);
 
-   s32 minx = MAXIMUM(posx, 0);
-   s32 miny = MAXIMUM(posy, 0);
-   s32 maxx = MINIMUM(posx + width, destination->width);
-   s32 maxy = MINIMUM(posy + height, destination->height);
+   rectangle clip = get_clip_rectangle(destination);
+   s32 minx = MAXIMUM(posx, clip.x);
+   s32 miny = MAXIMUM(posy, clip.y);
+   s32 maxx = MINIMUM(posx + width, clip.x + clip.width);
+   s32 maxy = MINIMUM(posy + height, clip.y + clip.height);
 
    s32 clippedy = (miny - posy) * texture->width;
    s32 clippedx = (minx - posx);
@@ -186,6 +231,7 @@ DRAW_TEXTURE_BOUNDED(draw_texture_bounded)
    u32w wide_255 = set_u32w(0xFF);
    f32w wide_inv_255f = set_f32w(1.0f / 255.0f);
    f32w wide_1f = set_f32w(1.0f);
+   f32w wide_opacity = set_f32w(opacity);
 
    for(s32 destinationy = miny; destinationy < maxy; ++destinationy)
    {
@@ -201,10 +247,10 @@ DRAW_TEXTURE_BOUNDED(draw_texture_bounded)
          u32w *source_address = (u32w *)(source_row + sourcex);
          u32w source_color = loadu_u32w(source_address);
 
-         f32w sr = convert_to_f32w((source_color >> 16) & wide_255);
-         f32w sg = convert_to_f32w((source_color >>  8) & wide_255);
-         f32w sb = convert_to_f32w((source_color >>  0) & wide_255);
-         f32w sa = convert_to_f32w((source_color >> 24) & wide_255);
+         f32w sr = wide_opacity * convert_to_f32w((source_color >> 16) & wide_255);
+         f32w sg = wide_opacity * convert_to_f32w((source_color >>  8) & wide_255);
+         f32w sb = wide_opacity * convert_to_f32w((source_color >>  0) & wide_255);
+         f32w sa = wide_opacity * convert_to_f32w((source_color >> 24) & wide_255);
 
          u32w *destination_address = (u32w *)(destination_row + destinationx);
 
@@ -234,10 +280,10 @@ DRAW_TEXTURE_BOUNDED(draw_texture_bounded)
          s32 sourcex = destinationx - minx;
 
          u32 source_color = source_row[sourcex];
-         float sr = (float)((source_color >> 16) & 0xFF);
-         float sg = (float)((source_color >>  8) & 0xFF);
-         float sb = (float)((source_color >>  0) & 0xFF);
-         float sa = (float)((source_color >> 24) & 0xFF);
+         float sr = opacity * (float)((source_color >> 16) & 0xFF);
+         float sg = opacity * (float)((source_color >>  8) & 0xFF);
+         float sb = opacity * (float)((source_color >>  0) & 0xFF);
+         float sa = opacity * (float)((source_color >> 24) & 0xFF);
 
          u32 *destination_pixel = destination_row + destinationx;
 
@@ -264,11 +310,585 @@ DRAW_TEXTURE_BOUNDED(draw_texture_bounded)
    }
 }
 
+DRAW_TEXTURE_BOUNDED(draw_texture_bounded)
+{
+   blit_texture(destination, texture, posx, posy, width, height, 1.0f);
+}
+
+DRAW_TEXTURE_TRANSLUCENT(draw_texture_translucent)
+{
+   blit_texture(destination, texture, posx, posy, width, height, opacity);
+}
+
+function f32w unpack_channel_u32w(u32w color, u32 shift)
+{
+   f32w result = convert_to_f32w((color >> shift) & set_u32w(0xFF));
+   return(result);
+}
+
+function u32w load_partial_u32w(u32 *source, s32 count)
+{
+   // NOTE: Load the leading lanes of a vector from a row that ends early. The
+   // unused lanes are zero.
+   u32 lanes[SIMD_WIDTH] = {0};
+   for(s32 lane = 0; lane < count; ++lane)
+   {
+      lanes[lane] = source[lane];
+   }
+
+   return loadu_u32w((u32w *)lanes);
+}
+
+function void store_partial_u32w(u32 *destination, u32w vector, s32 count)
+{
+   u32 lanes[SIMD_WIDTH];
+   storeu_u32w((u32w *)lanes, vector);
+
+   for(s32 lane = 0; lane < count; ++lane)
+   {
+      destination[lane] = lanes[lane];
+   }
+}
+
+function u32w composite_u32w(u32w destination_color, f32w sr, f32w sg, f32w sb, f32w sa)
+{
+   // NOTE: Premultiplied source-over compositing.
+   f32w dr = unpack_channel_u32w(destination_color, 16);
+   f32w dg = unpack_channel_u32w(destination_color,  8);
+   f32w db = unpack_channel_u32w(destination_color,  0);
+   f32w da = unpack_channel_u32w(destination_color, 24);
+
+   f32w inv_sanormal = set_f32w(1.0f) - (sa * set_f32w(1.0f / 255.0f));
+
+   f32w r = (inv_sanormal * dr) + sr;
+   f32w g = (inv_sanormal * dg) + sg;
+   f32w b = (inv_sanormal * db) + sb;
+   f32w a = (inv_sanormal * da) + sa;
+
+   u32w pr = convert_to_u32w(r) << 16;
+   u32w pg = convert_to_u32w(g) << 8;
+   u32w pb = convert_to_u32w(b) << 0;
+   u32w pa = convert_to_u32w(a) << 24;
+
+   return(pr|pg|pb|pa);
+}
+
+DRAW_TEXTURE_SCALED(draw_texture_scaled)
+{
+   // NOTE: Stretch the full texture over the destination rectangle. Source
+   // positions are stepped in 16.16 fixed point and looked up per lane, so a
+   // vector covers SIMD_WIDTH adjacent destination pixels. Nearest takes the
+   // source texel under each pixel center, bilinear blends the four closest
+   // texels, and box averages every texel the pixel covers, which is the one
+   // to use when shrinking by more than half.
+   if(width <= 0 || height <= 0 || texture->width <= 0 || texture->height <= 0)
+   {
+      return;
+   }
+
+   posx -= (texture->offsetx * width) / texture->width;
+   posy -= (texture->offsety * height) / texture->height;
+
+   rectangle clip = get_clip_rectangle(destination);
+   s32 minx = MAXIMUM(posx, clip.x);
+   s32 miny = MAXIMUM(posy, clip.y);
+   s32 maxx = MINIMUM(posx + width, clip.x + clip.width);
+   s32 maxy = MINIMUM(posy + height, clip.y + clip.height);
+
+   s64 stepx = ((s64)texture->width << 16) / width;
+   s64 stepy = ((s64)texture->height << 16) / height;
+
+   s32 last_column = texture->width - 1;
+   s32 last_row = texture->height - 1;
+
+   f32w wide_opacity = set_f32w(opacity);
+   f32w wide_1f = set_f32w(1.0f);
+
+   for(s32 destinationy = miny; destinationy < maxy; ++destinationy)
+   {
+      u32 *destination_row = destination->memory + (destinationy * destination->width);
+
+      s64 offsety = destinationy - posy;
+      s64 sample_y = (offsety * stepy) + (stepy / 2);
+
+      for(s32 destinationx = minx; destinationx < maxx; destinationx += SIMD_WIDTH)
+      {
+         s32 count = MINIMUM(SIMD_WIDTH, maxx - destinationx);
+         s64 offsetx = destinationx - posx;
+
+         f32w sr, sg, sb, sa;
+         switch(filter)
+         {
+            case TEXTURE_FILTER_NEAREST:
+            {
+               s32 columns[SIMD_WIDTH];
+               for(s32 lane = 0; lane < SIMD_WIDTH; ++lane)
+               {
+                  s64 sample_x = ((offsetx + MINIMUM(lane, count - 1)) * stepx) + (stepx / 2);
+                  columns[lane] = (s32)MINIMUM(sample_x >> 16, last_column);
+               }
+
+               u32 *source_row = texture->memory + (MINIMUM(sample_y >> 16, last_row) * texture->width);
+               u32w color = gather_u32w(source_row, columns);
+
+               sr = unpack_channel_u32w(color, 16);
+               sg = unpack_channel_u32w(color,  8);
+               sb = unpack_channel_u32w(color,  0);
+               sa = unpack_channel_u32w(color, 24);
+            } break;
+
+            case TEXTURE_FILTER_BILINEAR:
+            {
+               // NOTE: Offset by half a texel so that texel centers land on
+               // integer coordinates, and clamp at the texture edges.
+               s32 columns0[SIMD_WIDTH];
+               s32 columns1[SIMD_WIDTH];
+               float fractions[SIMD_WIDTH];
+               for(s32 lane = 0; lane < SIMD_WIDTH; ++lane)
+               {
+                  s64 sample_x = ((offsetx + MINIMUM(lane, count - 1)) * stepx) + (stepx / 2) - 0x8000;
+                  sample_x = MAXIMUM(sample_x, 0);
+
+                  columns0[lane] = (s32)MINIMUM(sample_x >> 16, last_column);
+                  columns1[lane] = MINIMUM(columns0[lane] + 1, last_column);
+                  fractions[lane] = (float)(sample_x & 0xFFFF) * (1.0f / 65536.0f);
+               }
+
+               s64 sample = MAXIMUM(sample_y - 0x8000, 0);
+               s32 row0 = (s32)MINIMUM(sample >> 16, last_row);
+               s32 row1 = MINIMUM(row0 + 1, last_row);
+
+               u32 *source_row0 = texture->memory + (row0 * texture->width);
+               u32 *source_row1 = texture->memory + (row1 * texture->width);
+
+               u32w c00 = gather_u32w(source_row0, columns0);
+               u32w c10 = gather_u32w(source_row0, columns1);
+               u32w c01 = gather_u32w(source_row1, columns0);
+               u32w c11 = gather_u32w(source_row1, columns1);
+
+               f32w fx = loadu_f32w(fractions);
+               f32w fy = set_f32w((float)(sample & 0xFFFF) * (1.0f / 65536.0f));
+               f32w inv_fx = wide_1f - fx;
+               f32w inv_fy = wide_1f - fy;
+
+               f32w w00 = inv_fx * inv_fy;
+               f32w w10 = fx * inv_fy;
+               f32w w01 = inv_fx * fy;
+               f32w w11 = fx * fy;
+
+               sr = (w00 * unpack_channel_u32w(c00, 16)) + (w10 * unpack_channel_u32w(c10, 16)) + (w01 * unpack_channel_u32w(c01, 16)) + (w11 * unpack_channel_u32w(c11, 16));
+               sg = (w00 * unpack_channel_u32w(c00,  8)) + (w10 * unpack_channel_u32w(c10,  8)) + (w01 * unpack_channel_u32w(c01,  8)) + (w11 * unpack_channel_u32w(c11,  8));
+               sb = (w00 * unpack_channel_u32w(c00,  0)) + (w10 * unpack_channel_u32w(c10,  0)) + (w01 * unpack_channel_u32w(c01,  0)) + (w11 * unpack_channel_u32w(c11,  0));
+               sa = (w00 * unpack_channel_u32w(c00, 24)) + (w10 * unpack_channel_u32w(c10, 24)) + (w01 * unpack_channel_u32w(c01, 24)) + (w11 * unpack_channel_u32w(c11, 24));
+            } break;
+
+            case TEXTURE_FILTER_BOX:
+            default:
+            {
+               // NOTE: Each lane covers a span of source columns. Lanes are
+               // stepped together up to the widest span, with narrower spans
+               // clamped to their last column and masked out by a weight of 0.
+               s32 first_columns[SIMD_WIDTH];
+               s32 spans[SIMD_WIDTH];
+               s32 max_span = 1;
+               for(s32 lane = 0; lane < SIMD_WIDTH; ++lane)
+               {
+                  s64 offset = offsetx + MINIMUM(lane, count - 1);
+                  s32 first = (s32)MINIMUM((offset * stepx) >> 16, last_column);
+                  s32 last = (s32)MINIMUM(((offset + 1) * stepx) >> 16, texture->width);
+
+                  first_columns[lane] = first;
+                  spans[lane] = MAXIMUM(last - first, 1);
+                  max_span = MAXIMUM(max_span, spans[lane]);
+               }
+
+               s32 first_row = (s32)MINIMUM((offsety * stepy) >> 16, last_row);
+               s32 last_row_exclusive = (s32)MINIMUM(((offsety + 1) * stepy) >> 16, texture->height);
+               s32 row_span = MAXIMUM(last_row_exclusive - first_row, 1);
+
+               f32w zero = set_f32w(0.0f);
+               sr = zero;
+               sg = zero;
+               sb = zero;
+               sa = zero;
+
+               for(s32 step = 0; step < max_span; ++step)
+               {
+                  s32 columns[SIMD_WIDTH];
+                  float weights[SIMD_WIDTH];
+                  for(s32 lane = 0; lane < SIMD_WIDTH; ++lane)
+                  {
+                     bool inside = (step < spans[lane]);
+                     columns[lane] = first_columns[lane] + ((inside) ? step : spans[lane] - 1);
+                     weights[lane] = (inside) ? 1.0f : 0.0f;
+                  }
+                  f32w weight = loadu_f32w(weights);
+
+                  for(s32 row = 0; row < row_span; ++row)
+                  {
+                     u32 *source_row = texture->memory + ((first_row + row) * texture->width);
+                     u32w color = gather_u32w(source_row, columns);
+
+                     sr = sr + (weight * unpack_channel_u32w(color, 16));
+                     sg = sg + (weight * unpack_channel_u32w(color,  8));
+                     sb = sb + (weight * unpack_channel_u32w(color,  0));
+                     sa = sa + (weight * unpack_channel_u32w(color, 24));
+                  }
+               }
+
+               float inv_areas[SIMD_WIDTH];
+               for(s32 lane = 0; lane < SIMD_WIDTH; ++lane)
+               {
+                  inv_areas[lane] = 1.0f / (float)(spans[lane] * row_span);
+               }
+               f32w inv_area = loadu_f32w(inv_areas);
+
+               sr = sr * inv_area;
+               sg = sg * inv_area;
+               sb = sb * inv_area;
+               sa = sa * inv_area;
+            } break;
+         }
+
+         sr = sr * wide_opacity;
+         sg = sg * wide_opacity;
+         sb = sb * wide_opacity;
+         sa = sa * wide_opacity;
+
+         u32 *destination_pixels = destination_row + destinationx;
+         if(count == SIMD_WIDTH)
+         {
+            u32w destination_color = loadu_u32w((u32w *)destination_pixels);
+            storeu_u32w((u32w *)destination_pixels, composite_u32w(destination_color, sr, sg, sb, sa));
+         }
+         else
+         {
+            u32w destination_color = load_partial_u32w(destination_pixels, count);
+            store_partial_u32w(destination_pixels, composite_u32w(destination_color, sr, sg, sb, sa), count);
+         }
+      }
+   }
+}
+
 DRAW_TEXTURE(draw_texture)
 {
    draw_texture_bounded(destination, texture, posx, posy, texture->width, texture->height);
 }
 
+function f32w load_partial_f32w(float *source, s32 count)
+{
+   float lanes[SIMD_WIDTH] = {0};
+   for(s32 lane = 0; lane < count; ++lane)
+   {
+      lanes[lane] = source[lane];
+   }
+
+   return loadu_f32w(lanes);
+}
+
+DRAW_MASK(draw_mask)
+{
+   // NOTE: Composite a solid color through the mask's coverage values in a
+   // single pass over the destination.
+   rectangle clip = get_clip_rectangle(destination);
+   s32 minx = MAXIMUM(posx, clip.x);
+   s32 miny = MAXIMUM(posy, clip.y);
+   s32 maxx = MINIMUM(posx + mask->width, clip.x + clip.width);
+   s32 maxy = MINIMUM(posy + mask->height, clip.y + clip.height);
+
+   float alpha = color.a * 255.0f;
+   f32w wide_r = set_f32w(color.r * alpha);
+   f32w wide_g = set_f32w(color.g * alpha);
+   f32w wide_b = set_f32w(color.b * alpha);
+   f32w wide_a = set_f32w(alpha);
+
+   for(s32 destinationy = miny; destinationy < maxy; ++destinationy)
+   {
+      float *mask_row = mask->memory + ((destinationy - posy) * mask->stride) - posx;
+      u32 *destination_row = destination->memory + (destinationy * destination->width);
+
+      for(s32 destinationx = minx; destinationx < maxx; destinationx += SIMD_WIDTH)
+      {
+         s32 count = MINIMUM(SIMD_WIDTH, maxx - destinationx);
+         u32 *destination_pixels = destination_row + destinationx;
+
+         if(count == SIMD_WIDTH)
+         {
+            f32w coverage = loadu_f32w(mask_row + destinationx);
+            u32w destination_color = loadu_u32w((u32w *)destination_pixels);
+
+            u32w result = composite_u32w(destination_color, wide_r * coverage, wide_g * coverage, wide_b * coverage, wide_a * coverage);
+            storeu_u32w((u32w *)destination_pixels, result);
+         }
+         else
+         {
+            f32w coverage = load_partial_f32w(mask_row + destinationx, count);
+            u32w destination_color = load_partial_u32w(destination_pixels, count);
+
+            u32w result = composite_u32w(destination_color, wide_r * coverage, wide_g * coverage, wide_b * coverage, wide_a * coverage);
+            store_partial_u32w(destination_pixels, result, count);
+         }
+      }
+   }
+}
+
+DRAW_COVERAGE_MASK(draw_coverage_mask)
+{
+   // NOTE: Widen each run of coverage bytes to floats and composite it the
+   // same way as draw_mask. Coverage is already scaled by 255, so the color
+   // only needs its own alpha applied.
+   rectangle clip = get_clip_rectangle(destination);
+   s32 minx = MAXIMUM(posx, clip.x);
+   s32 miny = MAXIMUM(posy, clip.y);
+   s32 maxx = MINIMUM(posx + mask->width, clip.x + clip.width);
+   s32 maxy = MINIMUM(posy + mask->height, clip.y + clip.height);
+
+   f32w wide_r = set_f32w(color.r * color.a);
+   f32w wide_g = set_f32w(color.g * color.a);
+   f32w wide_b = set_f32w(color.b * color.a);
+   f32w wide_a = set_f32w(color.a);
+
+   float coverage_values[SIMD_WIDTH];
+
+   for(s32 destinationy = miny; destinationy < maxy; ++destinationy)
+   {
+      u8 *mask_row = mask->memory + ((destinationy - posy) * mask->stride) - posx;
+      u32 *destination_row = destination->memory + (destinationy * destination->width);
+
+      for(s32 destinationx = minx; destinationx < maxx; destinationx += SIMD_WIDTH)
+      {
+         s32 count = MINIMUM(SIMD_WIDTH, maxx - destinationx);
+         u32 *destination_pixels = destination_row + destinationx;
+
+         for(s32 index = 0; index < count; ++index)
+         {
+            coverage_values[index] = (float)mask_row[destinationx + index];
+         }
+
+         if(count == SIMD_WIDTH)
+         {
+            f32w coverage = loadu_f32w(coverage_values);
+            u32w destination_color = loadu_u32w((u32w *)destination_pixels);
+
+            u32w result = composite_u32w(destination_color, wide_r * coverage, wide_g * coverage, wide_b * coverage, wide_a * coverage);
+            storeu_u32w((u32w *)destination_pixels, result);
+         }
+         else
+         {
+            f32w coverage = load_partial_f32w(coverage_values, count);
+            u32w destination_color = load_partial_u32w(destination_pixels, count);
+
+            u32w result = composite_u32w(destination_color, wide_r * coverage, wide_g * coverage, wide_b * coverage, wide_a * coverage);
+            store_partial_u32w(destination_pixels, result, count);
+         }
+      }
+   }
+}
+
+function void box_blur_rows(float *destination, float *source, s32 width, s32 height, s32 radius)
+{
+   // NOTE: Each output is the average of a (2*radius + 1) texel window, with
+   // texels outside the mask treated as zero. The window sum is updated as it
+   // slides along the row, so the cost per texel doesn't depend on the radius.
+   // The sum carries a dependency from one texel to the next, so this pass
+   // stays scalar.
+   float inv_window = 1.0f / (float)(2 * radius + 1);
+
+   for(s32 y = 0; y < height; ++y)
+   {
+      float *source_row = source + (y * width);
+      float *destination_row = destination + (y * width);
+
+      float sum = 0.0f;
+      for(s32 x = 0; x < MINIMUM(radius, width); ++x)
+      {
+         sum += source_row[x];
+      }
+
+      for(s32 x = 0; x < width; ++x)
+      {
+         if(x + radius < width)
+         {
+            sum += source_row[x + radius];
+         }
+
+         destination_row[x] = sum * inv_window;
+
+         if(x - radius >= 0)
+         {
+            sum -= source_row[x - radius];
+         }
+      }
+   }
+}
+
+function void box_blur_columns(float *destination, float *source, s32 width, s32 height, s32 radius)
+{
+   // NOTE: The same sliding window down each column. Adjacent columns are
+   // independent, so SIMD_WIDTH of them are summed at once.
+   f32w inv_window = set_f32w(1.0f / (float)(2 * radius + 1));
+   s32 wide_width = width - (width % SIMD_WIDTH);
+
+   for(s32 x = 0; x < wide_width; x += SIMD_WIDTH)
+   {
+      f32w sum = set_f32w(0.0f);
+      for(s32 y = 0; y < MINIMUM(radius, height); ++y)
+      {
+         sum = sum + loadu_f32w(source + (y * width) + x);
+      }
+
+      for(s32 y = 0; y < height; ++y)
+      {
+         if(y + radius < height)
+         {
+            sum = sum + loadu_f32w(source + ((y + radius) * width) + x);
+         }
+
+         storeu_f32w(destination + (y * width) + x, sum * inv_window);
+
+         if(y - radius >= 0)
+         {
+            sum = sum - loadu_f32w(source + ((y - radius) * width) + x);
+         }
+      }
+   }
+
+   float scalar_inv_window = 1.0f / (float)(2 * radius + 1);
+   for(s32 x = wide_width; x < width; ++x)
+   {
+      float sum = 0.0f;
+      for(s32 y = 0; y < MINIMUM(radius, height); ++y)
+      {
+         sum += source[(y * width) + x];
+      }
+
+      for(s32 y = 0; y < height; ++y)
+      {
+         if(y + radius < height)
+         {
+            sum += source[((y + radius) * width) + x];
+         }
+
+         destination[(y * width) + x] = sum * scalar_inv_window;
+
+         if(y - radius >= 0)
+         {
+            sum -= source[((y - radius) * width) + x];
+         }
+      }
+   }
+}
+
+BOX_BLUR_MASK(box_blur_mask)
+{
+   // NOTE: The scratch buffer must hold as many values as the mask, and the
+   // mask must be tightly packed.
+   assert(mask->stride == mask->width);
+   if(radius > 0)
+   {
+      box_blur_rows(scratch, mask->memory, mask->width, mask->height, radius);
+      box_blur_columns(mask->memory, scratch, mask->width, mask->height, radius);
+   }
+}
+
+GAUSSIAN_BLUR_MASK(gaussian_blur_mask)
+{
+   // NOTE: Approximate a Gaussian with three successive box blurs, with the
+   // box sizes chosen so that their combined variance matches sigma.
+   s32 pass_count = 3;
+
+   // NOTE: The ideal width is sqrt(12*sigma^2/n + 1). Rather than pull in a
+   // square root, step to the largest odd width whose square fits under it.
+   float ideal_width_squared = (12.0f * sigma * sigma / pass_count) + 1.0f;
+   s32 lower_width = 1;
+   while((float)((lower_width + 2) * (lower_width + 2)) <= ideal_width_squared)
+   {
+      lower_width += 2;
+   }
+   s32 upper_width = lower_width + 2;
+
+   float lower_count = ((12.0f * sigma * sigma) - (pass_count * lower_width * lower_width) - (4 * pass_count * lower_width) - (3 * pass_count)) / (float)(-4 * lower_width - 4);
+   s32 lower_pass_count = (s32)(lower_count + 0.5f);
+
+   for(s32 pass = 0; pass < pass_count; ++pass)
+   {
+      s32 box_width = (pass < lower_pass_count) ? lower_width : upper_width;
+      box_blur_mask(mask, scratch, (box_width - 1) / 2);
+   }
+}
+
+function void copy_row(u32 *destination, u32 *source, s32 count)
+{
+   // NOTE: Each vector is fully loaded before it's stored, so overlapping rows
+   // are handled by walking away from the side being overwritten: forwards
+   // when moving left and backwards when moving right.
+   s32 wide_count = count - (count % SIMD_WIDTH);
+
+   if(destination <= source || destination >= source + count)
+   {
+      for(s32 index = 0; index < wide_count; index += SIMD_WIDTH)
+      {
+         storeu_u32w((u32w *)(destination + index), loadu_u32w((u32w *)(source + index)));
+      }
+      for(s32 index = wide_count; index < count; ++index)
+      {
+         destination[index] = source[index];
+      }
+   }
+   else
+   {
+      for(s32 index = count - 1; index >= wide_count; --index)
+      {
+         destination[index] = source[index];
+      }
+      for(s32 index = wide_count - SIMD_WIDTH; index >= 0; index -= SIMD_WIDTH)
+      {
+         storeu_u32w((u32w *)(destination + index), loadu_u32w((u32w *)(source + index)));
+      }
+   }
+}
+
+COPY_REGION(copy_region)
+{
+   // NOTE: Move the pixels of a rectangle by (offsetx, offsety) within the
+   // same texture, with memmove semantics when the source and destination
+   // overlap. The source is limited to the texture and the destination to the
+   // current clip, so only pixels that exist on both ends are copied.
+   rectangle clip = get_clip_rectangle(destination);
+
+   s32 minx = MAXIMUM(MAXIMUM(x, 0) + offsetx, clip.x);
+   s32 miny = MAXIMUM(MAXIMUM(y, 0) + offsety, clip.y);
+   s32 maxx = MINIMUM(MINIMUM(x + width, destination->width) + offsetx, clip.x + clip.width);
+   s32 maxy = MINIMUM(MINIMUM(y + height, destination->height) + offsety, clip.y + clip.height);
+
+   if(minx >= maxx || miny >= maxy)
+   {
+      return;
+   }
+
+   s32 count = maxx - minx;
+   s32 stride = destination->width;
+   s32 source_offset = (offsety * stride) + offsetx;
+
+   if(offsety > 0)
+   {
+      // NOTE: Moving down, so copy the bottom row first.
+      for(s32 row = maxy - 1; row >= miny; --row)
+      {
+         u32 *destination_row = destination->memory + (row * stride) + minx;
+         copy_row(destination_row, destination_row - source_offset, count);
+      }
+   }
+   else
+   {
+      for(s32 row = miny; row < maxy; ++row)
+      {
+         u32 *destination_row = destination->memory + (row * stride) + minx;
+         copy_row(destination_row, destination_row - source_offset, count);
+      }
+   }
+}
+
 DRAW_OUTLINE(draw_outline)
 {
    draw_rectangle(destination, x, y, width, 1, color); // N
@@ -279,10 +899,11 @@ DRAW_OUTLINE(draw_outline)
 
 DRAW_RECTANGLE_25(draw_rectangle_25)
 {
-   int minx = MAXIMUM(x, 0);
-   int miny = MAXIMUM(y, 0);
-   int maxx = MINIMUM(x + width, destination->width);
-   int maxy = MINIMUM(y + height, destination->height);
+   rectangle clip = get_clip_rectangle(destination);
+   int minx = MAXIMUM(x, clip.x);
+   int miny = MAXIMUM(y, clip.y);
+   int maxx = MINIMUM(x + width, clip.x + clip.width);
+   int maxy = MINIMUM(y + height, clip.y + clip.height);
 
    u32 *memory = destination->memory;
 
@@ -305,10 +926,11 @@ DRAW_RECTANGLE_25(draw_rectangle_25)
 
 DRAW_RECTANGLE_50(draw_rectangle_50)
 {
-   int minx = MAXIMUM(x, 0);
-   int miny = MAXIMUM(y, 0);
-   int maxx = MINIMUM(x + width, destination->width);
-   int maxy = MINIMUM(y + height, destination->height);
+   rectangle clip = get_clip_rectangle(destination);
+   int minx = MAXIMUM(x, clip.x);
+   int miny = MAXIMUM(y, clip.y);
+   int maxx = MINIMUM(x + width, clip.x + clip.width);
+   int maxy = MINIMUM(y + height, clip.y + clip.height);
 
    u32 *memory = destination->memory;
 
@@ -331,10 +953,11 @@ DRAW_RECTANGLE_50(draw_rectangle_50)
 
 DRAW_RECTANGLE_75(draw_rectangle_75)
 {
-   int minx = MAXIMUM(x, 0);
-   int miny = MAXIMUM(y, 0);
-   int maxx = MINIMUM(x + width, destination->width);
-   int maxy = MINIMUM(y + height, destination->height);
+   rectangle clip = get_clip_rectangle(destination);
+   int minx = MAXIMUM(x, clip.x);
+   int miny = MAXIMUM(y, clip.y);
+   int maxx = MINIMUM(x + width, clip.x + clip.width);
+   int maxy = MINIMUM(y + height, clip.y + clip.height);
 
    u32 *memory = destination->memory;
 
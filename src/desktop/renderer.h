@@ -31,20 +31,85 @@ function u32 to_pixel(vec4 color)
    return(result);
 }
 
+function rectangle create_rectangle(s32 x, s32 y, s32 width, s32 height)
+{
+   rectangle result = {x, y, width, height};
+   return(result);
+}
+
+function bool in_rectangle(rectangle rect, s32 x, s32 y)
+{
+   bool result = (x >= rect.x && x < (rect.x + rect.width) &&
+                  y >= rect.y && y < (rect.y + rect.height));
+
+   return(result);
+}
+
+function rectangle resize_rectangle(rectangle rect, int offset)
+{
+   rectangle result = rect;
+   result.x -= offset;
+   result.y -= offset;
+
+   result.width += (offset*2);
+   result.height += (offset*2);
+
+   return(result);
+}
+
+function rectangle get_clip_rectangle(texture *destination)
+{
+   // NOTE: Primitives resolve this once per call and then iterate only over
+   // the clipped span, so clipping never costs anything per pixel.
+   rectangle result = {0, 0, destination->width, destination->height};
+   if(destination->clip && destination->clip->count)
+   {
+      result = destination->clip->entries[destination->clip->count - 1];
+   }
+
+   return(result);
+}
+
+typedef enum {
+   TEXTURE_FILTER_NEAREST,
+   TEXTURE_FILTER_BILINEAR,
+   TEXTURE_FILTER_BOX,
+} texture_filter;
+
+#define PUSH_CLIP(name) void name(texture *destination, int x, int y, int width, int height)
+#define POP_CLIP(name) void name(texture *destination)
+
 #define CLEAR(name) void name(texture *destination, vec4 color)
 #define DRAW_RECTANGLE(name) void name(texture *destination, int posx, int posy, int width, int height, vec4 color)
 #define DRAW_TEXTURE_BOUNDED(name) void name(texture *destination, texture *texture, int posx, int posy, int width, int height)
+#define DRAW_TEXTURE_TRANSLUCENT(name) void name(texture *destination, texture *texture, int posx, int posy, int width, int height, float opacity)
+#define DRAW_TEXTURE_SCALED(name) void name(texture *destination, texture *texture, int posx, int posy, int width, int height, texture_filter filter, float opacity)
 #define DRAW_TEXTURE(name) void name(texture *destination, texture *texture, int posx, int posy)
+#define DRAW_MASK(name) void name(texture *destination, alpha_mask *mask, int posx, int posy, vec4 color)
+#define DRAW_COVERAGE_MASK(name) void name(texture *destination, coverage_mask *mask, int posx, int posy, vec4 color)
+#define BOX_BLUR_MASK(name) void name(alpha_mask *mask, float *scratch, int radius)
+#define GAUSSIAN_BLUR_MASK(name) void name(alpha_mask *mask, float *scratch, float sigma)
+#define COPY_REGION(name) void name(texture *destination, int x, int y, int width, int height, int offsetx, int offsety)
 #define DRAW_OUTLINE(name) void name(texture *destination, int x, int y, int width, int height, vec4 color)
 
 #define DRAW_RECTANGLE_25(name) void name(texture *destination, int x, int y, int width, int height, vec4 color0, vec4 color1)
 #define DRAW_RECTANGLE_50(name) void name(texture *destination, int x, int y, int width, int height, vec4 color0, vec4 color1)
 #define DRAW_RECTANGLE_75(name) void name(texture *destination, int x, int y, int width, int height, vec4 color0, vec4 color1)
 
+EXTERN_C PUSH_CLIP(push_clip);
+EXTERN_C POP_CLIP(pop_clip);
+
 EXTERN_C CLEAR(clear);
 EXTERN_C DRAW_RECTANGLE(draw_rectangle);
 EXTERN_C DRAW_TEXTURE_BOUNDED(draw_texture_bounded);
+EXTERN_C DRAW_TEXTURE_TRANSLUCENT(draw_texture_translucent);
+EXTERN_C DRAW_TEXTURE_SCALED(draw_texture_scaled);
 EXTERN_C DRAW_TEXTURE(draw_texture);
+EXTERN_C DRAW_MASK(draw_mask);
+EXTERN_C DRAW_COVERAGE_MASK(draw_coverage_mask);
+EXTERN_C BOX_BLUR_MASK(box_blur_mask);
+EXTERN_C GAUSSIAN_BLUR_MASK(gaussian_blur_mask);
+EXTERN_C COPY_REGION(copy_region);
 EXTERN_C DRAW_OUTLINE(draw_outline);
 
 EXTERN_C DRAW_RECTANGLE_25(draw_rectangle_25);
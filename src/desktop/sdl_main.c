@@ -1,8 +1,27 @@
 /* (c) copyright 2024 Lawrence D. Kern ////////////////////////////////////// */
 
+#if !defined(_WIN32)
+// NOTE: Needed for the pseudo-terminal functions from the X/Open extensions.
+#   define _XOPEN_SOURCE 700
+#endif
+
 #include "SDL3/SDL.h"
 #include "desktop.h"
 
+#if !defined(_WIN32)
+#   define SDL_HAS_PTY 1
+#   include <errno.h>
+#   include <fcntl.h>
+#   include <poll.h>
+#   include <signal.h>
+#   include <sys/ioctl.h>
+#   include <unistd.h>
+
+extern char **environ;
+#else
+#   define SDL_HAS_PTY 0
+#endif
+
 typedef struct {
    SDL_Window *window;
    SDL_Renderer *renderer;
@@ -13,10 +32,56 @@ typedef struct {
    int refresh_rate;
    float seconds_per_frame;
 
-   u64 frame_counter_frequency;
-   u64 frame_start_counter;
+   // NOTE: All frame pacing timestamps are taken from SDL_GetTicksNS, which is
+   // backed by the high resolution performance counter.
+   u64 ns_per_frame;
+   u64 frame_start_ns;
+   u64 present_start_ns;
+   u64 present_end_ns;
+
+   // NOTE: Set when the OS asks for the window contents to be redrawn, which
+   // requires presenting the backbuffer even if the desktop didn't change.
+   bool needs_present;
+
+   // NOTE: Running estimate of how late the OS wakes us up from a sleep
+   // request. Sleeps are shortened by this amount so that the deadline can be
+   // reached without spinning for more than SDL_PACING_SPIN_LIMIT_NS.
+   u64 sleep_overshoot_ns;
+
+   // NOTE: Fractional wheel motion (e.g. from touchpads) is carried over until
+   // it adds up to a whole notch.
+   float wheel_remainder;
 } sdl_context;
 
+#if SDL_HAS_PTY
+typedef struct {
+   int master;
+   pid_t child;
+
+   u32 columns;
+   u32 rows;
+
+   // NOTE: Output from the attached process can arrive at any time, so a
+   // watcher thread blocks on the master side and pushes output_event to wake
+   // up the idle wait. Once it has fired, it doesn't watch again until
+   // sdl_update_pty has read the output and re-armed it.
+   SDL_Thread *watcher;
+   SDL_Semaphore *watch;
+   SDL_AtomicInt output_ready;
+   Uint32 output_event;
+} sdl_pty;
+#endif
+
+#define SDL_PACING_SPIN_LIMIT_NS        200000ULL
+#define SDL_PACING_OVERSHOOT_INITIAL_NS 1000000ULL
+#define SDL_PACING_OVERSHOOT_MAXIMUM_NS 4000000ULL
+
+static float sdl_ns_to_seconds(s64 ns)
+{
+   float result = (float)((double)ns / 1000000000.0);
+   return(result);
+}
+
 static void sdl_initialize(sdl_context *sdl)
 {
    SDL_Init(SDL_INIT_VIDEO);
@@ -61,8 +126,40 @@ static void sdl_initialize(sdl_context *sdl)
    SDL_Log("Target refresh rate: %d\n", sdl->refresh_rate);
    sdl->seconds_per_frame = 1.0f / sdl->refresh_rate;
 
-   sdl->frame_counter_frequency = SDL_GetPerformanceFrequency();
-   sdl->frame_start_counter = SDL_GetPerformanceCounter();
+   sdl->ns_per_frame = 1000000000ULL / sdl->refresh_rate;
+   sdl->sleep_overshoot_ns = SDL_PACING_OVERSHOOT_INITIAL_NS;
+   sdl->frame_start_ns = SDL_GetTicksNS();
+
+   SDL_StartTextInput(sdl->window);
+}
+
+static void sdl_push_text(desktop_input *input, char *text, u32 length)
+{
+   length = MINIMUM(length, DESKTOP_TEXT_INPUT_MAX - input->text_length);
+   memcpy(input->text + input->text_length, text, length);
+   input->text_length += length;
+}
+
+static void sdl_push_key_text(desktop_input *input, SDL_Keycode code, SDL_Keymod mod)
+{
+   // NOTE: Keys that produce bytes for a terminal, but no text input events.
+   if(code == SDLK_RETURN && !(mod & SDL_KMOD_ALT))
+   {
+      sdl_push_text(input, "\r", 1);
+   }
+   else if(code == SDLK_BACKSPACE)
+   {
+      sdl_push_text(input, "\x7f", 1);
+   }
+   else if(code == SDLK_UP)    {sdl_push_text(input, "\x1b[A", 3);}
+   else if(code == SDLK_DOWN)  {sdl_push_text(input, "\x1b[B", 3);}
+   else if(code == SDLK_RIGHT) {sdl_push_text(input, "\x1b[C", 3);}
+   else if(code == SDLK_LEFT)  {sdl_push_text(input, "\x1b[D", 3);}
+   else if((mod & SDL_KMOD_CTRL) && code >= 'a' && code <= 'z')
+   {
+      char control = (char)(code & 0x1F);
+      sdl_push_text(input, &control, 1);
+   }
 }
 
 static void sdl_toggle_fullscreen(SDL_Window *window)
@@ -79,6 +176,8 @@ static bool sdl_frame_begin(sdl_context *sdl, desktop_input *input, texture back
    {
       input->keys[key_index].changed_state = false;
    }
+   input->text_length = 0;
+   input->wheel_delta = 0;
 
    SDL_Event event;
    while(SDL_PollEvent(&event))
@@ -90,6 +189,11 @@ static bool sdl_frame_begin(sdl_context *sdl, desktop_input *input, texture back
             keep_running = false;
          } break;
 
+         case SDL_EVENT_WINDOW_EXPOSED:
+         {
+            sdl->needs_present = true;
+         } break;
+
          case SDL_EVENT_MOUSE_BUTTON_DOWN:
          case SDL_EVENT_MOUSE_BUTTON_UP:
          {
@@ -108,6 +212,25 @@ static bool sdl_frame_begin(sdl_context *sdl, desktop_input *input, texture back
             mouse_button->changed_state = true;
          } break;
 
+         case SDL_EVENT_MOUSE_WHEEL:
+         {
+            float delta = event.wheel.y;
+            if(event.wheel.direction == SDL_MOUSEWHEEL_FLIPPED)
+            {
+               delta = -delta;
+            }
+
+            sdl->wheel_remainder += delta;
+            s32 notches = (s32)sdl->wheel_remainder;
+            sdl->wheel_remainder -= (float)notches;
+            input->wheel_delta += notches;
+         } break;
+
+         case SDL_EVENT_TEXT_INPUT:
+         {
+            sdl_push_text(input, (char *)event.text.text, (u32)strlen(event.text.text));
+         } break;
+
          case SDL_EVENT_KEY_DOWN:
          case SDL_EVENT_KEY_UP:
          {
@@ -116,6 +239,11 @@ static bool sdl_frame_begin(sdl_context *sdl, desktop_input *input, texture back
             bool is_alt_pressed = (event.key.mod & SDL_KMOD_ALT);
 
             SDL_Keycode code = event.key.key;
+            if(pressed)
+            {
+               sdl_push_key_text(input, code, event.key.mod);
+            }
+
             if(pressed && !repeated)
             {
                if(code == SDLK_TAB)
@@ -123,6 +251,16 @@ static bool sdl_frame_begin(sdl_context *sdl, desktop_input *input, texture back
                   input->keys[INPUT_KEY_TAB].is_pressed = pressed;
                   input->keys[INPUT_KEY_TAB].changed_state = true;
                }
+               if(code == SDLK_F1)
+               {
+                  input->keys[INPUT_KEY_F1].is_pressed = pressed;
+                  input->keys[INPUT_KEY_F1].changed_state = true;
+               }
+               if(code == SDLK_F2)
+               {
+                  input->keys[INPUT_KEY_F2].is_pressed = pressed;
+                  input->keys[INPUT_KEY_F2].changed_state = true;
+               }
                if(code == SDLK_ESCAPE || (is_alt_pressed && code == SDLK_F4))
                {
                   keep_running = false;
@@ -136,6 +274,8 @@ static bool sdl_frame_begin(sdl_context *sdl, desktop_input *input, texture back
       }
    }
 
+   input->time_seconds = (double)SDL_GetTicksNS() / 1000000000.0;
+
    float mousex, mousey;
    SDL_GetMouseState(&mousex, &mousey);
 
@@ -155,6 +295,8 @@ static bool sdl_frame_begin(sdl_context *sdl, desktop_input *input, texture back
 
 static void sdl_render(sdl_context *sdl, texture backbuffer)
 {
+   sdl->present_start_ns = SDL_GetTicksNS();
+
    SDL_SetRenderDrawColor(sdl->renderer, 0x18, 0x18, 0x18, 0xFF);
    SDL_RenderClear(sdl->renderer);
 
@@ -163,37 +305,302 @@ static void sdl_render(sdl_context *sdl, texture backbuffer)
    SDL_RenderTexture(sdl->renderer, sdl->texture, 0, 0);
 
    SDL_RenderPresent(sdl->renderer);
+
+   sdl->present_end_ns = SDL_GetTicksNS();
+   sdl->needs_present = false;
 }
 
-#define SDL_GET_SECONDS_ELAPSED(start, end) ((float)((end) - (start)) / (float)(sdl->frame_counter_frequency))
+static void sdl_learn_sleep_overshoot(sdl_context *sdl, u64 requested_ns, u64 slept_ns)
+{
+   u64 overshoot_ns = (slept_ns > requested_ns) ? (slept_ns - requested_ns) : 0;
+   overshoot_ns = MINIMUM(overshoot_ns, SDL_PACING_OVERSHOOT_MAXIMUM_NS);
+
+   // NOTE: Late wake-ups are adopted immediately, since missing the deadline is
+   // worse than spinning for a little longer. Early ones decay the estimate
+   // slowly, so that a single lucky sleep doesn't undo what was learned.
+   if(overshoot_ns > sdl->sleep_overshoot_ns)
+   {
+      sdl->sleep_overshoot_ns = overshoot_ns;
+   }
+   else
+   {
+      sdl->sleep_overshoot_ns -= (sdl->sleep_overshoot_ns - overshoot_ns) / 8;
+   }
+}
 
 static void sdl_frame_end(sdl_context *sdl, desktop_input *input)
 {
    input->previous_mousex = input->mousex;
    input->previous_mousey = input->mousey;
 
-   u32 sleep_ms = 0;
-   u64 frame_end_counter = SDL_GetPerformanceCounter();
-   float frame_seconds_elapsed = SDL_GET_SECONDS_ELAPSED(sdl->frame_start_counter, frame_end_counter);
-   if(frame_seconds_elapsed < sdl->seconds_per_frame)
+   u64 target_ns = sdl->frame_start_ns + sdl->ns_per_frame;
+   u64 sleep_start_ns = SDL_GetTicksNS();
+   u64 now_ns = sleep_start_ns;
+
+   // NOTE: Sleep through the frame slack, waking up early by the learned
+   // overshoot. This normally takes a single request, but is repeated if the
+   // OS happened to wake us before the spin window.
+   while((now_ns + sdl->sleep_overshoot_ns + SDL_PACING_SPIN_LIMIT_NS) < target_ns)
    {
-      sleep_ms = (u32)(((sdl->seconds_per_frame - frame_seconds_elapsed) * 1000.0f) - 1);
-      SDL_Delay(sleep_ms);
+      u64 requested_ns = target_ns - now_ns - sdl->sleep_overshoot_ns;
+      SDL_DelayNS(requested_ns);
+
+      u64 wake_ns = SDL_GetTicksNS();
+      sdl_learn_sleep_overshoot(sdl, requested_ns, wake_ns - now_ns);
+      now_ns = wake_ns;
    }
-   while(frame_seconds_elapsed < sdl->seconds_per_frame)
+
+   // NOTE: Spin for whatever is left of the frame, but never for longer than
+   // the spin limit. Ending a few microseconds early is preferable to burning
+   // a core when the overshoot estimate is high.
+   u64 spin_end_ns = MINIMUM(target_ns, now_ns + SDL_PACING_SPIN_LIMIT_NS);
+   while(now_ns < spin_end_ns)
    {
-      frame_end_counter = SDL_GetPerformanceCounter();
-      frame_seconds_elapsed = SDL_GET_SECONDS_ELAPSED(sdl->frame_start_counter, frame_end_counter);
+      now_ns = SDL_GetTicksNS();
    }
 
+   frame_timing *timing = input->frame_timings + input->frame_timing_index;
+   timing->work_seconds = sdl_ns_to_seconds(sdl->present_start_ns - sdl->frame_start_ns);
+   timing->present_seconds = sdl_ns_to_seconds(sdl->present_end_ns - sdl->present_start_ns);
+   timing->sleep_seconds = sdl_ns_to_seconds(now_ns - sleep_start_ns);
+   timing->overshoot_seconds = sdl_ns_to_seconds((s64)now_ns - (s64)target_ns);
+   input->frame_timing_index = (input->frame_timing_index + 1) % DESKTOP_FRAME_TIMING_COUNT;
+
    input->frame_count++;
-   input->frame_seconds_elapsed = frame_seconds_elapsed;
+   input->frame_seconds_elapsed = sdl_ns_to_seconds(now_ns - sdl->frame_start_ns);
    input->target_seconds_per_frame = sdl->seconds_per_frame;
-   input->sleep_ms = sleep_ms / 1000.0f;
+   input->sleep_seconds_elapsed = timing->sleep_seconds;
+
+   sdl->frame_start_ns = now_ns;
+}
+
+static void sdl_frame_idle(sdl_context *sdl, desktop_input *input, s32 timeout_ms)
+{
+   input->previous_mousex = input->mousex;
+   input->previous_mousey = input->mousey;
+
+   // NOTE: Nothing changed on the desktop, so block until the next event
+   // arrives or a desktop timer is due. The event is left in the queue for
+   // sdl_frame_begin to process.
+   SDL_WaitEventTimeout(0, timeout_ms);
+
+   // NOTE: Restart pacing from the wake-up, so that the time spent blocked
+   // doesn't count as a long frame.
+   sdl->frame_start_ns = SDL_GetTicksNS();
+   input->frame_seconds_elapsed = sdl->seconds_per_frame;
+   input->sleep_seconds_elapsed = 0.0f;
+}
+
+#if SDL_HAS_PTY
+static void sdl_set_pty_size(sdl_pty *pty, u32 columns, u32 rows)
+{
+   struct winsize size = {0};
+   size.ws_col = (unsigned short)columns;
+   size.ws_row = (unsigned short)rows;
+
+   if(ioctl(pty->master, TIOCSWINSZ, &size) == 0)
+   {
+      pty->columns = columns;
+      pty->rows = rows;
+   }
+}
+
+static bool sdl_open_pty(sdl_pty *pty, desktop_terminal *terminal)
+{
+   // NOTE: Start the user's shell on a new pseudo-terminal, with the desktop
+   // holding the master side.
+   pty->master = posix_openpt(O_RDWR | O_NOCTTY);
+   if(pty->master == -1 || grantpt(pty->master) == -1 || unlockpt(pty->master) == -1)
+   {
+      SDL_Log("Warning: Failed to create a pseudo-terminal (%d).", errno);
+      if(pty->master != -1)
+      {
+         close(pty->master);
+         pty->master = -1;
+      }
+      return(false);
+   }
+
+   char *slave_path = ptsname(pty->master);
+   sdl_set_pty_size(pty, terminal->columns, terminal->rows);
+
+   // NOTE: Other threads are already running by now, so the child can only use
+   // async-signal-safe functions between fork and exec. Anything that might
+   // allocate or take a lock, like editing the environment, happens up here.
+   char *shell = getenv("SHELL");
+   if(!shell)
+   {
+      shell = "/bin/sh";
+   }
+   char *shell_arguments[] = {shell, 0};
 
-   sdl->frame_start_counter = frame_end_counter;
+   u32 environment_count = 0;
+   while(environ[environment_count])
+   {
+      environment_count++;
+   }
+
+   char **environment = SDL_malloc((environment_count + 2) * sizeof(char *));
+   if(!environment)
+   {
+      SDL_Log("Warning: Failed to allocate the terminal environment.");
+      close(pty->master);
+      pty->master = -1;
+      return(false);
+   }
+
+   // NOTE: The terminal only handles a handful of escape sequences.
+   u32 environment_length = 0;
+   for(u32 index = 0; index < environment_count; ++index)
+   {
+      if(strncmp(environ[index], "TERM=", 5) != 0)
+      {
+         environment[environment_length++] = environ[index];
+      }
+   }
+   environment[environment_length++] = "TERM=dumb";
+   environment[environment_length] = 0;
+
+   pty->child = fork();
+   if(pty->child == 0)
+   {
+      setsid();
+
+      int slave = open(slave_path, O_RDWR);
+      if(slave == -1)
+      {
+         _exit(127);
+      }
+      ioctl(slave, TIOCSCTTY, 0);
+
+      dup2(slave, STDIN_FILENO);
+      dup2(slave, STDOUT_FILENO);
+      dup2(slave, STDERR_FILENO);
+      if(slave > STDERR_FILENO)
+      {
+         close(slave);
+      }
+      close(pty->master);
+
+      execve(shell, shell_arguments, environment);
+      _exit(127);
+   }
+
+   SDL_free(environment);
+   if(pty->child == -1)
+   {
+      SDL_Log("Warning: Failed to start the terminal shell (%d).", errno);
+      close(pty->master);
+      pty->master = -1;
+      return(false);
+   }
+
+   fcntl(pty->master, F_SETFL, fcntl(pty->master, F_GETFL) | O_NONBLOCK);
+   return(true);
+}
+
+static int sdl_watch_pty(void *data)
+{
+   sdl_pty *pty = data;
+   for(;;)
+   {
+      SDL_WaitSemaphore(pty->watch);
+
+      // NOTE: Hang-ups and errors also end the wait, so that sdl_update_pty
+      // gets to see the end of file and close the master.
+      struct pollfd descriptor = {0};
+      descriptor.fd = pty->master;
+      descriptor.events = POLLIN;
+      while(poll(&descriptor, 1, -1) == -1 && errno == EINTR);
+
+      SDL_SetAtomicInt(&pty->output_ready, 1);
+
+      SDL_Event event = {0};
+      event.type = pty->output_event;
+      SDL_PushEvent(&event);
+   }
+   return(0);
 }
 
+static void sdl_start_pty_watcher(sdl_pty *pty)
+{
+   pty->output_event = SDL_RegisterEvents(1);
+   pty->watch = SDL_CreateSemaphore(0);
+   if(pty->output_event && pty->watch)
+   {
+      // NOTE: The first call to sdl_update_pty arms the watcher.
+      SDL_SetAtomicInt(&pty->output_ready, 1);
+
+      // NOTE: The watcher may be blocked in poll when the desktop exits, so
+      // it is left for process exit to clean up.
+      pty->watcher = SDL_CreateThread(sdl_watch_pty, "pty watcher", pty);
+      SDL_DetachThread(pty->watcher);
+   }
+
+   if(!pty->watcher)
+   {
+      SDL_Log("Warning: Failed to start the terminal watcher, output will only show up with other input.");
+   }
+}
+
+static void sdl_update_pty(sdl_pty *pty, desktop_context *desktop)
+{
+   if(pty->master == -1)
+   {
+      return;
+   }
+
+   desktop_terminal *terminal = &desktop->terminal;
+   if(terminal->columns != pty->columns || terminal->rows != pty->rows)
+   {
+      sdl_set_pty_size(pty, terminal->columns, terminal->rows);
+   }
+
+   if(terminal->input_length)
+   {
+      ssize_t written = write(pty->master, terminal->input, terminal->input_length);
+      if(written > 0)
+      {
+         terminal->input_length -= (u32)written;
+         memmove(terminal->input, terminal->input + written, terminal->input_length);
+      }
+   }
+
+   // NOTE: Drain the output up to the per-frame budget. Anything left over
+   // stays in the kernel buffer until the next frame, which applies back
+   // pressure to the process instead of dropping frames.
+   static u8 buffer[KILOBYTES(64)];
+   memindex total = 0;
+   while(total < TERMINAL_WRITE_BUDGET)
+   {
+      ssize_t count = read(pty->master, buffer, sizeof(buffer));
+      if(count > 0)
+      {
+         desktop_terminal_write(desktop, buffer, count);
+         total += count;
+      }
+      else
+      {
+         if(count == 0 || (errno != EAGAIN && errno != EINTR))
+         {
+            // NOTE: The shell exited, which shows up as EIO on Linux.
+            close(pty->master);
+            pty->master = -1;
+         }
+         break;
+      }
+   }
+
+   // NOTE: The output has been drained as far as this frame allows. Anything
+   // left over wakes the watcher straight away, so it still gets read even if
+   // nothing else on the desktop changes.
+   if(pty->master != -1 && pty->watcher && SDL_CompareAndSwapAtomicInt(&pty->output_ready, 1, 0))
+   {
+      SDL_SignalSemaphore(pty->watch);
+   }
+}
+#endif
+
 int main(int argument_count, char **arguments)
 {
    sdl_context sdl = {0};
@@ -201,14 +608,43 @@ int main(int argument_count, char **arguments)
 
    desktop_context desktop = {0};
    desktop_initialize(&desktop, sdl.width, sdl.height);
+   desktop.config.cursor_scale = SDL_GetWindowDisplayScale(sdl.window);
+
+#if SDL_HAS_PTY
+   sdl_pty pty = {0};
+   signal(SIGCHLD, SIG_IGN);
+   if(sdl_open_pty(&pty, &desktop.terminal))
+   {
+      sdl_start_pty_watcher(&pty);
+   }
+#endif
 
    while(sdl_frame_begin(&sdl, &desktop.input, desktop.backbuffer))
    {
-      desktop_update(&desktop);
+#if SDL_HAS_PTY
+      sdl_update_pty(&pty, &desktop);
+#endif
 
-      sdl_render(&sdl, desktop.backbuffer);
-      sdl_frame_end(&sdl, &desktop.input);
+      bool changed = desktop_update(&desktop);
+      if(changed || sdl.needs_present)
+      {
+         sdl_render(&sdl, desktop.backbuffer);
+         sdl_frame_end(&sdl, &desktop.input);
+      }
+      else
+      {
+         sdl_frame_idle(&sdl, &desktop.input, desktop.idle_timeout_ms);
+      }
    }
 
+#if SDL_HAS_PTY
+   if(pty.master != -1)
+   {
+      close(pty.master);
+   }
+#endif
+
+   desktop_shutdown(&desktop);
+
    return(0);
 }
@@ -35,6 +35,21 @@ function void storeu_u32w(u32w *destination, u32w vector)
    *destination = vector;
 }
 
+function f32w loadu_f32w(float *source)
+{
+   return(*source);
+}
+
+function void storeu_f32w(float *destination, f32w vector)
+{
+   *destination = vector;
+}
+
+function u32w gather_u32w(u32 *base, s32 *offsets)
+{
+   return(base[offsets[0]]);
+}
+
 /////////////////////////////////////////////////////////////////////////////////
 
 #elif(SIMD_WIDTH == 4)
@@ -116,6 +131,22 @@ function void storeu_u32w(u32w *destination, u32w vector)
    _mm_storeu_si128(&destination->value, vector.value);
 }
 
+function f32w loadu_f32w(float *source)
+{
+   return {_mm_loadu_ps(source)};
+}
+
+function void storeu_f32w(float *destination, f32w vector)
+{
+   _mm_storeu_ps(destination, vector.value);
+}
+
+function u32w gather_u32w(u32 *base, s32 *offsets)
+{
+   // NOTE: SSE has no gather instruction, so assemble the lanes individually.
+   return {_mm_setr_epi32(base[offsets[0]], base[offsets[1]], base[offsets[2]], base[offsets[3]])};
+}
+
 /////////////////////////////////////////////////////////////////////////////////
 
 #elif(SIMD_WIDTH == 8)
@@ -197,6 +228,22 @@ function void storeu_u32w(u32w *destination, u32w vector)
    _mm256_storeu_si256(&destination->value, vector.value);
 }
 
+function f32w loadu_f32w(float *source)
+{
+   return {_mm256_loadu_ps(source)};
+}
+
+function void storeu_f32w(float *destination, f32w vector)
+{
+   _mm256_storeu_ps(destination, vector.value);
+}
+
+function u32w gather_u32w(u32 *base, s32 *offsets)
+{
+   __m256i indices = _mm256_loadu_si256((__m256i *)offsets);
+   return {_mm256_i32gather_epi32((int const *)base, indices, 4)};
+}
+
 #else
 #   error Unsupported SIMD width.
 #endif
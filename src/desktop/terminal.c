@@ -0,0 +1,491 @@
+/* /////////////////////////////////////////////////////////////////////////// */
+/* (c) copyright 2024 Lawrence D. Kern /////////////////////////////////////// */
+/* /////////////////////////////////////////////////////////////////////////// */
+
+// NOTE: The terminal understands printable ASCII, the common control
+// characters and a small subset of CSI sequences (cursor movement and
+// erasing). Anything else is consumed without effect, so the attached process
+// should be told it's running on a dumb terminal.
+
+#define TERMINAL_CELL_WIDTH (FONT_WIDTH * FONT_SCALE)
+#define TERMINAL_CELL_HEIGHT (FONT_LEADING * FONT_SCALE)
+#define TERMINAL_TAB_WIDTH 8
+#define TERMINAL_WHEEL_LINES 3
+
+function void initialize_terminal(desktop_terminal *terminal, arena *a)
+{
+   memindex cell_count = TERMINAL_SCROLLBACK_LINES * TERMINAL_MAX_COLUMNS;
+   terminal->cells = arena_allocate(a, u8, cell_count);
+   assert(terminal->cells);
+   zero_memory(terminal->cells, cell_count);
+
+   terminal->columns = 80;
+   terminal->rows = 24;
+   terminal->last_line = terminal->rows - 1;
+   terminal->needs_full_redraw = true;
+}
+
+function u8 *get_terminal_line(desktop_terminal *terminal, u32 line)
+{
+   u8 *result = terminal->cells + ((line % TERMINAL_SCROLLBACK_LINES) * TERMINAL_MAX_COLUMNS);
+   return(result);
+}
+
+function u32 get_terminal_first_visible_line(desktop_terminal *terminal)
+{
+   u32 result = terminal->last_line - terminal->view_offset - (terminal->rows - 1);
+   return(result);
+}
+
+function u32 get_terminal_max_view_offset(desktop_terminal *terminal)
+{
+   // NOTE: Limited both by the lines written so far and by the ring size, so
+   // that a visible line is never recycled for new output.
+   u32 result = MINIMUM(terminal->last_line - (terminal->rows - 1), TERMINAL_SCROLLBACK_LINES - terminal->rows);
+   return(result);
+}
+
+function bool is_terminal_row_dirty(desktop_terminal *terminal, u32 row)
+{
+   bool result = (terminal->dirty_rows[row / 64] >> (row % 64)) & 1;
+   return(result);
+}
+
+function void mark_terminal_line(desktop_terminal *terminal, u32 line)
+{
+   s64 row = (s64)line - (s64)get_terminal_first_visible_line(terminal);
+   if(row >= 0 && row < terminal->rows)
+   {
+      terminal->dirty_rows[row / 64] |= (1ULL << (row % 64));
+   }
+}
+
+function void mark_terminal_rows(desktop_terminal *terminal, s32 first_row, s32 last_row)
+{
+   for(s32 row = MAXIMUM(first_row, 0); row <= last_row && row < (s32)terminal->rows; ++row)
+   {
+      terminal->dirty_rows[row / 64] |= (1ULL << (row % 64));
+   }
+}
+
+function void scroll_terminal_contents(desktop_terminal *terminal, s32 count)
+{
+   // NOTE: The visible contents moved up by count rows (down if negative).
+   // Dirty flags move with the rows they describe, and the rows scrolled into
+   // view are flagged. Scrolling by a whole screen or more is cheaper to
+   // handle as a full redraw than as a copy.
+   if(terminal->needs_full_redraw)
+   {
+      return;
+   }
+
+   terminal->pending_scroll += count;
+
+   s32 rows = (s32)terminal->rows;
+   if(terminal->pending_scroll >= rows || terminal->pending_scroll <= -rows)
+   {
+      terminal->needs_full_redraw = true;
+      return;
+   }
+
+   u64 shifted[countof(terminal->dirty_rows)] = {0};
+   for(s32 row = 0; row < rows; ++row)
+   {
+      s32 destination = row - count;
+      if(is_terminal_row_dirty(terminal, row) && destination >= 0 && destination < rows)
+      {
+         shifted[destination / 64] |= (1ULL << (destination % 64));
+      }
+   }
+   memcpy(terminal->dirty_rows, shifted, sizeof(shifted));
+
+   if(count > 0)
+   {
+      mark_terminal_rows(terminal, rows - count, rows - 1);
+   }
+   else
+   {
+      mark_terminal_rows(terminal, 0, -count - 1);
+   }
+}
+
+function void set_terminal_view_offset(desktop_terminal *terminal, s32 offset)
+{
+   offset = MAXIMUM(offset, 0);
+   offset = MINIMUM(offset, (s32)get_terminal_max_view_offset(terminal));
+
+   s32 delta = offset - (s32)terminal->view_offset;
+   if(delta)
+   {
+      terminal->view_offset = offset;
+      scroll_terminal_contents(terminal, -delta);
+   }
+}
+
+function void terminal_newline(desktop_terminal *terminal)
+{
+   terminal->cursor_line++;
+   if(terminal->cursor_line > terminal->last_line)
+   {
+      terminal->last_line = terminal->cursor_line;
+      zero_memory(get_terminal_line(terminal, terminal->last_line), TERMINAL_MAX_COLUMNS);
+
+      // NOTE: While browsing the scrollback, keep the view still by moving it
+      // back along with the new line, for as long as the ring allows.
+      if(terminal->view_offset && terminal->view_offset < get_terminal_max_view_offset(terminal))
+      {
+         terminal->view_offset++;
+      }
+      else
+      {
+         terminal->view_offset = MINIMUM(terminal->view_offset, get_terminal_max_view_offset(terminal));
+         scroll_terminal_contents(terminal, 1);
+      }
+   }
+
+   mark_terminal_line(terminal, terminal->cursor_line);
+}
+
+function void erase_terminal_line(desktop_terminal *terminal, u32 line, u32 first_column, u32 last_column)
+{
+   if(first_column < last_column)
+   {
+      zero_memory(get_terminal_line(terminal, line) + first_column, last_column - first_column);
+      mark_terminal_line(terminal, line);
+   }
+}
+
+function void resize_terminal(desktop_terminal *terminal, u32 columns, u32 rows)
+{
+   columns = MAXIMUM(MINIMUM(columns, TERMINAL_MAX_COLUMNS), 1);
+   rows = MAXIMUM(MINIMUM(rows, TERMINAL_MAX_ROWS), 1);
+
+   if(columns != terminal->columns || rows != terminal->rows)
+   {
+      terminal->columns = columns;
+      terminal->rows = rows;
+
+      // NOTE: The screen stays anchored to the last line. If that would put
+      // the cursor above the top row, the screen is moved up to it instead.
+      terminal->last_line = MAXIMUM(terminal->last_line, rows - 1);
+      if(terminal->cursor_line + rows <= terminal->last_line)
+      {
+         terminal->last_line = MAXIMUM(terminal->cursor_line, rows - 1);
+      }
+
+      terminal->cursor_column = MINIMUM(terminal->cursor_column, columns);
+      terminal->view_offset = MINIMUM(terminal->view_offset, get_terminal_max_view_offset(terminal));
+      terminal->needs_full_redraw = true;
+   }
+}
+
+function void execute_terminal_csi(desktop_terminal *terminal, u8 command)
+{
+   u32 first_line = terminal->last_line - (terminal->rows - 1);
+
+   u32 parameter0 = terminal->parameters[0];
+   u32 parameter1 = terminal->parameters[1];
+   u32 count = MAXIMUM(parameter0, 1);
+
+   mark_terminal_line(terminal, terminal->cursor_line);
+
+   switch(command)
+   {
+      case 'A':
+      {
+         terminal->cursor_line -= MINIMUM(count, terminal->cursor_line - first_line);
+      } break;
+
+      case 'B':
+      {
+         terminal->cursor_line = MINIMUM(terminal->cursor_line + count, terminal->last_line);
+      } break;
+
+      case 'C':
+      {
+         terminal->cursor_column = MINIMUM(terminal->cursor_column + count, terminal->columns - 1);
+      } break;
+
+      case 'D':
+      {
+         terminal->cursor_column -= MINIMUM(count, terminal->cursor_column);
+      } break;
+
+      case 'H':
+      case 'f':
+      {
+         // NOTE: Positions are one-based, and zero means the default of one.
+         u32 row = MINIMUM(MAXIMUM(parameter0, 1), terminal->rows) - 1;
+         u32 column = MINIMUM(MAXIMUM(parameter1, 1), terminal->columns) - 1;
+
+         terminal->cursor_line = first_line + row;
+         terminal->cursor_column = column;
+      } break;
+
+      case 'J':
+      {
+         // NOTE: 0 erases below the cursor, 1 above it and 2 the whole screen.
+         u32 begin = (parameter0 == 0) ? terminal->cursor_line + 1 : first_line;
+         u32 end = (parameter0 == 1) ? terminal->cursor_line : terminal->last_line + 1;
+         for(u32 line = begin; line < end; ++line)
+         {
+            erase_terminal_line(terminal, line, 0, TERMINAL_MAX_COLUMNS);
+         }
+
+         if(parameter0 == 0)
+         {
+            erase_terminal_line(terminal, terminal->cursor_line, terminal->cursor_column, TERMINAL_MAX_COLUMNS);
+         }
+         else if(parameter0 == 1)
+         {
+            erase_terminal_line(terminal, terminal->cursor_line, 0, MINIMUM(terminal->cursor_column + 1, TERMINAL_MAX_COLUMNS));
+         }
+         else
+         {
+            erase_terminal_line(terminal, terminal->cursor_line, 0, TERMINAL_MAX_COLUMNS);
+         }
+      } break;
+
+      case 'K':
+      {
+         u32 begin = (parameter0 == 0) ? terminal->cursor_column : 0;
+         u32 end = (parameter0 == 1) ? terminal->cursor_column + 1 : TERMINAL_MAX_COLUMNS;
+         erase_terminal_line(terminal, terminal->cursor_line, begin, MINIMUM(end, TERMINAL_MAX_COLUMNS));
+      } break;
+
+      default:
+      {
+         // NOTE: Attributes, modes and everything else are ignored.
+      } break;
+   }
+
+   mark_terminal_line(terminal, terminal->cursor_line);
+}
+
+function void put_terminal_text(desktop_terminal *terminal, u8 *text, u32 count)
+{
+   // NOTE: The text must fit on the rest of the current line, once the cursor
+   // has wrapped to the next one if it was past the end.
+   if(terminal->cursor_column >= terminal->columns)
+   {
+      terminal->cursor_column = 0;
+      terminal_newline(terminal);
+   }
+
+   u8 *line = get_terminal_line(terminal, terminal->cursor_line);
+   memcpy(line + terminal->cursor_column, text, count);
+
+   terminal->cursor_column += count;
+   mark_terminal_line(terminal, terminal->cursor_line);
+}
+
+function void write_terminal(desktop_terminal *terminal, u8 *data, memindex count)
+{
+   mark_terminal_line(terminal, terminal->cursor_line);
+
+   memindex index = 0;
+   while(index < count)
+   {
+      u8 byte = data[index];
+
+      if(terminal->parse_state == TERMINAL_PARSE_TEXT && byte >= 0x20 && byte < 0x7F)
+      {
+         // NOTE: Copy the longest run of printable bytes that fits on the
+         // current line in one go, since that's what nearly all output is.
+         u32 available = terminal->columns;
+         if(terminal->cursor_column < terminal->columns)
+         {
+            available -= terminal->cursor_column;
+         }
+
+         u32 run = 0;
+         while(run < available && index + run < count && data[index + run] >= 0x20 && data[index + run] < 0x7F)
+         {
+            run++;
+         }
+
+         put_terminal_text(terminal, data + index, run);
+
+         index += run;
+         continue;
+      }
+
+      switch(terminal->parse_state)
+      {
+         case TERMINAL_PARSE_TEXT:
+         {
+            if(byte == '\n')
+            {
+               terminal_newline(terminal);
+            }
+            else if(byte == '\r')
+            {
+               terminal->cursor_column = 0;
+            }
+            else if(byte == '\b')
+            {
+               terminal->cursor_column -= (terminal->cursor_column > 0);
+            }
+            else if(byte == '\t')
+            {
+               u32 column = (terminal->cursor_column + TERMINAL_TAB_WIDTH) & ~(TERMINAL_TAB_WIDTH - 1);
+               terminal->cursor_column = MINIMUM(column, terminal->columns - 1);
+            }
+            else if(byte == 0x1B)
+            {
+               terminal->parse_state = TERMINAL_PARSE_ESCAPE;
+            }
+            else if(byte >= 0xC0)
+            {
+               // NOTE: The font only covers ASCII, so each UTF-8 sequence is
+               // shown as a single placeholder. Continuation bytes are dropped.
+               u8 placeholder = '?';
+               put_terminal_text(terminal, &placeholder, 1);
+            }
+         } break;
+
+         case TERMINAL_PARSE_ESCAPE:
+         {
+            terminal->parse_state = TERMINAL_PARSE_TEXT;
+            if(byte == '[')
+            {
+               terminal->parse_state = TERMINAL_PARSE_CSI;
+               terminal->parameters[0] = 0;
+               terminal->parameters[1] = 0;
+               terminal->parameter_index = 0;
+            }
+            else if(byte == ']')
+            {
+               terminal->parse_state = TERMINAL_PARSE_OSC;
+            }
+         } break;
+
+         case TERMINAL_PARSE_CSI:
+         {
+            if(byte >= '0' && byte <= '9')
+            {
+               if(terminal->parameter_index < countof(terminal->parameters))
+               {
+                  u32 *parameter = terminal->parameters + terminal->parameter_index;
+                  *parameter = MINIMUM((*parameter * 10) + (byte - '0'), 9999);
+               }
+            }
+            else if(byte == ';')
+            {
+               terminal->parameter_index++;
+            }
+            else if(byte >= 0x40 && byte <= 0x7E)
+            {
+               execute_terminal_csi(terminal, byte);
+               terminal->parse_state = TERMINAL_PARSE_TEXT;
+            }
+         } break;
+
+         case TERMINAL_PARSE_OSC:
+         {
+            // NOTE: Operating system commands (e.g. window titles) end with BEL
+            // or with ST, which starts with an escape.
+            if(byte == 0x07)
+            {
+               terminal->parse_state = TERMINAL_PARSE_TEXT;
+            }
+            else if(byte == 0x1B)
+            {
+               terminal->parse_state = TERMINAL_PARSE_ESCAPE;
+            }
+         } break;
+      }
+
+      index++;
+   }
+
+   mark_terminal_line(terminal, terminal->cursor_line);
+
+   terminal->bytes_written += count;
+   terminal->window_bytes += count;
+}
+
+function bool terminal_has_changes(desktop_terminal *terminal)
+{
+   bool result = (terminal->needs_full_redraw || terminal->pending_scroll != 0);
+   for(u32 index = 0; !result && index < countof(terminal->dirty_rows); ++index)
+   {
+      result = (terminal->dirty_rows[index] != 0);
+   }
+
+   return(result);
+}
+
+function void rasterize_terminal(desktop_terminal *terminal, texture *canvas, vec4 background, vec4 foreground)
+{
+   u32 background_pixel = to_pixel(background);
+   if(background_pixel != terminal->drawn_background)
+   {
+      terminal->drawn_background = background_pixel;
+      terminal->needs_full_redraw = true;
+   }
+
+   s32 rows = (s32)terminal->rows;
+   if(terminal->needs_full_redraw)
+   {
+      clear(canvas, background);
+      mark_terminal_rows(terminal, 0, rows - 1);
+   }
+   else if(terminal->pending_scroll)
+   {
+      // NOTE: Move everything that's still visible in one copy, so that only
+      // the rows that scrolled into view need to be drawn.
+      s32 offset = terminal->pending_scroll * TERMINAL_CELL_HEIGHT;
+      s32 height = (rows * TERMINAL_CELL_HEIGHT) - MAXIMUM(offset, -offset);
+      copy_region(canvas, 0, MAXIMUM(offset, 0), canvas->width, height, 0, -offset);
+   }
+   terminal->needs_full_redraw = false;
+   terminal->pending_scroll = 0;
+
+   u32 first_line = get_terminal_first_visible_line(terminal);
+   s32 text_offset = (TERMINAL_CELL_HEIGHT - (FONT_HEIGHT * FONT_SCALE)) / 2;
+
+   for(s32 row = 0; row < rows; ++row)
+   {
+      if(!is_terminal_row_dirty(terminal, row))
+      {
+         continue;
+      }
+
+      u32 line = first_line + row;
+      s32 y = row * TERMINAL_CELL_HEIGHT;
+
+      draw_rectangle(canvas, 0, y, canvas->width, TERMINAL_CELL_HEIGHT, background);
+
+      string8 text = string8new(get_terminal_line(terminal, line), terminal->columns);
+      draw_text(canvas, 0, y + text_offset, foreground, text);
+
+      if(line == terminal->cursor_line)
+      {
+         u32 column = MINIMUM(terminal->cursor_column, terminal->columns - 1);
+         draw_rectangle(canvas, column * TERMINAL_CELL_WIDTH, y + TERMINAL_CELL_HEIGHT - 2, TERMINAL_CELL_WIDTH, 2, foreground);
+      }
+   }
+
+   zero_memory(terminal->dirty_rows, sizeof(terminal->dirty_rows));
+}
+
+function void queue_terminal_input(desktop_terminal *terminal, u8 *data, u32 count)
+{
+   count = MINIMUM(count, TERMINAL_INPUT_MAX - terminal->input_length);
+   memcpy(terminal->input + terminal->input_length, data, count);
+   terminal->input_length += count;
+
+   set_terminal_view_offset(terminal, 0);
+}
+
+function void update_terminal_throughput(desktop_terminal *terminal, double time_seconds)
+{
+   double elapsed = time_seconds - terminal->window_start_seconds;
+   if(elapsed >= 1.0)
+   {
+      terminal->megabytes_per_second = (float)((double)terminal->window_bytes / (double)MEGABYTES(1) / elapsed);
+      terminal->window_bytes = 0;
+      terminal->window_start_seconds = time_seconds;
+   }
+}
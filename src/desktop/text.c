@@ -560,14 +560,15 @@ function void draw_text(texture *backbuffer, s32 x, s32 y, vec4 color4, string8
 {
    u32 color = to_pixel(color4);
 
-   s32 bounded_minx = MAXIMUM(0, x);
-   s32 bounded_miny = MAXIMUM(0, y);
+   rectangle clip = get_clip_rectangle(backbuffer);
+   s32 bounded_minx = MAXIMUM(clip.x, x);
+   s32 bounded_miny = MAXIMUM(clip.y, y);
 
    rectangle bounds;
    get_text_bounds(&bounds, text);
 
-   s32 bounded_maxx = MINIMUM(x + bounds.width, backbuffer->width);
-   s32 bounded_maxy = MINIMUM(y + bounds.height, backbuffer->height);
+   s32 bounded_maxx = MINIMUM(x + bounds.width, clip.x + clip.width);
+   s32 bounded_maxy = MINIMUM(y + bounds.height, clip.y + clip.height);
 
    for(u32 index = 0; index < text.length; ++index)
    {
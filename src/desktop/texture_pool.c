@@ -0,0 +1,264 @@
+/* /////////////////////////////////////////////////////////////////////////// */
+/* (c) copyright 2024 Lawrence D. Kern /////////////////////////////////////// */
+/* /////////////////////////////////////////////////////////////////////////// */
+
+// NOTE: The pool tracks blocks in units of TEXTURE_POOL_MIN_BLOCK_SIZE. A block
+// of order k spans (1 << k) units, and its buddy is found by flipping bit k of
+// its unit index. Free blocks store their list links in their own memory, so
+// the only side tables are the small per-unit metadata arrays.
+
+function memindex texture_pool_order_size(u32 order)
+{
+   memindex result = TEXTURE_POOL_MIN_BLOCK_SIZE << order;
+   return(result);
+}
+
+function u32 texture_pool_order_for_size(memindex byte_count)
+{
+   u32 result = 0;
+   while(texture_pool_order_size(result) < byte_count)
+   {
+      result++;
+   }
+
+   return(result);
+}
+
+function void texture_pool_push_free(texture_pool *pool, u32 unit, u32 order)
+{
+   texture_pool_block *block = (texture_pool_block *)(pool->base + (unit * TEXTURE_POOL_MIN_BLOCK_SIZE));
+   block->prev = 0;
+   block->next = pool->free_lists[order];
+   if(block->next)
+   {
+      block->next->prev = block;
+   }
+   pool->free_lists[order] = block;
+   pool->free_counts[order]++;
+
+   pool->block_orders[unit] = (u8)order;
+   pool->block_is_free[unit] = true;
+}
+
+function void texture_pool_remove_free(texture_pool *pool, u32 unit, u32 order)
+{
+   texture_pool_block *block = (texture_pool_block *)(pool->base + (unit * TEXTURE_POOL_MIN_BLOCK_SIZE));
+   if(block->prev)
+   {
+      block->prev->next = block->next;
+   }
+   else
+   {
+      pool->free_lists[order] = block->next;
+   }
+   if(block->next)
+   {
+      block->next->prev = block->prev;
+   }
+   pool->free_counts[order]--;
+
+   pool->block_is_free[unit] = false;
+}
+
+function bool texture_pool_is_free_buddy(texture_pool *pool, u32 unit, u32 order)
+{
+   bool result = (unit < pool->block_count &&
+                  pool->block_is_free[unit] &&
+                  pool->block_orders[unit] == order);
+
+   return(result);
+}
+
+function void texture_pool_initialize(texture_pool *pool, arena *a, memindex capacity)
+{
+   // NOTE: Round the capacity down to a power-of-two number of blocks, so that
+   // the whole pool starts out as a single free block of the highest order.
+   u32 order_count = 1;
+   while(order_count < TEXTURE_POOL_ORDER_COUNT && texture_pool_order_size(order_count) <= capacity)
+   {
+      order_count++;
+   }
+
+   pool->order_count = order_count;
+   pool->capacity = texture_pool_order_size(order_count - 1);
+   pool->block_count = (u32)(pool->capacity / TEXTURE_POOL_MIN_BLOCK_SIZE);
+
+   // NOTE: Align the base to a cache line so that every block is aligned for
+   // the widest SIMD loads in the renderer.
+   pool->base = (u8 *)arena_allocate_aligned(a, pool->capacity, 64);
+
+   pool->block_orders = arena_allocate(a, u8, pool->block_count);
+   pool->block_is_free = arena_allocate(a, bool, pool->block_count);
+   pool->block_requested = arena_allocate(a, u32, pool->block_count);
+
+   assert(pool->base && pool->block_orders && pool->block_is_free && pool->block_requested);
+
+   texture_pool_push_free(pool, 0, order_count - 1);
+}
+
+function void *texture_pool_allocate(texture_pool *pool, memindex byte_count)
+{
+   void *result = 0;
+
+   u32 order = texture_pool_order_for_size(byte_count);
+   u32 available = order;
+   while(available < pool->order_count && !pool->free_lists[available])
+   {
+      available++;
+   }
+
+   if(available < pool->order_count)
+   {
+      u32 unit = (u32)(((u8 *)pool->free_lists[available] - pool->base) / TEXTURE_POOL_MIN_BLOCK_SIZE);
+      texture_pool_remove_free(pool, unit, available);
+
+      // NOTE: Split the block in half until it matches the requested order,
+      // returning the upper halves to the free lists.
+      while(available > order)
+      {
+         available--;
+         texture_pool_push_free(pool, unit + (1 << available), available);
+      }
+
+      pool->block_orders[unit] = (u8)order;
+      pool->block_requested[unit] = (u32)byte_count;
+
+      pool->used_bytes += texture_pool_order_size(order);
+      pool->requested_bytes += byte_count;
+      pool->allocation_count++;
+
+      result = pool->base + (unit * TEXTURE_POOL_MIN_BLOCK_SIZE);
+   }
+
+   return(result);
+}
+
+function void texture_pool_free(texture_pool *pool, void *memory)
+{
+   if(!memory)
+   {
+      return;
+   }
+
+   u32 unit = (u32)(((u8 *)memory - pool->base) / TEXTURE_POOL_MIN_BLOCK_SIZE);
+   assert(unit < pool->block_count && !pool->block_is_free[unit]);
+
+   u32 order = pool->block_orders[unit];
+   pool->used_bytes -= texture_pool_order_size(order);
+   pool->requested_bytes -= pool->block_requested[unit];
+   pool->allocation_count--;
+
+   // NOTE: Merge with free buddies for as long as possible.
+   while(order + 1 < pool->order_count)
+   {
+      u32 buddy = unit ^ (1 << order);
+      if(!texture_pool_is_free_buddy(pool, buddy, order))
+      {
+         break;
+      }
+
+      texture_pool_remove_free(pool, buddy, order);
+      unit = MINIMUM(unit, buddy);
+      order++;
+   }
+
+   texture_pool_push_free(pool, unit, order);
+}
+
+function void *texture_pool_reallocate(texture_pool *pool, void *memory, memindex byte_count)
+{
+   // NOTE: Resize a block, preserving its contents up to the smaller of the
+   // two sizes. Shrinking and growing into free buddies happen in place, so a
+   // block only moves when its neighborhood is occupied.
+   if(!memory)
+   {
+      return texture_pool_allocate(pool, byte_count);
+   }
+
+   u32 unit = (u32)(((u8 *)memory - pool->base) / TEXTURE_POOL_MIN_BLOCK_SIZE);
+   assert(unit < pool->block_count && !pool->block_is_free[unit]);
+
+   u32 order = pool->block_orders[unit];
+   u32 new_order = texture_pool_order_for_size(byte_count);
+
+   bool in_place = (new_order <= order);
+   if(!in_place && new_order < pool->order_count)
+   {
+      // NOTE: Growing in place requires the block to be the lower half at
+      // every order up to the new one, with each upper buddy free.
+      in_place = true;
+      for(u32 test = order; test < new_order; ++test)
+      {
+         if((unit & (1 << test)) || !texture_pool_is_free_buddy(pool, unit + (1 << test), test))
+         {
+            in_place = false;
+            break;
+         }
+      }
+
+      if(in_place)
+      {
+         for(u32 test = order; test < new_order; ++test)
+         {
+            texture_pool_remove_free(pool, unit + (1 << test), test);
+         }
+      }
+   }
+
+   if(in_place)
+   {
+      // NOTE: When shrinking, the released upper halves can't merge with
+      // anything, since their buddies are the lower halves still in use.
+      for(u32 test = order; test > new_order; --test)
+      {
+         texture_pool_push_free(pool, unit + (1 << (test - 1)), test - 1);
+      }
+
+      pool->used_bytes += texture_pool_order_size(new_order) - texture_pool_order_size(order);
+      pool->requested_bytes += byte_count - pool->block_requested[unit];
+
+      pool->block_orders[unit] = (u8)new_order;
+      pool->block_requested[unit] = (u32)byte_count;
+
+      return(memory);
+   }
+
+   void *result = texture_pool_allocate(pool, byte_count);
+   if(result)
+   {
+      memcpy(result, memory, MINIMUM(byte_count, (memindex)pool->block_requested[unit]));
+      texture_pool_free(pool, memory);
+   }
+
+   return(result);
+}
+
+function texture_pool_stats get_texture_pool_stats(texture_pool *pool)
+{
+   texture_pool_stats result = {0};
+   result.capacity = pool->capacity;
+   result.used_bytes = pool->used_bytes;
+   result.requested_bytes = pool->requested_bytes;
+   result.free_bytes = pool->capacity - pool->used_bytes;
+   result.allocation_count = pool->allocation_count;
+
+   for(u32 order = pool->order_count; order > 0; --order)
+   {
+      if(pool->free_counts[order - 1])
+      {
+         result.largest_free_bytes = texture_pool_order_size(order - 1);
+         break;
+      }
+   }
+
+   if(result.used_bytes)
+   {
+      result.internal_fragmentation = 1.0f - ((float)result.requested_bytes / (float)result.used_bytes);
+   }
+   if(result.free_bytes)
+   {
+      result.external_fragmentation = 1.0f - ((float)result.largest_free_bytes / (float)result.free_bytes);
+   }
+
+   return(result);
+}
@@ -0,0 +1,532 @@
+/* /////////////////////////////////////////////////////////////////////////// */
+/* (c) copyright 2024 Lawrence D. Kern /////////////////////////////////////// */
+/* /////////////////////////////////////////////////////////////////////////// */
+
+// NOTE: Immediate-mode widgets. A window's contents are rebuilt from scratch
+// every time its canvas is rasterized, by calling the widget functions between
+// ui_begin and ui_end:
+//
+//    ui_begin(&ui, state, canvas, &desktop->scratch_arena, input, color0, color1);
+//    if(ui_button(&ui, string8("Top")))
+//    {
+//       ...
+//    }
+//    ui_end(&ui);
+//
+// Widgets are stacked vertically within the current layout. Everything that
+// only lives for the frame (the layout stack and any formatted text) comes
+// from the arena passed to ui_begin, and is released by ui_end. Lists only
+// build the items inside their view, so their cost doesn't depend on the item
+// count.
+
+#include <stdarg.h>
+
+#define UI_HASH_SEED 0xcbf29ce484222325ULL
+#define UI_HASH_ANONYMOUS 0x100000001b3ULL
+
+#define UI_PADDING 4
+#define UI_SPACING 2
+#define UI_LABEL_HEIGHT (FONT_LEADING * FONT_SCALE)
+#define UI_BUTTON_HEIGHT ((FONT_HEIGHT * FONT_SCALE) + (2 * UI_PADDING))
+#define UI_LIST_ITEM_HEIGHT ((FONT_LEADING * FONT_SCALE) + 2)
+#define UI_SCROLLBAR_WIDTH 10
+#define UI_SCROLLBAR_MIN_THUMB 8
+#define UI_WHEEL_PIXELS (3 * UI_LIST_ITEM_HEIGHT)
+#define UI_FORMAT_MAX 128
+
+typedef struct {
+   // NOTE: Mouse coordinates are relative to the destination texture. The
+   // button and wheel fields are only set when the mouse input belongs to it.
+   s32 mousex;
+   s32 mousey;
+   bool has_mouse;
+   bool mouse_down;
+   bool mouse_pressed;
+   bool mouse_released;
+   s32 wheel_delta;
+} ui_input;
+
+typedef struct ui_layout ui_layout;
+struct ui_layout
+{
+   ui_layout *parent;
+   ui_cache_entry *entry;
+   u64 id;
+
+   // NOTE: The content area in texture coordinates. Widgets are placed at
+   // cursory below its top edge, then shifted up by the scroll offset.
+   rectangle bounds;
+   s32 cursory;
+   s32 scroll;
+};
+
+typedef struct {
+   ui_state *state;
+   texture *destination;
+   clip_stack *previous_clip;
+
+   arena *arena;
+   arena_marker marker;
+
+   ui_input input;
+   ui_layout *layout;
+   u64 hot_id;
+
+   vec4 background;
+   vec4 foreground;
+} ui_context;
+
+function u64 ui_hash_bytes(u64 hash, void *data, memindex count)
+{
+   u64 result = hash_memory(data, count, hash);
+   return(result);
+}
+
+function u64 ui_get_id(ui_context *ui, string8 label)
+{
+   // NOTE: Zero is reserved to mean no widget.
+   u64 result = ui_hash_bytes(ui->layout->id, label.data, label.length);
+   if(!result)
+   {
+      result = 1;
+   }
+
+   return(result);
+}
+
+function u64 ui_get_anonymous_id(ui_context *ui)
+{
+   // NOTE: Widgets without a label of their own, like text labels, are
+   // identified by their position in the build order.
+   u32 position = ui->state->widget_count;
+   u64 result = ui_hash_bytes(ui->layout->id ^ UI_HASH_ANONYMOUS, &position, sizeof(position));
+   if(!result)
+   {
+      result = 1;
+   }
+
+   return(result);
+}
+
+function ui_cache_entry *ui_get_entry(ui_state *state, u64 id)
+{
+   // NOTE: Look for the id among the next UI_CACHE_PROBE_MAX slots. Lookups
+   // never stop early at an empty slot, since entries may be replaced in the
+   // middle of a probe sequence. On a miss, the empty or least recently used
+   // slot in the sequence is taken over.
+   ui_cache_entry *result = 0;
+   ui_cache_entry *replace = 0;
+
+   u32 slot = (u32)id;
+   for(u32 probe = 0; probe < UI_CACHE_PROBE_MAX; ++probe)
+   {
+      ui_cache_entry *entry = state->entries + ((slot + probe) & (UI_CACHE_COUNT - 1));
+      if(entry->id == id)
+      {
+         result = entry;
+         break;
+      }
+
+      if(!replace || (replace->id && (!entry->id || entry->last_frame < replace->last_frame)))
+      {
+         replace = entry;
+      }
+   }
+
+   if(!result)
+   {
+      ui_cache_entry cleared_entry = {0};
+      result = replace;
+      *result = cleared_entry;
+      result->id = id;
+   }
+
+   result->last_frame = state->frame;
+   state->widget_count++;
+
+   return(result);
+}
+
+function ui_layout *ui_push_layout(ui_context *ui, u64 id, ui_cache_entry *entry, rectangle bounds, s32 scroll)
+{
+   ui_layout *result = arena_allocate(ui->arena, ui_layout, 1);
+   assert(result);
+
+   result->parent = ui->layout;
+   result->entry = entry;
+   result->id = id;
+   result->bounds = bounds;
+   result->cursory = 0;
+   result->scroll = scroll;
+
+   ui->layout = result;
+
+   return(result);
+}
+
+function void ui_pop_layout(ui_context *ui)
+{
+   assert(ui->layout->parent);
+   ui->layout = ui->layout->parent;
+}
+
+function s32 ui_get_remaining_height(ui_context *ui)
+{
+   ui_layout *layout = ui->layout;
+   s32 result = MAXIMUM(layout->bounds.height - layout->cursory, 0);
+
+   return(result);
+}
+
+function string8 ui_format(ui_context *ui, char *format, ...)
+{
+   string8 result = {0};
+
+   u8 *memory = arena_allocate(ui->arena, u8, UI_FORMAT_MAX);
+   if(memory)
+   {
+      va_list arguments;
+      va_start(arguments, format);
+      int length = vsnprintf((char *)memory, UI_FORMAT_MAX, format, arguments);
+      va_end(arguments);
+
+      result.data = memory;
+      result.length = (length > 0) ? MINIMUM(length, UI_FORMAT_MAX - 1) : 0;
+   }
+
+   return(result);
+}
+
+function rectangle ui_place_widget(ui_context *ui, ui_cache_entry *entry, s32 width, s32 height, string8 text)
+{
+   // NOTE: Widgets are placed relative to the layout, from its width, the
+   // vertical cursor and their own size. When none of those changed since the
+   // previous frame, the cached placement is reused rather than measured
+   // again. A width of zero fills the layout, otherwise the text is measured
+   // and padded to fit.
+   ui_state *state = ui->state;
+   ui_layout *layout = ui->layout;
+
+   s32 inputs[] = {layout->bounds.width, layout->cursory, width, height, (s32)text.length};
+   u64 key = ui_hash_bytes(UI_HASH_SEED, inputs, sizeof(inputs));
+
+   if(entry->layout_key == key)
+   {
+      state->layout_hit_count++;
+   }
+   else
+   {
+      state->layout_miss_count++;
+
+      rectangle bounds = create_rectangle(0, layout->cursory, layout->bounds.width, height);
+      if(width > 0)
+      {
+         rectangle text_bounds;
+         get_text_bounds(&text_bounds, text);
+
+         bounds.width = MINIMUM(MAXIMUM(width, text_bounds.width + (2 * UI_PADDING)), layout->bounds.width);
+      }
+
+      entry->layout_key = key;
+      entry->bounds = bounds;
+   }
+
+   layout->cursory = entry->bounds.y + entry->bounds.height + UI_SPACING;
+
+   rectangle result = entry->bounds;
+   result.x += layout->bounds.x;
+   result.y += layout->bounds.y - layout->scroll;
+
+   return(result);
+}
+
+function bool ui_is_mouse_in(ui_context *ui, rectangle bounds)
+{
+   // NOTE: Parts of a widget outside the clip can't be interacted with.
+   ui_input *input = &ui->input;
+   rectangle clip = get_clip_rectangle(ui->destination);
+
+   bool result = (input->has_mouse &&
+                  in_rectangle(bounds, input->mousex, input->mousey) &&
+                  in_rectangle(clip, input->mousex, input->mousey));
+
+   return(result);
+}
+
+function bool ui_interact(ui_context *ui, u64 id, rectangle bounds)
+{
+   // NOTE: A widget becomes active when pressed, and is clicked when the
+   // button is released over it. While a widget is active, no other widget
+   // can become hot.
+   ui_state *state = ui->state;
+   ui_input *input = &ui->input;
+
+   bool result = false;
+   bool hot = (ui_is_mouse_in(ui, bounds) && (!state->active_id || state->active_id == id));
+   if(hot)
+   {
+      ui->hot_id = id;
+   }
+
+   if(state->active_id == id)
+   {
+      if(!input->mouse_down)
+      {
+         result = hot;
+         state->active_id = 0;
+      }
+   }
+   else if(hot && input->mouse_pressed)
+   {
+      state->active_id = id;
+   }
+
+   return(result);
+}
+
+function void ui_begin(ui_context *ui, ui_state *state, texture *destination, arena *a,
+                       ui_input input, vec4 background, vec4 foreground)
+{
+   ui_context cleared_context = {0};
+   *ui = cleared_context;
+
+   ui->state = state;
+   ui->destination = destination;
+   ui->arena = a;
+   ui->marker = arena_marker_set(a);
+   ui->input = input;
+   ui->background = background;
+   ui->foreground = foreground;
+
+   state->frame++;
+   state->widget_count = 0;
+
+   // NOTE: Borrow the state's clip stack for the duration of the frame, since
+   // textures like window canvases don't have one of their own.
+   ui->previous_clip = destination->clip;
+   destination->clip = &state->clip;
+   state->clip.count = 0;
+
+   clear(destination, background);
+
+   rectangle bounds = create_rectangle(UI_PADDING, UI_PADDING,
+                                       destination->width - (2 * UI_PADDING),
+                                       destination->height - (2 * UI_PADDING));
+   ui_push_layout(ui, UI_HASH_SEED, 0, bounds, 0);
+}
+
+function void ui_end(ui_context *ui)
+{
+   ui_state *state = ui->state;
+   assert(ui->layout && !ui->layout->parent);
+
+   // NOTE: Release a widget that wasn't built this frame, so it can't hold
+   // onto the mouse after the button is let go.
+   if(!ui->input.mouse_down)
+   {
+      state->active_id = 0;
+   }
+   state->hot_id = ui->hot_id;
+
+   assert(state->clip.count == 0);
+   ui->destination->clip = ui->previous_clip;
+
+   arena_marker_restore(ui->marker);
+}
+
+function void ui_label(ui_context *ui, string8 text)
+{
+   ui_cache_entry *entry = ui_get_entry(ui->state, ui_get_anonymous_id(ui));
+   rectangle bounds = ui_place_widget(ui, entry, 1, UI_LABEL_HEIGHT, text);
+
+   push_clip(ui->destination, bounds.x, bounds.y, bounds.width, bounds.height);
+   draw_text(ui->destination, bounds.x + UI_PADDING, ALIGN_TEXT_VERTICALLY(bounds.y, bounds.height), ui->foreground, text);
+   pop_clip(ui->destination);
+}
+
+function bool ui_button(ui_context *ui, string8 label)
+{
+   u64 id = ui_get_id(ui, label);
+   ui_cache_entry *entry = ui_get_entry(ui->state, id);
+   rectangle bounds = ui_place_widget(ui, entry, 1, UI_BUTTON_HEIGHT, label);
+
+   bool result = ui_interact(ui, id, bounds);
+
+   // NOTE: Pressed buttons are drawn inverted, and hot ones get a second
+   // outline like the window buttons.
+   bool pressed = (ui->state->active_id == id && ui->hot_id == id);
+   vec4 fill = (pressed) ? ui->foreground : ui->background;
+   vec4 ink = (pressed) ? ui->background : ui->foreground;
+
+   texture *destination = ui->destination;
+   draw_rectangle(destination, bounds.x, bounds.y, bounds.width, bounds.height, fill);
+   draw_outline(destination, bounds.x, bounds.y, bounds.width, bounds.height, ui->foreground);
+   if(ui->hot_id == id)
+   {
+      draw_outline(destination, bounds.x + 1, bounds.y + 1, bounds.width - 2, bounds.height - 2, ui->foreground);
+   }
+
+   push_clip(destination, bounds.x + 2, bounds.y + 2, bounds.width - 4, bounds.height - 4);
+   draw_text(destination, bounds.x + UI_PADDING, ALIGN_TEXT_VERTICALLY(bounds.y, bounds.height), ink, label);
+   pop_clip(destination);
+
+   return(result);
+}
+
+function void ui_begin_scroll(ui_context *ui, u64 id, s32 height, s32 content_height)
+{
+   // NOTE: Scroll areas with a known content height pass it in, otherwise
+   // the height measured on the previous frame is used. Input is handled
+   // before the contents are built, so they're placed with this frame's
+   // scroll offset.
+   ui_state *state = ui->state;
+   ui_input *input = &ui->input;
+   texture *destination = ui->destination;
+
+   ui_cache_entry *entry = ui_get_entry(state, id);
+   rectangle bounds = ui_place_widget(ui, entry, 0, height, string8(""));
+   if(content_height >= 0)
+   {
+      entry->content_height = content_height;
+   }
+
+   rectangle view = resize_rectangle(bounds, -1);
+   view.width = MAXIMUM(view.width - UI_SCROLLBAR_WIDTH, 0);
+
+   rectangle track = create_rectangle(view.x + view.width, view.y, UI_SCROLLBAR_WIDTH, view.height);
+
+   s32 max_scroll = MAXIMUM(entry->content_height - view.height, 0);
+   s32 thumb_height = track.height;
+   if(max_scroll)
+   {
+      thumb_height = (s32)(((s64)track.height * view.height) / entry->content_height);
+      thumb_height = MINIMUM(MAXIMUM(thumb_height, UI_SCROLLBAR_MIN_THUMB), track.height);
+   }
+   s32 travel = track.height - thumb_height;
+
+   if(input->wheel_delta && ui_is_mouse_in(ui, bounds))
+   {
+      entry->scroll -= input->wheel_delta * UI_WHEEL_PIXELS;
+   }
+
+   // NOTE: Pressing the track outside the thumb centers the thumb on the
+   // mouse, after which it's dragged the same way as the thumb itself.
+   u64 thumb_id = ui_hash_bytes(id, "#thumb", 6);
+   if(state->active_id == thumb_id)
+   {
+      if(!input->mouse_down)
+      {
+         state->active_id = 0;
+      }
+   }
+   else if(!state->active_id && input->mouse_pressed && travel > 0 && ui_is_mouse_in(ui, track))
+   {
+      s32 thumby = track.y + (s32)(((s64)MINIMUM(MAXIMUM(entry->scroll, 0), max_scroll) * travel) / max_scroll);
+      bool on_thumb = (input->mousey >= thumby && input->mousey < thumby + thumb_height);
+
+      state->active_id = thumb_id;
+      state->drag_offset = (on_thumb) ? (input->mousey - thumby) : (thumb_height / 2);
+   }
+
+   if(state->active_id == thumb_id && travel > 0)
+   {
+      s32 position = input->mousey - state->drag_offset - track.y;
+      entry->scroll = (s32)(((s64)position * max_scroll) / travel);
+      ui->hot_id = thumb_id;
+   }
+
+   entry->scroll = MINIMUM(MAXIMUM(entry->scroll, 0), max_scroll);
+
+   draw_outline(destination, bounds.x, bounds.y, bounds.width, bounds.height, ui->foreground);
+   draw_rectangle(destination, track.x, track.y, 1, track.height, ui->foreground);
+   if(max_scroll)
+   {
+      s32 thumby = track.y + (s32)(((s64)entry->scroll * travel) / max_scroll);
+      draw_rectangle(destination, track.x + 2, thumby + 1, track.width - 3, thumb_height - 2, ui->foreground);
+   }
+
+   push_clip(destination, view.x, view.y, view.width, view.height);
+   ui_push_layout(ui, id, entry, view, entry->scroll);
+}
+
+function void ui_end_scroll(ui_context *ui)
+{
+   pop_clip(ui->destination);
+   ui_pop_layout(ui);
+}
+
+function void ui_begin_scroll_area(ui_context *ui, string8 label, s32 height)
+{
+   ui_begin_scroll(ui, ui_get_id(ui, label), height, -1);
+}
+
+function void ui_end_scroll_area(ui_context *ui)
+{
+   ui_layout *layout = ui->layout;
+   layout->entry->content_height = MAXIMUM(layout->cursory - UI_SPACING, 0);
+
+   ui_end_scroll(ui);
+}
+
+function void ui_set_scroll(ui_context *ui, string8 label, s32 scroll)
+{
+   // NOTE: Takes effect the next time the scroll area or list with this label
+   // is built, where it's clamped to the content.
+   ui_cache_entry *entry = ui_get_entry(ui->state, ui_get_id(ui, label));
+   entry->scroll = scroll;
+}
+
+function void ui_begin_list(ui_context *ui, string8 label, u32 item_count, s32 height, u32 *first, u32 *last)
+{
+   // NOTE: Every item has the same height, so the content height and the
+   // range of visible items follow directly from the scroll offset. Only the
+   // items in [first, last) need to be built.
+   s32 content_height = (s32)MINIMUM((s64)item_count * UI_LIST_ITEM_HEIGHT, 0x7fffffff);
+   ui_begin_scroll(ui, ui_get_id(ui, label), height, content_height);
+
+   ui_layout *layout = ui->layout;
+   s32 bottom = layout->scroll + layout->bounds.height;
+
+   *first = MINIMUM((u32)(layout->scroll / UI_LIST_ITEM_HEIGHT), item_count);
+   *last = MINIMUM((u32)((bottom + UI_LIST_ITEM_HEIGHT - 1) / UI_LIST_ITEM_HEIGHT), item_count);
+}
+
+function bool ui_list_item(ui_context *ui, u32 index, string8 text, s32 *selected)
+{
+   // NOTE: Items are positioned by index rather than through the layout
+   // cursor, and don't take up cache entries.
+   ui_layout *layout = ui->layout;
+   texture *destination = ui->destination;
+
+   rectangle bounds = create_rectangle(layout->bounds.x,
+                                       layout->bounds.y + (s32)(index * UI_LIST_ITEM_HEIGHT) - layout->scroll,
+                                       layout->bounds.width, UI_LIST_ITEM_HEIGHT);
+
+   u64 id = ui_hash_bytes(layout->id, &index, sizeof(index));
+   bool result = ui_interact(ui, id, bounds);
+   if(result)
+   {
+      *selected = (s32)index;
+   }
+
+   bool highlight = (*selected == (s32)index || (ui->state->active_id == id && ui->hot_id == id));
+   vec4 ink = ui->foreground;
+   if(highlight)
+   {
+      draw_rectangle(destination, bounds.x, bounds.y, bounds.width, bounds.height, ui->foreground);
+      ink = ui->background;
+   }
+   else if(ui->hot_id == id)
+   {
+      draw_outline(destination, bounds.x, bounds.y, bounds.width, bounds.height, ui->foreground);
+   }
+
+   draw_text(destination, bounds.x + UI_PADDING, ALIGN_TEXT_VERTICALLY(bounds.y, bounds.height), ink, text);
+
+   return(result);
+}
+
+function void ui_end_list(ui_context *ui)
+{
+   ui_end_scroll(ui);
+}
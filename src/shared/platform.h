@@ -11,7 +11,498 @@
 #define PLATFORM_SAVE_FILE(name) b32 name(void *memory, size s, char *path)
 #define PLATFORM_LOG(name) void name(char *format, ...)
 
+// NOTE: Leveled logging. Messages below PLATFORM_LOG_LEVEL are compiled out
+// entirely, arguments included. platform_log writes at the info level, so it
+// stays silent in release builds. Output may be buffered, so flush before
+// anything that could end the process abnormally.
+#define LOG_LEVEL_DEBUG   0
+#define LOG_LEVEL_INFO    1
+#define LOG_LEVEL_WARNING 2
+#define LOG_LEVEL_ERROR   3
+#define LOG_LEVEL_NONE    4
+
+#if !defined(PLATFORM_LOG_LEVEL)
+#   if DEVELOPMENT_BUILD
+#      define PLATFORM_LOG_LEVEL LOG_LEVEL_DEBUG
+#   else
+#      define PLATFORM_LOG_LEVEL LOG_LEVEL_WARNING
+#   endif
+#endif
+
+#define PLATFORM_LOG_MESSAGE(name) void name(u32 level, char *format, ...)
+#define PLATFORM_FLUSH_LOG(name) void name(void)
+
+#define log_message(level, ...) do { if((level) >= PLATFORM_LOG_LEVEL) { platform_log_message((level), __VA_ARGS__); } } while(0)
+#define log_debug(...)   log_message(LOG_LEVEL_DEBUG,   __VA_ARGS__)
+#define log_info(...)    log_message(LOG_LEVEL_INFO,    __VA_ARGS__)
+#define log_warning(...) log_message(LOG_LEVEL_WARNING, __VA_ARGS__)
+#define log_error(...)   log_message(LOG_LEVEL_ERROR,   __VA_ARGS__)
+
+// NOTE: Virtual memory. Reserved address space is inaccessible until it's
+// committed, and decommitting returns the physical pages while keeping the
+// range reserved. Addresses and sizes passed to commit and decommit must be
+// multiples of the page size.
+#define PLATFORM_RESERVE(name) void *name(size s)
+#define PLATFORM_COMMIT(name) b32 name(void *address, size s)
+#define PLATFORM_DECOMMIT(name) void name(void *address, size s)
+
+// NOTE: Read-only file views. The contents are always followed by a zero byte,
+// so they can be scanned as a C string. Files that can't be mapped are read
+// into the arena instead, in which case mapping is null and unmapping is a
+// no-op. The contents must not be written to.
+typedef struct {
+   string8 contents;
+   void *mapping;
+   size mapping_size;
+} mapped_file;
+
+#define PLATFORM_MAP_FILE(name) mapped_file name(arena *a, char *path)
+#define PLATFORM_UNMAP_FILE(name) void name(mapped_file *file)
+
+// NOTE: Asynchronous file I/O. Loads and saves are queued on a batch, submitted
+// together, and then polled until they finish. Files are opened and load
+// buffers are allocated from the batch's arena on submission, so only the data
+// transfers happen in the background. Loaded contents are followed by a zero
+// byte, like mapped files.
+//
+// Request statuses only change inside platform_poll_io, which returns the
+// number of requests still in flight. Passing wait blocks until at least one
+// more request finishes. Once none are left, the batch can be reused.
+//
+//    platform_io_batch batch = {&arena};
+//    u32 index = queue_file_load(&batch, "a.txt");
+//    platform_submit_io(&batch);
+//    ...
+//    platform_io_request *request = wait_for_io(&batch, index);
+#define PLATFORM_IO_BATCH_COUNT 64
+
+typedef enum {
+   PLATFORM_IO_LOAD,
+   PLATFORM_IO_SAVE,
+} platform_io_type;
+
+typedef enum {
+   PLATFORM_IO_QUEUED,
+   PLATFORM_IO_PENDING,
+   PLATFORM_IO_COMPLETE,
+   PLATFORM_IO_FAILED,
+} platform_io_status;
+
+typedef struct {
+   platform_io_type type;
+   platform_io_status status;
+   char *path;
+
+   // NOTE: The data to save, or the loaded data once a load completes.
+   string8 contents;
+
+   // NOTE: Platform bookkeeping while the request is in flight.
+   intptr_t handle;
+   size transferred;
+} platform_io_request;
+
+typedef struct {
+   arena *a;
+   void *platform;
+
+   u32 count;
+   u32 outstanding;
+   platform_io_request requests[PLATFORM_IO_BATCH_COUNT];
+} platform_io_batch;
+
+#define PLATFORM_SUBMIT_IO(name) b32 name(platform_io_batch *batch)
+#define PLATFORM_POLL_IO(name) u32 name(platform_io_batch *batch, b32 wait)
+
+// NOTE: Jobs. A fixed pool of worker threads, one for each core besides the
+// calling thread, runs jobs pulled from per-thread work-stealing deques.
+// Running a group of jobs adds their count to a counter that each job
+// decrements when it finishes, so a counter reaching zero means the whole group
+// is done. Waiting on a counter runs other queued jobs in the meantime, which
+// lets jobs run and wait on jobs of their own, and lets a job that depends on
+// another group simply wait for its counter first. The jobs themselves must
+// stay valid until their counter reaches zero.
+//
+//    job_counter counter = {0};
+//    platform_run_jobs(jobs, countof(jobs), &counter);
+//    ...
+//    platform_wait_for_counter(&counter);
+typedef void job_function(void *data);
+
+typedef struct {
+   s32 value;
+} job_counter;
+
+typedef struct {
+   job_function *procedure;
+   void *data;
+   job_counter *counter;
+} job;
+
+#define PLATFORM_RUN_JOBS(name) void name(job *jobs, u32 count, job_counter *counter)
+#define PLATFORM_WAIT_FOR_COUNTER(name) void name(job_counter *counter)
+#define PLATFORM_GET_THREAD_COUNT(name) u32 name(void)
+
+// NOTE: Timing. platform_time_ns reads a monotonic clock in nanoseconds. For
+// finer, cheaper measurements, read_cpu_timer reads the CPU timestamp counter
+// directly, and get_cpu_timer_frequency converts its ticks to seconds.
+//
+// Hardware counters are read for the calling thread, which starts counting the
+// first time it reads them. The values are raw counts, together with how long
+// the counters were enabled and how long they were actually running, which
+// differ when the hardware is shared and the counts have to be extrapolated.
+// Only differences between two reads are meaningful, so subtract_counters is
+// used to get them. Counters the kernel or hardware won't provide are left out
+// of available, and on platforms without them none are available at all.
+typedef enum {
+   PLATFORM_COUNTER_CYCLES,
+   PLATFORM_COUNTER_INSTRUCTIONS,
+   PLATFORM_COUNTER_CACHE_MISSES,
+   PLATFORM_COUNTER_BRANCH_MISSES,
+   PLATFORM_COUNTER_COUNT,
+} platform_counter_type;
+
+typedef struct {
+   u32 available;
+   u64 values[PLATFORM_COUNTER_COUNT];
+   u64 time_enabled;
+   u64 time_running;
+} platform_counters;
+
+#define PLATFORM_TIME_NS(name) u64 name(void)
+#define PLATFORM_READ_COUNTERS(name) b32 name(platform_counters *counters)
+
 PLATFORM_ALLOCATE(platform_allocate);
 PLATFORM_LOAD_FILE(platform_load_file);
 PLATFORM_SAVE_FILE(platform_save_file);
 PLATFORM_LOG(platform_log);
+PLATFORM_LOG_MESSAGE(platform_log_message);
+PLATFORM_FLUSH_LOG(platform_flush_log);
+PLATFORM_RESERVE(platform_reserve);
+PLATFORM_COMMIT(platform_commit);
+PLATFORM_DECOMMIT(platform_decommit);
+PLATFORM_MAP_FILE(platform_map_file);
+PLATFORM_UNMAP_FILE(platform_unmap_file);
+PLATFORM_SUBMIT_IO(platform_submit_io);
+PLATFORM_POLL_IO(platform_poll_io);
+PLATFORM_RUN_JOBS(platform_run_jobs);
+PLATFORM_WAIT_FOR_COUNTER(platform_wait_for_counter);
+PLATFORM_GET_THREAD_COUNT(platform_get_thread_count);
+PLATFORM_TIME_NS(platform_time_ns);
+PLATFORM_READ_COUNTERS(platform_read_counters);
+
+#if defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+#   include <intrin.h>
+#   define CPU_TIMER_IS_TSC 1
+#   define read_cpu_timer() __rdtsc()
+#elif defined(__x86_64__) || defined(__i386__)
+#   include <x86intrin.h>
+#   define CPU_TIMER_IS_TSC 1
+#   define read_cpu_timer() __rdtsc()
+#elif defined(__aarch64__)
+// NOTE: The generic timer ticks at a fixed frequency unrelated to the core
+// clock, so it isn't a cycle count. Its frequency is readable directly.
+#   define CPU_TIMER_IS_TSC 0
+function u64 read_cpu_timer(void)
+{
+   u64 result;
+   __asm__ volatile("mrs %0, cntvct_el0" : "=r"(result));
+   return(result);
+}
+#else
+#   define CPU_TIMER_IS_TSC 0
+#   define read_cpu_timer() platform_time_ns()
+#endif
+
+#define CPU_TIMER_CALIBRATION_NS 10000000
+
+global u64 cpu_timer_frequency;
+
+function u64 get_cpu_timer_frequency(void)
+{
+   // NOTE: The timestamp counter ticks at a constant rate on any processor
+   // recent enough to matter, but there's no portable way to ask what that
+   // rate is. Measure it against the monotonic clock the first time instead.
+   if(!cpu_timer_frequency)
+   {
+#if CPU_TIMER_IS_TSC
+      u64 begin_ns = platform_time_ns();
+      u64 begin = read_cpu_timer();
+
+      u64 end_ns = begin_ns;
+      while(end_ns - begin_ns < CPU_TIMER_CALIBRATION_NS)
+      {
+         end_ns = platform_time_ns();
+      }
+      u64 end = read_cpu_timer();
+
+      cpu_timer_frequency = (u64)((double)(end - begin) * 1e9 / (double)(end_ns - begin_ns));
+#elif defined(__aarch64__)
+      __asm__ volatile("mrs %0, cntfrq_el0" : "=r"(cpu_timer_frequency));
+#else
+      cpu_timer_frequency = 1000000000;
+#endif
+   }
+
+   return(cpu_timer_frequency);
+}
+
+function b32 arena_reserve(arena *a, size cap)
+{
+   // NOTE: Initialize a growable arena over cap bytes of reserved address
+   // space. Nothing is committed until the first allocation. In development
+   // builds, the reservation is padded by a chunk on each side that is never
+   // committed, so running off either end of the arena faults immediately.
+#if DEVELOPMENT_BUILD
+   size guard = ARENA_COMMIT_CHUNK;
+#else
+   size guard = 0;
+#endif
+
+   cap = (cap + ARENA_COMMIT_CHUNK - 1) & ~(ARENA_COMMIT_CHUNK - 1);
+
+   b32 result = false;
+   u8 *memory = (u8 *)platform_reserve(cap + (2 * guard));
+   if(memory)
+   {
+      arena_initialize(a, memory + guard, cap);
+      a->committed = 0;
+      a->commit = platform_commit;
+      a->decommit = platform_decommit;
+
+      result = true;
+   }
+
+   return(result);
+}
+
+function u32 queue_file_io(platform_io_batch *batch, platform_io_type type, char *path, string8 contents)
+{
+   assert(batch->count < PLATFORM_IO_BATCH_COUNT);
+
+   u32 result = batch->count++;
+   platform_io_request *request = batch->requests + result;
+   request->type = type;
+   request->status = PLATFORM_IO_QUEUED;
+   request->path = path;
+   request->contents = contents;
+   request->handle = -1;
+   request->transferred = 0;
+
+   return(result);
+}
+
+function u32 queue_file_load(platform_io_batch *batch, char *path)
+{
+   u32 result = queue_file_io(batch, PLATFORM_IO_LOAD, path, string8(""));
+   return(result);
+}
+
+function u32 queue_file_save(platform_io_batch *batch, char *path, void *memory, size s)
+{
+   u32 result = queue_file_io(batch, PLATFORM_IO_SAVE, path, string8new((u8 *)memory, s));
+   return(result);
+}
+
+function platform_io_request *wait_for_io(platform_io_batch *batch, u32 index)
+{
+   platform_io_request *result = batch->requests + index;
+   while(result->status == PLATFORM_IO_PENDING)
+   {
+      platform_poll_io(batch, true);
+   }
+
+   return(result);
+}
+
+// NOTE: Every thread gets its own scratch arenas for temporary allocations,
+// reserved the first time the thread asks for one. A function that allocates
+// its results from an arena passed in by the caller should pass that arena as
+// the conflict, so that it's handed a different scratch arena and its temporary
+// allocations can't be interleaved with the results.
+//
+//    arena_marker scratch = scratch_begin(a);
+//    ...
+//    scratch_end(scratch);
+#define SCRATCH_ARENA_COUNT 2
+#define SCRATCH_ARENA_SIZE GIGABYTES(1)
+
+global THREAD_LOCAL arena scratch_arenas[SCRATCH_ARENA_COUNT];
+
+function arena_marker scratch_begin(arena *conflict)
+{
+   arena *scratch = scratch_arenas + ((conflict == scratch_arenas) ? 1 : 0);
+   if(!scratch->base)
+   {
+      b32 reserved = arena_reserve(scratch, SCRATCH_ARENA_SIZE);
+      assert(reserved);
+   }
+
+   arena_marker result = arena_marker_set(scratch);
+   return(result);
+}
+
+function void scratch_end(arena_marker marker)
+{
+   arena_marker_restore(marker);
+}
+
+// NOTE: Split the range [0, count) into batches of batch indices and run the
+// procedure over each of them as a job, returning once all of them are done.
+// A batch of zero picks one that gives every thread a few batches to balance
+// the load with.
+typedef void parallel_for_function(void *data, size first, size last);
+
+typedef struct {
+   parallel_for_function *procedure;
+   void *data;
+   size first;
+   size last;
+} parallel_for_range;
+
+function void run_parallel_for_range(void *data)
+{
+   parallel_for_range *range = (parallel_for_range *)data;
+   range->procedure(range->data, range->first, range->last);
+}
+
+function void parallel_for(size count, size batch, parallel_for_function *procedure, void *data)
+{
+   if(batch <= 0)
+   {
+      batch = MAXIMUM(1, count / (platform_get_thread_count() * 4));
+   }
+
+   size job_count = (count + batch - 1) / batch;
+   if(job_count == 1)
+   {
+      procedure(data, 0, count);
+   }
+   else if(job_count > 1)
+   {
+      arena_marker scratch = scratch_begin(0);
+
+      job *jobs = arena_allocate(scratch.a, job, job_count);
+      parallel_for_range *ranges = arena_allocate(scratch.a, parallel_for_range, job_count);
+      for(size index = 0; index < job_count; ++index)
+      {
+         parallel_for_range *range = ranges + index;
+         range->procedure = procedure;
+         range->data = data;
+         range->first = index * batch;
+         range->last = MINIMUM(range->first + batch, count);
+
+         jobs[index].procedure = run_parallel_for_range;
+         jobs[index].data = range;
+      }
+
+      job_counter counter = {0};
+      platform_run_jobs(jobs, (u32)job_count, &counter);
+      platform_wait_for_counter(&counter);
+
+      scratch_end(scratch);
+   }
+}
+
+// NOTE: A snapshot of the clock, timestamp counter, and hardware counters.
+// Subtracting one from another accumulates what happened in between, so a
+// phase that runs several times can be totalled across all of them.
+//
+//    performance_sample total = {0};
+//    performance_sample begin = sample_performance();
+//    ...
+//    accumulate_performance(&total, begin, sample_performance());
+typedef struct {
+   u64 nanoseconds;
+   u64 cpu_timer;
+   platform_counters counters;
+   u32 interval_count;
+} performance_sample;
+
+function performance_sample sample_performance(void)
+{
+   performance_sample result;
+   platform_read_counters(&result.counters);
+   result.cpu_timer = read_cpu_timer();
+   result.nanoseconds = platform_time_ns();
+   result.interval_count = 0;
+
+   return(result);
+}
+
+function void subtract_counters(platform_counters *result, platform_counters *begin, platform_counters *end)
+{
+   // NOTE: The raw counts are subtracted before anything is extrapolated.
+   // Scaling each read by its own running fraction first could make a later
+   // read smaller than an earlier one. Instead, the difference is scaled by the
+   // fraction of the interval itself that the counters were running, and
+   // counters that never ran during it are left out.
+   u64 enabled = end->time_enabled - begin->time_enabled;
+   u64 running = end->time_running - begin->time_running;
+   double scale = (running && running < enabled) ? (double)enabled / (double)running : 1.0;
+
+   result->available = begin->available & end->available;
+   if(enabled && !running)
+   {
+      result->available = 0;
+   }
+
+   for(u32 index = 0; index < PLATFORM_COUNTER_COUNT; ++index)
+   {
+      u64 count = end->values[index] - begin->values[index];
+      result->values[index] = (result->available & (1 << index)) ? (u64)((double)count * scale) : 0;
+   }
+   result->time_enabled = enabled;
+   result->time_running = running;
+}
+
+function void accumulate_performance(performance_sample *total, performance_sample begin, performance_sample end)
+{
+   total->nanoseconds += end.nanoseconds - begin.nanoseconds;
+   total->cpu_timer += end.cpu_timer - begin.cpu_timer;
+
+   platform_counters difference;
+   subtract_counters(&difference, &begin.counters, &end.counters);
+
+   // NOTE: A counter only means something in the total if it was read for
+   // every interval that went into it.
+   if(total->interval_count == 0)
+   {
+      total->counters.available = (1 << PLATFORM_COUNTER_COUNT) - 1;
+   }
+   total->counters.available &= difference.available;
+   ++total->interval_count;
+
+   for(u32 index = 0; index < PLATFORM_COUNTER_COUNT; ++index)
+   {
+      total->counters.values[index] += difference.values[index];
+   }
+   total->counters.time_enabled += difference.time_enabled;
+   total->counters.time_running += difference.time_running;
+}
+
+function void log_arena_statistics(char *name, arena *a)
+{
+   platform_log("ARENA %-8s %10td bytes high water, %8td allocations, %6td bytes padding\n",
+                name, a->high_water, a->allocation_count, a->padding);
+}
+
+function void log_performance_statistics(char *name, performance_sample *total)
+{
+   u64 *values = total->counters.values;
+   u32 all = (1 << PLATFORM_COUNTER_COUNT) - 1;
+   if(total->counters.available == all)
+   {
+      double ipc = (values[PLATFORM_COUNTER_CYCLES]) ? (double)values[PLATFORM_COUNTER_INSTRUCTIONS] / (double)values[PLATFORM_COUNTER_CYCLES] : 0.0;
+      platform_log("PHASE %-8s %10.3f ms, %12llu cycles, %12llu instructions, %5.2f IPC, %10llu cache misses, %10llu branch misses\n",
+                   name, (double)total->nanoseconds / 1e6,
+                   (unsigned long long)values[PLATFORM_COUNTER_CYCLES],
+                   (unsigned long long)values[PLATFORM_COUNTER_INSTRUCTIONS], ipc,
+                   (unsigned long long)values[PLATFORM_COUNTER_CACHE_MISSES],
+                   (unsigned long long)values[PLATFORM_COUNTER_BRANCH_MISSES]);
+   }
+   else
+   {
+      platform_log("PHASE %-8s %10.3f ms, %12llu timer ticks\n",
+                   name, (double)total->nanoseconds / 1e6, (unsigned long long)total->cpu_timer);
+   }
+}
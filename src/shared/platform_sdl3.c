@@ -3,9 +3,24 @@
 #include "SDL3/SDL.h"
 #include "platform.h"
 
+// NOTE: SDL has no virtual memory API, so arenas use the OS primitives directly
+// where there are any. Elsewhere, reservations are allocated up front, which
+// only works for bounded sizes.
+#if defined(_WIN32)
+#   define SDL_VIRTUAL_MEMORY 1
+#   include <windows.h>
+#elif defined(__unix__) || defined(__APPLE__)
+#   define SDL_VIRTUAL_MEMORY 1
+#   include <errno.h>
+#   include <sys/mman.h>
+#else
+#   define SDL_VIRTUAL_MEMORY 0
+#   define SDL_RESERVE_MAXIMUM MEGABYTES(256)
+#endif
+
 PLATFORM_LOG(platform_log)
 {
-#if DEVELOPMENT_BUILD
+#if PLATFORM_LOG_LEVEL <= LOG_LEVEL_INFO
    va_list arguments;
    va_start(arguments, format);
    {
@@ -17,12 +32,99 @@ PLATFORM_LOG(platform_log)
 #endif
 }
 
+PLATFORM_LOG_MESSAGE(platform_log_message)
+{
+   SDL_LogPriority priorities[] =
+   {
+      SDL_LOG_PRIORITY_DEBUG,
+      SDL_LOG_PRIORITY_INFO,
+      SDL_LOG_PRIORITY_WARN,
+      SDL_LOG_PRIORITY_ERROR,
+   };
+   SDL_LogPriority priority = priorities[MINIMUM(level, countof(priorities) - 1)];
+
+   va_list arguments;
+   va_start(arguments, format);
+   {
+      SDL_LogMessageV(SDL_LOG_CATEGORY_APPLICATION, priority, format, arguments);
+   }
+   va_end(arguments);
+}
+
+PLATFORM_FLUSH_LOG(platform_flush_log)
+{
+   // NOTE: SDL logs synchronously, so there's nothing to flush.
+}
+
 PLATFORM_ALLOCATE(platform_allocate)
 {
    void *result = SDL_calloc(1, s);
    return(result);
 }
 
+PLATFORM_RESERVE(platform_reserve)
+{
+#if defined(_WIN32)
+   void *result = VirtualAlloc(0, s, MEM_RESERVE, PAGE_NOACCESS);
+   if(!result)
+   {
+      log_error("ERROR (%lu): Failed to reserve %td bytes of address space.\n", GetLastError(), s);
+   }
+#elif SDL_VIRTUAL_MEMORY
+   void *result = mmap(0, s, PROT_NONE, MAP_ANONYMOUS|MAP_PRIVATE|MAP_NORESERVE, -1, 0);
+   if(result == MAP_FAILED)
+   {
+      log_error("ERROR (%d): Failed to reserve %td bytes of address space.\n", errno, s);
+      result = 0;
+   }
+#else
+   // NOTE: Without virtual memory the whole range is allocated and zeroed now,
+   // so arenas larger than SDL_RESERVE_MAXIMUM are refused outright.
+   void *result = 0;
+   if(s <= SDL_RESERVE_MAXIMUM)
+   {
+      result = SDL_calloc(1, s);
+   }
+   if(!result)
+   {
+      log_error("ERROR: Failed to reserve %td bytes, which this platform has to allocate up front.\n", s);
+   }
+#endif
+
+   return(result);
+}
+
+PLATFORM_COMMIT(platform_commit)
+{
+#if defined(_WIN32)
+   b32 result = (VirtualAlloc(address, s, MEM_COMMIT, PAGE_READWRITE) != 0);
+#elif SDL_VIRTUAL_MEMORY
+   b32 result = (mprotect(address, s, PROT_READ|PROT_WRITE) == 0);
+#else
+   b32 result = true;
+#endif
+   if(!result)
+   {
+      log_error("ERROR: Failed to commit %td bytes of memory.\n", s);
+   }
+
+   return(result);
+}
+
+PLATFORM_DECOMMIT(platform_decommit)
+{
+   // NOTE: Recommitting a range hands back zeroed memory, like a fresh commit.
+#if defined(_WIN32)
+   VirtualFree(address, s, MEM_DECOMMIT);
+#elif SDL_VIRTUAL_MEMORY
+   // NOTE: MADV_DONTNEED only zeroes pages on Linux, so the range is mapped
+   // over with fresh pages instead, which works on any Unix.
+   mmap(address, s, PROT_NONE, MAP_FIXED|MAP_ANONYMOUS|MAP_PRIVATE|MAP_NORESERVE, -1, 0);
+#else
+   zero_memory(address, s);
+#endif
+}
+
 PLATFORM_LOAD_FILE(platform_load_file)
 {
    string8 result = string8("");
@@ -37,19 +139,389 @@ PLATFORM_LOAD_FILE(platform_load_file)
    }
    else
    {
-      platform_log("ERROR: Failed to read file \"%s\".\n", path);
+      log_error("ERROR: Failed to read file \"%s\".\n", path);
    }
 
    return(result);
 }
 
+// NOTE: SDL can't map files, so they're always read. SDL_LoadFile already
+// appends the zero byte. Its buffer is kept as the mapping so that unmapping
+// can free it.
+PLATFORM_MAP_FILE(platform_map_file)
+{
+   (void)a;
+
+   mapped_file result = {0};
+   result.contents = string8("");
+
+   size_t length = 0;
+   void *data = SDL_LoadFile(path, &length);
+   if(data)
+   {
+      result.contents.data = data;
+      result.contents.length = length;
+      result.mapping = data;
+      result.mapping_size = length + 1;
+   }
+   else
+   {
+      log_error("ERROR: Failed to read file \"%s\".\n", path);
+   }
+
+   return(result);
+}
+
+PLATFORM_UNMAP_FILE(platform_unmap_file)
+{
+   SDL_free(file->mapping);
+
+   mapped_file cleared = {0};
+   *file = cleared;
+}
+
 PLATFORM_SAVE_FILE(platform_save_file)
 {
    bool result = SDL_SaveFile(path, memory, s);
    if(!result)
    {
-      platform_log("ERROR: Failed to save file: \"%s\".\n", path);
+      log_error("ERROR: Failed to save file: \"%s\".\n", path);
+   }
+
+   return(result);
+}
+
+// NOTE: Asynchronous I/O goes through SDL's async I/O queues. SDL allocates
+// load buffers itself, so completed loads are copied into the batch's arena.
+// Saves are closed (and flushed) once their write lands, and only count as
+// finished when the close does.
+function void end_file_io(platform_io_batch *batch, platform_io_request *request, b32 success)
+{
+   if(!success)
+   {
+      log_error("ERROR: Failed to %s file \"%s\".\n", (request->type == PLATFORM_IO_LOAD) ? "read" : "write", request->path);
+   }
+
+   request->status = success ? PLATFORM_IO_COMPLETE : PLATFORM_IO_FAILED;
+   batch->outstanding--;
+}
+
+function void finish_async_task(platform_io_batch *batch, SDL_AsyncIOOutcome *outcome)
+{
+   SDL_AsyncIOQueue *queue = (SDL_AsyncIOQueue *)batch->platform;
+
+   // NOTE: Closes of files whose write never started aren't tied to a request.
+   u32 index = (u32)(uintptr_t)outcome->userdata;
+   if(index >= PLATFORM_IO_BATCH_COUNT)
+   {
+      return;
+   }
+
+   platform_io_request *request = batch->requests + index;
+   b32 success = (outcome->result == SDL_ASYNCIO_COMPLETE);
+
+   if(outcome->type == SDL_ASYNCIO_TASK_READ)
+   {
+      if(success)
+      {
+         size length = (size)outcome->bytes_transferred;
+         u8 *data = arena_allocate(batch->a, u8, length + 1);
+         if(data)
+         {
+            SDL_memcpy(data, outcome->buffer, length);
+            data[length] = 0;
+            request->contents = string8new(data, length);
+         }
+         success = (data != 0);
+      }
+      SDL_free(outcome->buffer);
+
+      end_file_io(batch, request, success);
+   }
+   else if(outcome->type == SDL_ASYNCIO_TASK_WRITE)
+   {
+      SDL_AsyncIO *file = (SDL_AsyncIO *)request->handle;
+      request->transferred = (size)outcome->bytes_transferred;
+      if(!SDL_CloseAsyncIO(file, success, queue, outcome->userdata))
+      {
+         end_file_io(batch, request, false);
+      }
+      else if(!success)
+      {
+         // NOTE: The file is still closed, but the request already failed.
+         request->handle = 0;
+      }
+   }
+   else
+   {
+      b32 wrote = (request->handle != 0);
+      request->handle = 0;
+      end_file_io(batch, request, success && wrote);
    }
+}
+
+PLATFORM_SUBMIT_IO(platform_submit_io)
+{
+   assert(!batch->platform);
+
+   SDL_AsyncIOQueue *queue = SDL_CreateAsyncIOQueue();
+   if(!queue)
+   {
+      return(false);
+   }
+   batch->platform = queue;
+
+   for(u32 index = 0; index < batch->count; ++index)
+   {
+      platform_io_request *request = batch->requests + index;
+      if(request->status != PLATFORM_IO_QUEUED)
+      {
+         continue;
+      }
+
+      void *userdata = (void *)(uintptr_t)index;
+      b32 started = false;
+      if(request->type == PLATFORM_IO_LOAD)
+      {
+         started = SDL_LoadFileAsync(request->path, queue, userdata);
+      }
+      else
+      {
+         SDL_AsyncIO *file = SDL_AsyncIOFromFile(request->path, "w");
+         if(file)
+         {
+            request->handle = (intptr_t)file;
+            started = SDL_WriteAsyncIO(file, request->contents.data, 0, request->contents.length, queue, userdata);
+            if(!started)
+            {
+               SDL_CloseAsyncIO(file, false, queue, (void *)(uintptr_t)PLATFORM_IO_BATCH_COUNT);
+            }
+         }
+      }
+
+      if(started)
+      {
+         request->status = PLATFORM_IO_PENDING;
+         batch->outstanding++;
+      }
+      else
+      {
+         log_error("ERROR: Failed to open file \"%s\".\n", request->path);
+         request->status = PLATFORM_IO_FAILED;
+      }
+   }
+
+   return(true);
+}
+
+PLATFORM_POLL_IO(platform_poll_io)
+{
+   SDL_AsyncIOQueue *queue = (SDL_AsyncIOQueue *)batch->platform;
+   if(!queue)
+   {
+      return(batch->outstanding);
+   }
+
+   u32 previous = batch->outstanding;
+   SDL_AsyncIOOutcome outcome;
+   while(batch->outstanding && SDL_GetAsyncIOResult(queue, &outcome))
+   {
+      finish_async_task(batch, &outcome);
+   }
+   while(wait && batch->outstanding == previous && SDL_WaitAsyncIOResult(queue, &outcome, -1))
+   {
+      finish_async_task(batch, &outcome);
+   }
+
+   if(batch->outstanding == 0)
+   {
+      SDL_DestroyAsyncIOQueue(queue);
+      batch->platform = 0;
+   }
+
+   return(batch->outstanding);
+}
+
+// NOTE: Jobs. SDL only offers mutexes and condition variables portably, so
+// jobs share a single locked queue instead of the per-thread deques used on
+// Unix. Workers sleep until jobs are queued, and waiters help run queued jobs
+// until their counter reaches zero, sleeping only when the queue is empty and
+// the last of their jobs is still running elsewhere.
+#define JOB_QUEUE_SIZE 4096
+#define JOB_WORKER_MAXIMUM 64
+
+typedef struct {
+   SDL_Mutex *mutex;
+   SDL_Condition *queued;
+   SDL_Condition *finished;
 
+   u32 read_index;
+   u32 write_index;
+   job *jobs[JOB_QUEUE_SIZE];
+
+   u32 worker_count;
+} sdl_job_queue;
+
+global SDL_InitState job_initialization;
+global sdl_job_queue job_queue;
+
+function job *pop_job(void)
+{
+   // NOTE: The job mutex must be held by the caller.
+   job *result = 0;
+   if(job_queue.read_index != job_queue.write_index)
+   {
+      result = job_queue.jobs[job_queue.read_index++ & (JOB_QUEUE_SIZE - 1)];
+   }
    return(result);
 }
+
+function void execute_job(job *j)
+{
+   // NOTE: The job may be freed as soon as its counter reaches zero, so don't
+   // touch it after the decrement.
+   job_counter *counter = j->counter;
+   j->procedure(j->data);
+
+   SDL_LockMutex(job_queue.mutex);
+   if(--counter->value == 0)
+   {
+      SDL_BroadcastCondition(job_queue.finished);
+   }
+   SDL_UnlockMutex(job_queue.mutex);
+}
+
+function int job_worker(void *parameter)
+{
+   (void)parameter;
+
+   for(;;)
+   {
+      SDL_LockMutex(job_queue.mutex);
+      job *j = pop_job();
+      while(!j)
+      {
+         SDL_WaitCondition(job_queue.queued, job_queue.mutex);
+         j = pop_job();
+      }
+      SDL_UnlockMutex(job_queue.mutex);
+
+      execute_job(j);
+   }
+
+   return(0);
+}
+
+function void initialize_jobs(void)
+{
+   if(SDL_ShouldInit(&job_initialization))
+   {
+      job_queue.mutex = SDL_CreateMutex();
+      job_queue.queued = SDL_CreateCondition();
+      job_queue.finished = SDL_CreateCondition();
+
+      // NOTE: The thread that submits jobs helps run them while it waits, so it
+      // takes the place of one worker.
+      int cores = SDL_GetNumLogicalCPUCores();
+      u32 worker_count = (cores > 1) ? MINIMUM((u32)cores - 1, JOB_WORKER_MAXIMUM) : 0;
+
+      for(u32 index = 0; index < worker_count; ++index)
+      {
+         SDL_Thread *worker = SDL_CreateThread(job_worker, "job worker", 0);
+         if(worker)
+         {
+            SDL_DetachThread(worker);
+            job_queue.worker_count++;
+         }
+         else
+         {
+            log_warning("WARNING: Failed to create job worker %u.\n", index);
+            break;
+         }
+      }
+
+      SDL_SetInitialized(&job_initialization, true);
+   }
+}
+
+PLATFORM_RUN_JOBS(platform_run_jobs)
+{
+   initialize_jobs();
+
+   SDL_LockMutex(job_queue.mutex);
+   counter->value += count;
+
+   u32 pushed = 0;
+   for(; pushed < count; ++pushed)
+   {
+      if(job_queue.write_index - job_queue.read_index == JOB_QUEUE_SIZE)
+      {
+         break;
+      }
+
+      jobs[pushed].counter = counter;
+      job_queue.jobs[job_queue.write_index++ & (JOB_QUEUE_SIZE - 1)] = jobs + pushed;
+   }
+   SDL_UnlockMutex(job_queue.mutex);
+
+   if(pushed == 1)
+   {
+      SDL_SignalCondition(job_queue.queued);
+   }
+   else if(pushed > 1)
+   {
+      SDL_BroadcastCondition(job_queue.queued);
+   }
+
+   // NOTE: Whatever didn't fit in the queue runs right away.
+   for(u32 index = pushed; index < count; ++index)
+   {
+      jobs[index].counter = counter;
+      execute_job(jobs + index);
+   }
+}
+
+PLATFORM_WAIT_FOR_COUNTER(platform_wait_for_counter)
+{
+   initialize_jobs();
+
+   SDL_LockMutex(job_queue.mutex);
+   while(counter->value != 0)
+   {
+      job *j = pop_job();
+      if(j)
+      {
+         SDL_UnlockMutex(job_queue.mutex);
+         execute_job(j);
+         SDL_LockMutex(job_queue.mutex);
+      }
+      else
+      {
+         SDL_WaitCondition(job_queue.finished, job_queue.mutex);
+      }
+   }
+   SDL_UnlockMutex(job_queue.mutex);
+}
+
+PLATFORM_GET_THREAD_COUNT(platform_get_thread_count)
+{
+   initialize_jobs();
+
+   u32 result = job_queue.worker_count + 1;
+   return(result);
+}
+
+PLATFORM_TIME_NS(platform_time_ns)
+{
+   u64 result = SDL_GetTicksNS();
+   return(result);
+}
+
+// NOTE: SDL has no portable way to read hardware counters, so none are ever
+// available on this platform. Callers fall back to the clock and timestamp
+// counter, as described in platform.h.
+PLATFORM_READ_COUNTERS(platform_read_counters)
+{
+   zero_memory(counters, sizeof(*counters));
+   return(false);
+}
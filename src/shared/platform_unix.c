@@ -3,99 +3,2012 @@
 /* /////////////////////////////////////////////////////////////////////////// */
 
 #include <fcntl.h>
+#include <pthread.h>
 #include <sys/mman.h>
 #include <sys/stat.h>
+#include <sys/uio.h>
 #include <unistd.h>
 
+#if !defined(PLATFORM_IO_URING)
+#   if defined(__linux__)
+#      define PLATFORM_IO_URING 1
+#   else
+#      define PLATFORM_IO_URING 0
+#   endif
+#endif
+
+#if PLATFORM_IO_URING
+#   include <linux/io_uring.h>
+#   include <sys/syscall.h>
+#endif
+
+#if defined(__linux__)
+#   include <linux/futex.h>
+#   include <linux/perf_event.h>
+#   include <sys/syscall.h>
+#endif
+
 #include <errno.h>
+#include <sched.h>
 #include <stdarg.h>
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
+#include <time.h>
 
 #include "platform.h"
 
-PLATFORM_LOG(platform_log)
+// NOTE: Logging. Each thread appends records to a ring buffer of its own
+// without taking any locks. A record is just the format string and a copy of
+// the arguments it refers to; the formatting itself happens later, on a
+// background thread that merges the rings back into the order the records were
+// made, formats them into large blocks, and writes the blocks out together with
+// writev. Format strings therefore have to outlive the call, which string
+// literals do. The background thread sleeps until a record arrives with
+// nothing else pending, then waits up to LOG_FLUSH_INTERVAL_MS for more to
+// collect before it drains them all.
+#define LOG_RING_SIZE KILOBYTES(256)
+#define LOG_RECORD_MAXIMUM KILOBYTES(4)
+#define LOG_BLOCK_SIZE KILOBYTES(64)
+#define LOG_BLOCK_COUNT 8
+#define LOG_FLUSH_INTERVAL_MS 10
+
+typedef struct log_ring log_ring;
+struct log_ring {
+   log_ring *next;
+
+   // NOTE: Set once the owning thread has exited. Rings are never unlinked,
+   // since the drain walks the list without a lock, so the next thread to log
+   // takes over a released ring instead of mapping a new one. Records still
+   // in it are drained as usual, since positions carry on from where they are.
+   u32 released;
+
+   // NOTE: Positions only ever grow. head is written by the owning thread and
+   // tail by whoever is draining the logs.
+   size head;
+   size tail;
+   u8 memory[LOG_RING_SIZE];
+};
+
+typedef struct {
+   // NOTE: Records are padded to 8 bytes. Ones with no format only pad out the
+   // end of the ring.
+   u32 length;
+   u32 argument_size;
+   u64 sequence;
+   char *format;
+} log_record;
+
+typedef enum {
+   LOG_ARGUMENT_NONE,
+   LOG_ARGUMENT_SIGNED,
+   LOG_ARGUMENT_UNSIGNED,
+   LOG_ARGUMENT_CHARACTER,
+   LOG_ARGUMENT_DOUBLE,
+   LOG_ARGUMENT_LONG_DOUBLE,
+   LOG_ARGUMENT_POINTER,
+   LOG_ARGUMENT_STRING,
+   LOG_ARGUMENT_COUNT,
+} log_argument_type;
+
+typedef struct {
+   log_argument_type type;
+   char conversion;
+   char length[3];
+
+   // NOTE: The text of the conversion specification, from the % to just
+   // before the length modifier.
+   char *flags;
+   u32 flags_length;
+
+   b32 star_width;
+   b32 star_precision;
+   s32 precision;
+
+   // NOTE: Total length of the specification.
+   u32 spec_length;
+} log_conversion;
+
+global log_ring *log_rings;
+global THREAD_LOCAL log_ring *log_thread_ring;
+global u64 log_sequence;
+
+global pthread_once_t log_once = PTHREAD_ONCE_INIT;
+global pthread_key_t log_ring_key;
+global pthread_mutex_t log_drain_mutex = PTHREAD_MUTEX_INITIALIZER;
+global pthread_mutex_t log_wake_mutex = PTHREAD_MUTEX_INITIALIZER;
+global pthread_cond_t log_wake = PTHREAD_COND_INITIALIZER;
+global b32 log_threaded;
+global u32 log_pending;
+
+// NOTE: Only touched while holding log_drain_mutex.
+global u8 log_blocks[LOG_BLOCK_COUNT][LOG_BLOCK_SIZE];
+global u32 log_block_index;
+global size log_block_used[LOG_BLOCK_COUNT];
+
+function log_conversion parse_log_conversion(char *spec)
 {
-#if DEVELOPMENT_BUILD
-   char message[1024];
+   // NOTE: spec points at the character after the %.
+   log_conversion result = {0};
+   result.precision = -1;
 
-   va_list arguments;
-   va_start(arguments, format);
+   char *at = spec;
+   while(*at == '-' || *at == '+' || *at == ' ' || *at == '#' || *at == '0')
    {
-      vsnprintf(message, sizeof(message), format, arguments);
+      at++;
    }
-   va_end(arguments);
 
-   printf("%s", message);
-#else
-   (void)format;
-#endif
+   if(*at == '*')
+   {
+      result.star_width = true;
+      at++;
+   }
+   while(*at >= '0' && *at <= '9')
+   {
+      at++;
+   }
+
+   if(*at == '.')
+   {
+      at++;
+      result.precision = 0;
+      if(*at == '*')
+      {
+         result.star_precision = true;
+         at++;
+      }
+      while(*at >= '0' && *at <= '9')
+      {
+         result.precision = (result.precision * 10) + (*at++ - '0');
+      }
+   }
+
+   result.flags = spec;
+   result.flags_length = (u32)(at - spec);
+
+   u32 length_index = 0;
+   while(length_index < 2 && (*at == 'h' || *at == 'l' || *at == 'L' || *at == 'z' || *at == 't' || *at == 'j' || *at == 'q'))
+   {
+      result.length[length_index++] = *at++;
+   }
+
+   result.conversion = *at;
+   switch(result.conversion)
+   {
+      case 'd': case 'i':
+      {
+         result.type = LOG_ARGUMENT_SIGNED;
+      } break;
+
+      case 'u': case 'o': case 'x': case 'X':
+      {
+         result.type = LOG_ARGUMENT_UNSIGNED;
+      } break;
+
+      case 'c':
+      {
+         result.type = LOG_ARGUMENT_CHARACTER;
+      } break;
+
+      case 'f': case 'F': case 'e': case 'E': case 'g': case 'G': case 'a': case 'A':
+      {
+         result.type = (result.length[0] == 'L') ? LOG_ARGUMENT_LONG_DOUBLE : LOG_ARGUMENT_DOUBLE;
+      } break;
+
+      case 'p': case 'n':
+      {
+         result.type = LOG_ARGUMENT_POINTER;
+      } break;
+
+      case 's':
+      {
+         result.type = LOG_ARGUMENT_STRING;
+      } break;
+
+      default:
+      {
+         // NOTE: Covers %% as well as anything unrecognized, which are
+         // written out as is.
+         result.type = LOG_ARGUMENT_NONE;
+      } break;
+   }
+
+   if(result.conversion)
+   {
+      at++;
+   }
+   result.spec_length = (u32)(at - spec);
+
+   return(result);
 }
 
-PLATFORM_ALLOCATE(platform_allocate)
+function size encode_log_arguments(u8 *destination, size capacity, char *format, va_list arguments)
 {
-   void *result = mmap(0, s, PROT_READ|PROT_WRITE, MAP_ANONYMOUS|MAP_PRIVATE, -1, 0);
+   // NOTE: Copies every argument the format refers to, widened to a fixed
+   // size per type. Strings are copied inline. Returns -1 if they don't fit.
+   size used = 0;
+
+#define LOG_PUT(value) do { if(used + (size)sizeof(value) > capacity) { return(-1); } memcpy(destination + used, &(value), sizeof(value)); used += sizeof(value); } while(0)
+
+   for(char *at = format; *at; ++at)
+   {
+      if(*at != '%')
+      {
+         continue;
+      }
+
+      log_conversion conversion = parse_log_conversion(at + 1);
+      at += conversion.spec_length;
+
+      s32 precision = conversion.precision;
+      if(conversion.star_width)
+      {
+         s32 width = va_arg(arguments, int);
+         LOG_PUT(width);
+      }
+      if(conversion.star_precision)
+      {
+         precision = va_arg(arguments, int);
+         LOG_PUT(precision);
+      }
+
+      char *length = conversion.length;
+      switch(conversion.type)
+      {
+         case LOG_ARGUMENT_SIGNED:
+         case LOG_ARGUMENT_UNSIGNED:
+         {
+            b32 is_signed = (conversion.type == LOG_ARGUMENT_SIGNED);
+
+            u64 value;
+            if(length[0] == 'l' && length[1] == 'l')   value = va_arg(arguments, unsigned long long);
+            else if(length[0] == 'q')                  value = va_arg(arguments, unsigned long long);
+            else if(length[0] == 'l')                  value = is_signed ? (u64)va_arg(arguments, long) : (u64)va_arg(arguments, unsigned long);
+            else if(length[0] == 'z')                  value = is_signed ? (u64)va_arg(arguments, ssize_t) : (u64)va_arg(arguments, size_t);
+            else if(length[0] == 't')                  value = (u64)va_arg(arguments, ptrdiff_t);
+            else if(length[0] == 'j')                  value = is_signed ? (u64)va_arg(arguments, intmax_t) : (u64)va_arg(arguments, uintmax_t);
+            else
+            {
+               int promoted = va_arg(arguments, int);
+               if(length[0] == 'h' && length[1] == 'h')   value = is_signed ? (u64)(signed char)promoted : (u64)(unsigned char)promoted;
+               else if(length[0] == 'h')                  value = is_signed ? (u64)(short)promoted : (u64)(unsigned short)promoted;
+               else                                       value = is_signed ? (u64)promoted : (u64)(unsigned)promoted;
+            }
+            LOG_PUT(value);
+         } break;
+
+         case LOG_ARGUMENT_CHARACTER:
+         {
+            int value = va_arg(arguments, int);
+            LOG_PUT(value);
+         } break;
+
+         case LOG_ARGUMENT_DOUBLE:
+         {
+            double value = va_arg(arguments, double);
+            LOG_PUT(value);
+         } break;
+
+         case LOG_ARGUMENT_LONG_DOUBLE:
+         {
+            long double value = va_arg(arguments, long double);
+            LOG_PUT(value);
+         } break;
+
+         case LOG_ARGUMENT_POINTER:
+         {
+            void *value = va_arg(arguments, void *);
+            LOG_PUT(value);
+         } break;
+
+         case LOG_ARGUMENT_STRING:
+         {
+            char *string = va_arg(arguments, char *);
+            if(!string)
+            {
+               string = "(null)";
+            }
+
+            // NOTE: Strings are stored with their length, and a terminator so
+            // that they can be handed back to snprintf.
+            u32 string_length = (u32)((precision >= 0) ? strnlen(string, precision) : strlen(string));
+            LOG_PUT(string_length);
+            if(used + string_length + 1 > capacity)
+            {
+               return(-1);
+            }
+            memcpy(destination + used, string, string_length);
+            destination[used + string_length] = 0;
+            used += string_length + 1;
+         } break;
+
+         default: break;
+      }
+   }
+#undef LOG_PUT
+
+   return(used);
+}
+
+function void write_log_blocks(void)
+{
+   struct iovec vectors[LOG_BLOCK_COUNT];
+   u32 vector_count = 0;
+   for(u32 index = 0; index <= log_block_index && index < LOG_BLOCK_COUNT; ++index)
+   {
+      if(log_block_used[index] > 0)
+      {
+         vectors[vector_count].iov_base = log_blocks[index];
+         vectors[vector_count].iov_len = log_block_used[index];
+         vector_count++;
+      }
+      log_block_used[index] = 0;
+   }
+
+   // NOTE: Retry partial writes until everything is out.
+   struct iovec *vector = vectors;
+   while(vector_count > 0)
+   {
+      ssize_t written = writev(STDOUT_FILENO, vector, vector_count);
+      if(written < 0)
+      {
+         if(errno == EINTR)
+         {
+            continue;
+         }
+         break;
+      }
+
+      while(vector_count > 0 && (size_t)written >= vector->iov_len)
+      {
+         written -= vector->iov_len;
+         vector++;
+         vector_count--;
+      }
+      if(vector_count > 0)
+      {
+         vector->iov_base = (u8 *)vector->iov_base + written;
+         vector->iov_len -= written;
+      }
+   }
+
+   log_block_index = 0;
+}
+
+function char *reserve_log_output(size count)
+{
+   // NOTE: Returns space for count bytes of output, moving on to the next block
+   // or writing out full ones as needed. count never exceeds a block.
+   if(log_block_used[log_block_index] + count > LOG_BLOCK_SIZE)
+   {
+      log_block_index++;
+      if(log_block_index == LOG_BLOCK_COUNT)
+      {
+         write_log_blocks();
+      }
+   }
+
+   char *result = (char *)log_blocks[log_block_index] + log_block_used[log_block_index];
    return(result);
 }
 
-PLATFORM_LOAD_FILE(platform_load_file)
+function void put_log_text(char *text, size count)
 {
-   string8 result = string8("");
+   while(count > 0)
+   {
+      size chunk = MINIMUM(count, LOG_BLOCK_SIZE);
+      char *destination = reserve_log_output(chunk);
+      memcpy(destination, text, chunk);
+      log_block_used[log_block_index] += chunk;
 
-   struct stat file_information;
-   if(stat(path, &file_information) == -1)
+      text += chunk;
+      count -= chunk;
+   }
+}
+
+function void format_log_record(log_record *record)
+{
+   u8 *arguments = (u8 *)(record + 1);
+
+#define LOG_GET(value) do { memcpy(&(value), arguments, sizeof(value)); arguments += sizeof(value); } while(0)
+
+   char *literal = record->format;
+   char *at = record->format;
+   while(*at)
    {
-      platform_log("ERROR (%d): Failed to read file size of file: \"%s\".\n", errno, path);
-      return(result);
+      if(*at != '%')
+      {
+         at++;
+         continue;
+      }
+
+      put_log_text(literal, at - literal);
+
+      log_conversion conversion = parse_log_conversion(at + 1);
+      literal = at + 1 + conversion.spec_length;
+
+      // NOTE: Rebuild the specification with any * replaced by the stored
+      // values, and integer length modifiers replaced by ll to match how the
+      // values were stored.
+      char spec[64];
+      u32 spec_length = 0;
+      spec[spec_length++] = '%';
+
+      s32 width = 0;
+      s32 precision = conversion.precision;
+      if(conversion.star_width)
+      {
+         LOG_GET(width);
+      }
+      if(conversion.star_precision)
+      {
+         LOG_GET(precision);
+      }
+
+      if(conversion.star_width || conversion.star_precision)
+      {
+         // NOTE: Copy the flags only, then spell out width and precision.
+         char *flags = conversion.flags;
+         while(flags < conversion.flags + conversion.flags_length && (*flags == '-' || *flags == '+' || *flags == ' ' || *flags == '#' || *flags == '0'))
+         {
+            spec[spec_length++] = *flags++;
+         }
+         if(conversion.star_width)
+         {
+            spec_length += snprintf(spec + spec_length, sizeof(spec) - spec_length, "%d", width);
+         }
+         else
+         {
+            while(*flags >= '0' && *flags <= '9')
+            {
+               spec[spec_length++] = *flags++;
+            }
+         }
+         if(precision >= 0)
+         {
+            spec_length += snprintf(spec + spec_length, sizeof(spec) - spec_length, ".%d", precision);
+         }
+      }
+      else
+      {
+         u32 count = MINIMUM(conversion.flags_length, (u32)sizeof(spec) - 8);
+         memcpy(spec + spec_length, conversion.flags, count);
+         spec_length += count;
+      }
+
+      if(conversion.type == LOG_ARGUMENT_SIGNED || conversion.type == LOG_ARGUMENT_UNSIGNED)
+      {
+         spec[spec_length++] = 'l';
+         spec[spec_length++] = 'l';
+      }
+      else if(conversion.type == LOG_ARGUMENT_LONG_DOUBLE)
+      {
+         spec[spec_length++] = 'L';
+      }
+      if(conversion.conversion)
+      {
+         spec[spec_length++] = conversion.conversion;
+      }
+      spec[spec_length] = 0;
+
+      char *plain_string = 0;
+      u32 plain_length = 0;
+
+      // NOTE: Try formatting into what's left of the current block, and once
+      // more into a fresh block if it didn't fit.
+      for(u32 attempt = 0; attempt < 2; ++attempt)
+      {
+         u8 *saved_arguments = arguments;
+
+         size available = LOG_BLOCK_SIZE - log_block_used[log_block_index];
+         if(attempt == 1)
+         {
+            reserve_log_output(LOG_BLOCK_SIZE);
+            available = LOG_BLOCK_SIZE;
+         }
+         char *destination = (char *)log_blocks[log_block_index] + log_block_used[log_block_index];
+
+         int written = 0;
+         switch(conversion.type)
+         {
+            case LOG_ARGUMENT_SIGNED:
+            case LOG_ARGUMENT_UNSIGNED:
+            {
+               u64 value;
+               LOG_GET(value);
+               written = snprintf(destination, available, spec, (long long)value);
+            } break;
+
+            case LOG_ARGUMENT_CHARACTER:
+            {
+               int value;
+               LOG_GET(value);
+               written = snprintf(destination, available, spec, value);
+            } break;
+
+            case LOG_ARGUMENT_DOUBLE:
+            {
+               double value;
+               LOG_GET(value);
+               written = snprintf(destination, available, spec, value);
+            } break;
+
+            case LOG_ARGUMENT_LONG_DOUBLE:
+            {
+               long double value;
+               LOG_GET(value);
+               written = snprintf(destination, available, spec, value);
+            } break;
+
+            case LOG_ARGUMENT_POINTER:
+            {
+               void *value;
+               LOG_GET(value);
+               if(conversion.conversion == 'p')
+               {
+                  written = snprintf(destination, available, spec, value);
+               }
+            } break;
+
+            case LOG_ARGUMENT_STRING:
+            {
+               u32 length;
+               LOG_GET(length);
+               char *string = (char *)arguments;
+               arguments += length + 1;
+
+               if(spec_length == 2)
+               {
+                  // NOTE: A plain %s is copied straight across, however long.
+                  plain_string = string;
+                  plain_length = length;
+               }
+               else
+               {
+                  written = snprintf(destination, available, spec, string);
+               }
+            } break;
+
+            default:
+            {
+               if(conversion.conversion == '%')
+               {
+                  written = snprintf(destination, available, "%%");
+               }
+               else
+               {
+                  written = snprintf(destination, available, "%%%.*s", (int)conversion.spec_length, conversion.flags);
+               }
+            } break;
+         }
+
+         if(plain_string || written < (int)available || attempt == 1)
+         {
+            if(written > 0)
+            {
+               log_block_used[log_block_index] += MINIMUM(written, (int)available - 1);
+            }
+            break;
+         }
+
+         arguments = saved_arguments;
+      }
+
+      if(plain_string)
+      {
+         put_log_text(plain_string, plain_length);
+      }
+
+      at = literal;
    }
 
-   int file = open(path, O_RDONLY);
-   if(file == -1)
+   put_log_text(literal, at - literal);
+#undef LOG_GET
+}
+
+function log_record *peek_log_record(log_ring *ring)
+{
+   // NOTE: Returns the ring's oldest record, skipping over any padding at the
+   // end of the buffer. Space at the end too small for a record header is
+   // skipped implicitly, by both sides.
+   log_record *result = 0;
+
+   size head = __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE);
+   while(ring->tail != head)
    {
-      platform_log("ERROR (%d): Failed to open file: \"%s\".\n", path, errno);
-      return(result);
+      size offset = ring->tail & (LOG_RING_SIZE - 1);
+      if(LOG_RING_SIZE - offset < (size)sizeof(log_record))
+      {
+         __atomic_store_n(&ring->tail, ring->tail + (LOG_RING_SIZE - offset), __ATOMIC_RELEASE);
+         continue;
+      }
+
+      log_record *record = (log_record *)(ring->memory + offset);
+      if(!record->format)
+      {
+         __atomic_store_n(&ring->tail, ring->tail + record->length, __ATOMIC_RELEASE);
+         continue;
+      }
+
+      result = record;
+      break;
    }
 
-   size length = file_information.st_size;
+   return(result);
+}
 
-   result.data = arena_allocate(a, u8, length + 1);
-   if(result.data)
+function void drain_logs(void)
+{
+   pthread_mutex_lock(&log_drain_mutex);
+   for(;;)
    {
-      result.length = length;
-      read(file, result.data, result.length);
-      result.data[result.length] = 0;
+      // NOTE: Take the oldest record across all threads' rings.
+      log_ring *oldest_ring = 0;
+      log_record *oldest = 0;
+      for(log_ring *ring = __atomic_load_n(&log_rings, __ATOMIC_ACQUIRE); ring; ring = ring->next)
+      {
+         log_record *record = peek_log_record(ring);
+         if(record && (!oldest || record->sequence < oldest->sequence))
+         {
+            oldest_ring = ring;
+            oldest = record;
+         }
+      }
+
+      if(!oldest)
+      {
+         break;
+      }
+
+      format_log_record(oldest);
+      __atomic_store_n(&oldest_ring->tail, oldest_ring->tail + oldest->length, __ATOMIC_RELEASE);
    }
-   else
+
+   if(log_block_index > 0 || log_block_used[0] > 0)
+   {
+      write_log_blocks();
+   }
+   pthread_mutex_unlock(&log_drain_mutex);
+}
+
+function void *log_flusher(void *parameter)
+{
+   (void)parameter;
+
+   for(;;)
    {
-      platform_log("ERROR: Failed to allocate memory for file: \"%s\".\n", path);
+      pthread_mutex_lock(&log_wake_mutex);
+      while(!__atomic_load_n(&log_pending, __ATOMIC_ACQUIRE))
+      {
+         pthread_cond_wait(&log_wake, &log_wake_mutex);
+      }
+
+      // NOTE: Let more records collect before draining, unless a ring filling
+      // up signals again sooner.
+      struct timespec deadline;
+      clock_gettime(CLOCK_REALTIME, &deadline);
+      deadline.tv_nsec += LOG_FLUSH_INTERVAL_MS * 1000000L;
+      if(deadline.tv_nsec >= 1000000000L)
+      {
+         deadline.tv_sec += 1;
+         deadline.tv_nsec -= 1000000000L;
+      }
+      pthread_cond_timedwait(&log_wake, &log_wake_mutex, &deadline);
+      pthread_mutex_unlock(&log_wake_mutex);
+
+      // NOTE: Cleared before draining, so records made during the drain wake
+      // the flusher again. Exchanging also makes the rings' new heads visible.
+      __atomic_exchange_n(&log_pending, 0, __ATOMIC_ACQ_REL);
+      drain_logs();
    }
 
-   close(file);
+   return(0);
+}
+
+function void release_log_ring(void *parameter)
+{
+   log_ring *ring = (log_ring *)parameter;
+   log_thread_ring = 0;
+   __atomic_store_n(&ring->released, 1, __ATOMIC_RELEASE);
+}
+
+function log_ring *acquire_log_ring(void)
+{
+   log_ring *result = 0;
+   for(log_ring *ring = __atomic_load_n(&log_rings, __ATOMIC_ACQUIRE); ring && !result; ring = ring->next)
+   {
+      u32 released = 1;
+      if(__atomic_load_n(&ring->released, __ATOMIC_RELAXED) &&
+         __atomic_compare_exchange_n(&ring->released, &released, 0, false, __ATOMIC_ACQUIRE, __ATOMIC_RELAXED))
+      {
+         result = ring;
+      }
+   }
+
+   if(!result)
+   {
+      result = mmap(0, sizeof(log_ring), PROT_READ|PROT_WRITE, MAP_ANONYMOUS|MAP_PRIVATE, -1, 0);
+      if(result == MAP_FAILED)
+      {
+         return(0);
+      }
+
+      result->next = __atomic_load_n(&log_rings, __ATOMIC_RELAXED);
+      while(!__atomic_compare_exchange_n(&log_rings, &result->next, result, true, __ATOMIC_RELEASE, __ATOMIC_RELAXED));
+   }
+
+   // NOTE: The key's destructor hands the ring back when this thread exits.
+   pthread_setspecific(log_ring_key, result);
+   log_thread_ring = result;
 
    return(result);
 }
 
-PLATFORM_SAVE_FILE(platform_save_file)
+function void initialize_logging(void)
 {
-   bool result = false;
+   pthread_key_create(&log_ring_key, release_log_ring);
 
-   int file = open(path, O_WRONLY|O_CREAT|O_TRUNC, 0666);
-   if(file != -1)
+   pthread_t flusher;
+   if(pthread_create(&flusher, 0, log_flusher, 0) == 0)
    {
-      ssize_t bytes_written = write(file, memory, s);
-      result = (bytes_written == s);
+      pthread_detach(flusher);
+      log_threaded = true;
+   }
 
-      if(!result)
+   atexit(platform_flush_log);
+}
+
+function void write_log(char *format, va_list arguments)
+{
+   pthread_once(&log_once, initialize_logging);
+
+   log_ring *ring = log_thread_ring;
+   if(!ring)
+   {
+      ring = acquire_log_ring();
+      if(!ring)
       {
-         platform_log("ERROR (%d): Failed to write file: \"%s\".\n", errno, path);
+         vdprintf(STDOUT_FILENO, format, arguments);
+         return;
       }
+   }
 
-      close(file);
+   u8 staging[LOG_RECORD_MAXIMUM];
+   va_list copy;
+   va_copy(copy, arguments);
+   size argument_size = encode_log_arguments(staging, sizeof(staging), format, copy);
+   va_end(copy);
+
+   if(argument_size < 0)
+   {
+      // NOTE: Too big to defer. Write out everything before it, then this.
+      platform_flush_log();
+      vdprintf(STDOUT_FILENO, format, arguments);
+      return;
    }
-   else
+
+   size length = (sizeof(log_record) + argument_size + 7) & ~7;
+
+   // NOTE: Records don't wrap around the end of the ring. If this one won't
+   // fit before the end, the rest of the ring is padded out first.
+   size head = ring->head;
+   size offset = head & (LOG_RING_SIZE - 1);
+   size padding = 0;
+   if(LOG_RING_SIZE - offset < length)
+   {
+      padding = LOG_RING_SIZE - offset;
+   }
+
+   size tail = __atomic_load_n(&ring->tail, __ATOMIC_ACQUIRE);
+   while((head + padding + length) - tail > LOG_RING_SIZE)
+   {
+      // NOTE: The ring is full. Wait for the flusher to make room, or make it
+      // ourselves if there isn't one.
+      if(log_threaded)
+      {
+         pthread_cond_signal(&log_wake);
+         sched_yield();
+      }
+      else
+      {
+         drain_logs();
+      }
+      tail = __atomic_load_n(&ring->tail, __ATOMIC_ACQUIRE);
+   }
+
+   if(padding >= (size)sizeof(log_record))
+   {
+      log_record *pad = (log_record *)(ring->memory + offset);
+      pad->length = (u32)padding;
+      pad->format = 0;
+   }
+   head += padding;
+
+   log_record *record = (log_record *)(ring->memory + (head & (LOG_RING_SIZE - 1)));
+   record->length = (u32)length;
+   record->argument_size = (u32)argument_size;
+   record->sequence = __atomic_fetch_add(&log_sequence, 1, __ATOMIC_RELAXED);
+   record->format = format;
+   memcpy(record + 1, staging, argument_size);
+
+   __atomic_store_n(&ring->head, head + length, __ATOMIC_RELEASE);
+
+   if(!log_threaded)
    {
-      platform_log("ERROR (%d): Failed to open file: \"%s\".\n", errno, path);
+      drain_logs();
    }
+   else if(!__atomic_exchange_n(&log_pending, 1, __ATOMIC_ACQ_REL))
+   {
+      // NOTE: The first record since the last drain wakes the flusher up.
+      pthread_mutex_lock(&log_wake_mutex);
+      pthread_cond_signal(&log_wake);
+      pthread_mutex_unlock(&log_wake_mutex);
+   }
+   else if((head + length) - tail > (LOG_RING_SIZE / 2))
+   {
+      pthread_cond_signal(&log_wake);
+   }
+}
+
+PLATFORM_LOG(platform_log)
+{
+#if PLATFORM_LOG_LEVEL <= LOG_LEVEL_INFO
+   va_list arguments;
+   va_start(arguments, format);
+   {
+      write_log(format, arguments);
+   }
+   va_end(arguments);
+#else
+   (void)format;
+#endif
+}
+
+PLATFORM_LOG_MESSAGE(platform_log_message)
+{
+   // NOTE: Filtering by level happens at compile time, in log_message.
+   (void)level;
+
+   va_list arguments;
+   va_start(arguments, format);
+   {
+      write_log(format, arguments);
+   }
+   va_end(arguments);
+}
+
+PLATFORM_FLUSH_LOG(platform_flush_log)
+{
+   drain_logs();
+}
+
+PLATFORM_TIME_NS(platform_time_ns)
+{
+   struct timespec now;
+   clock_gettime(CLOCK_MONOTONIC, &now);
+
+   u64 result = ((u64)now.tv_sec * 1000000000ull) + (u64)now.tv_nsec;
+   return(result);
+}
+
+// NOTE: Hardware counters come from perf_event_open, opened as one group per
+// thread so that a single read returns all of them. Only user space is counted,
+// which the default perf_event_paranoid setting allows without privileges. The
+// kernel multiplexes groups when it runs out of hardware counters, so the group
+// is read with its enabled and running times for subtract_counters to scale by.
+typedef struct {
+   b32 opened;
+   int leader;
+   u32 available;
+   u32 count;
+   platform_counter_type types[PLATFORM_COUNTER_COUNT];
+} unix_counters;
+
+global THREAD_LOCAL unix_counters counters_thread;
+
+#if defined(__linux__)
+function void open_counters(unix_counters *state)
+{
+   u64 configs[PLATFORM_COUNTER_COUNT];
+   configs[PLATFORM_COUNTER_CYCLES] = PERF_COUNT_HW_CPU_CYCLES;
+   configs[PLATFORM_COUNTER_INSTRUCTIONS] = PERF_COUNT_HW_INSTRUCTIONS;
+   configs[PLATFORM_COUNTER_CACHE_MISSES] = PERF_COUNT_HW_CACHE_MISSES;
+   configs[PLATFORM_COUNTER_BRANCH_MISSES] = PERF_COUNT_HW_BRANCH_MISSES;
+
+   state->opened = true;
+   state->leader = -1;
+
+   for(u32 type = 0; type < PLATFORM_COUNTER_COUNT; ++type)
+   {
+      struct perf_event_attr attributes;
+      zero_memory(&attributes, sizeof(attributes));
+      attributes.type = PERF_TYPE_HARDWARE;
+      attributes.size = sizeof(attributes);
+      attributes.config = configs[type];
+      attributes.exclude_kernel = 1;
+      attributes.exclude_hv = 1;
+      attributes.read_format = PERF_FORMAT_GROUP|PERF_FORMAT_TOTAL_TIME_ENABLED|PERF_FORMAT_TOTAL_TIME_RUNNING;
+
+      int counter = (int)syscall(SYS_perf_event_open, &attributes, 0, -1, state->leader, PERF_FLAG_FD_CLOEXEC);
+      if(counter >= 0)
+      {
+         if(state->leader < 0)
+         {
+            state->leader = counter;
+         }
+         state->types[state->count++] = (platform_counter_type)type;
+         state->available |= (1 << type);
+      }
+   }
+}
+#endif
+
+PLATFORM_READ_COUNTERS(platform_read_counters)
+{
+   zero_memory(counters, sizeof(*counters));
+
+   unix_counters *state = &counters_thread;
+#if defined(__linux__)
+   if(!state->opened)
+   {
+      open_counters(state);
+   }
+
+   if(state->available)
+   {
+      u64 group[3 + PLATFORM_COUNTER_COUNT];
+      ssize_t length = read(state->leader, group, sizeof(group));
+      if(length >= (ssize_t)((3 + state->count) * sizeof(u64)) && group[0] == state->count)
+      {
+         for(u32 index = 0; index < state->count; ++index)
+         {
+            counters->values[state->types[index]] = group[3 + index];
+         }
+         counters->time_enabled = group[1];
+         counters->time_running = group[2];
+         counters->available = state->available;
+      }
+   }
+#else
+   (void)state;
+#endif
+
+   b32 result = (counters->available != 0);
+   return(result);
+}
+
+PLATFORM_ALLOCATE(platform_allocate)
+{
+   void *result = mmap(0, s, PROT_READ|PROT_WRITE, MAP_ANONYMOUS|MAP_PRIVATE, -1, 0);
+   return(result);
+}
+
+PLATFORM_RESERVE(platform_reserve)
+{
+   // NOTE: MAP_NORESERVE keeps large reservations from counting against the
+   // overcommit limit before any of the range is committed.
+   void *result = mmap(0, s, PROT_NONE, MAP_ANONYMOUS|MAP_PRIVATE|MAP_NORESERVE, -1, 0);
+   if(result == MAP_FAILED)
+   {
+      log_error("ERROR (%d): Failed to reserve %td bytes of address space.\n", errno, s);
+      result = 0;
+   }
+
+   return(result);
+}
+
+PLATFORM_COMMIT(platform_commit)
+{
+   b32 result = (mprotect(address, s, PROT_READ|PROT_WRITE) == 0);
+   if(!result)
+   {
+      log_error("ERROR (%d): Failed to commit %td bytes of memory.\n", errno, s);
+   }
+
+   return(result);
+}
+
+PLATFORM_DECOMMIT(platform_decommit)
+{
+   // NOTE: Dropping the pages first means recommitting the range later hands
+   // back zeroed memory, the same as a fresh commit.
+   madvise(address, s, MADV_DONTNEED);
+   mprotect(address, s, PROT_NONE);
+}
+
+// NOTE: Files are read in bounded chunks, since a single read can return
+// fewer bytes than requested (and Linux never transfers more than about 2GB per
+// call regardless).
+#define PLATFORM_READ_CHUNK MEGABYTES(64)
+
+function string8 read_open_file(arena *a, int file, size length, char *path)
+{
+   string8 result = string8("");
+
+   // NOTE: Store the previous arena location in case we need to back out.
+   arena_marker marker = arena_marker_set(a);
+
+   u8 *data = arena_allocate(a, u8, length + 1);
+   if(!data)
+   {
+      log_error("ERROR: Failed to allocate memory for file: \"%s\".\n", path);
+      return(result);
+   }
+
+   size total = 0;
+   while(total < length)
+   {
+      size chunk = MINIMUM(length - total, PLATFORM_READ_CHUNK);
+      ssize_t bytes_read = read(file, data + total, chunk);
+      if(bytes_read > 0)
+      {
+         total += bytes_read;
+      }
+      else if(bytes_read == 0)
+      {
+         // NOTE: The file was truncated after its size was queried. Keep
+         // whatever was there.
+         break;
+      }
+      else if(errno != EINTR)
+      {
+         log_error("ERROR (%d): Failed to read file: \"%s\".\n", errno, path);
+         arena_marker_restore(marker);
+         return(result);
+      }
+   }
+
+   data[total] = 0;
+   result.data = data;
+   result.length = total;
+
+   return(result);
+}
+
+PLATFORM_LOAD_FILE(platform_load_file)
+{
+   string8 result = string8("");
+
+   int file = open(path, O_RDONLY);
+   if(file == -1)
+   {
+      log_error("ERROR (%d): Failed to open file: \"%s\".\n", errno, path);
+      return(result);
+   }
+
+   struct stat file_information;
+   if(fstat(file, &file_information) == -1)
+   {
+      log_error("ERROR (%d): Failed to read file size of file: \"%s\".\n", errno, path);
+   }
+   else
+   {
+      result = read_open_file(a, file, file_information.st_size, path);
+   }
+
+   close(file);
+
+   return(result);
+}
+
+PLATFORM_MAP_FILE(platform_map_file)
+{
+   mapped_file result = {0};
+   result.contents = string8("");
+
+   int file = open(path, O_RDONLY);
+   if(file == -1)
+   {
+      log_error("ERROR (%d): Failed to open file: \"%s\".\n", errno, path);
+      return(result);
+   }
+
+   struct stat file_information;
+   if(fstat(file, &file_information) == -1)
+   {
+      log_error("ERROR (%d): Failed to read file size of file: \"%s\".\n", errno, path);
+      close(file);
+      return(result);
+   }
+
+   size length = file_information.st_size;
+   if(S_ISREG(file_information.st_mode) && length > 0)
+   {
+      // NOTE: Reserve the file's pages plus one more, then map the file over
+      // the front of the range. The kernel zero fills the rest of the file's
+      // last page, and the extra anonymous page covers files that end exactly
+      // on a page boundary, so there's always a zero byte after the contents.
+      size page_size = sysconf(_SC_PAGESIZE);
+      size mapping_size = ((length + page_size - 1) & ~(page_size - 1)) + page_size;
+
+      u8 *mapping = mmap(0, mapping_size, PROT_READ, MAP_ANONYMOUS|MAP_PRIVATE, -1, 0);
+      if(mapping != MAP_FAILED)
+      {
+         if(mmap(mapping, length, PROT_READ, MAP_PRIVATE|MAP_FIXED, file, 0) != MAP_FAILED)
+         {
+            madvise(mapping, length, MADV_SEQUENTIAL);
+
+            result.contents.data = mapping;
+            result.contents.length = length;
+            result.mapping = mapping;
+            result.mapping_size = mapping_size;
+         }
+         else
+         {
+            munmap(mapping, mapping_size);
+         }
+      }
+   }
+
+   if(!result.mapping)
+   {
+      // NOTE: Fall back to reading files that can't be mapped, like empty files
+      // or ones on file systems without mmap support.
+      result.contents = read_open_file(a, file, length, path);
+   }
+
+   close(file);
+
+   return(result);
+}
+
+PLATFORM_UNMAP_FILE(platform_unmap_file)
+{
+   if(file->mapping)
+   {
+      munmap(file->mapping, file->mapping_size);
+   }
+
+   mapped_file cleared = {0};
+   *file = cleared;
+}
+
+PLATFORM_SAVE_FILE(platform_save_file)
+{
+   bool result = false;
+
+   int file = open(path, O_WRONLY|O_CREAT|O_TRUNC, 0666);
+   if(file != -1)
+   {
+      ssize_t bytes_written = write(file, memory, s);
+      result = (bytes_written == s);
+
+      if(!result)
+      {
+         log_error("ERROR (%d): Failed to write file: \"%s\".\n", errno, path);
+      }
+
+      close(file);
+   }
+   else
+   {
+      log_error("ERROR (%d): Failed to open file: \"%s\".\n", errno, path);
+   }
+
+   return(result);
+}
+
+// NOTE: Asynchronous I/O. On Linux, transfers go through an io_uring set up per
+// batch, using the raw system calls. Where io_uring isn't available (older
+// kernels, other Unixes, or sandboxes that block it), a few worker threads
+// perform the transfers with blocking pread/pwrite instead. Either way, files
+// are opened and closed on the calling thread.
+#define PLATFORM_IO_WORKER_COUNT 4
+
+typedef struct {
+   b32 uses_ring;
+
+#if PLATFORM_IO_URING
+   int ring;
+   u32 unsubmitted;
+
+   void *sq_ring;
+   void *cq_ring;
+   size sq_ring_size;
+   size cq_ring_size;
+   struct io_uring_sqe *sqes;
+   size sqes_size;
+
+   u32 *sq_tail;
+   u32 *sq_mask;
+   u32 *sq_array;
+   u32 *cq_head;
+   u32 *cq_tail;
+   u32 *cq_mask;
+   struct io_uring_cqe *cqes;
+
+   struct iovec vectors[PLATFORM_IO_BATCH_COUNT];
+#endif
+
+   platform_io_batch *batch;
+   pthread_mutex_t mutex;
+   pthread_cond_t finished;
+   pthread_t workers[PLATFORM_IO_WORKER_COUNT];
+   u32 worker_count;
+
+   // NOTE: Requests waiting for a worker, and requests that workers have
+   // finished but the caller hasn't collected yet. Both are guarded by mutex.
+   u32 queued_count;
+   u32 queued_index;
+   u32 queued[PLATFORM_IO_BATCH_COUNT];
+
+   u32 done_count;
+   u32 done_index;
+   u32 done[PLATFORM_IO_BATCH_COUNT];
+   b32 succeeded[PLATFORM_IO_BATCH_COUNT];
+} unix_io_state;
+
+
+function void begin_file_io(platform_io_batch *batch, platform_io_request *request)
+{
+   b32 load = (request->type == PLATFORM_IO_LOAD);
+
+   int file = open(request->path, load ? O_RDONLY : O_WRONLY|O_CREAT|O_TRUNC, 0666);
+   if(file == -1)
+   {
+      log_error("ERROR (%d): Failed to open file: \"%s\".\n", errno, request->path);
+      request->status = PLATFORM_IO_FAILED;
+      return;
+   }
+
+   if(load)
+   {
+      struct stat file_information;
+      u8 *data = 0;
+      if(fstat(file, &file_information) == 0)
+      {
+         data = arena_allocate(batch->a, u8, file_information.st_size + 1);
+      }
+
+      if(!data)
+      {
+         log_error("ERROR: Failed to allocate memory for file: \"%s\".\n", request->path);
+         request->status = PLATFORM_IO_FAILED;
+         close(file);
+         return;
+      }
+
+      request->contents.data = data;
+      request->contents.length = file_information.st_size;
+   }
+
+   request->handle = file;
+   request->transferred = 0;
+   request->status = PLATFORM_IO_PENDING;
+   batch->outstanding++;
+}
+
+function void end_file_io(platform_io_batch *batch, platform_io_request *request, b32 success)
+{
+   close((int)request->handle);
+   request->handle = -1;
+
+   if(request->type == PLATFORM_IO_LOAD)
+   {
+      // NOTE: A load that stops short at the end of the file keeps whatever
+      // was read, in case the file was truncated after it was opened.
+      request->contents.length = request->transferred;
+      request->contents.data[request->transferred] = 0;
+   }
+
+   if(success)
+   {
+      request->status = PLATFORM_IO_COMPLETE;
+   }
+   else
+   {
+      log_error("ERROR: Failed to %s file: \"%s\".\n", (request->type == PLATFORM_IO_LOAD) ? "read" : "write", request->path);
+      request->status = PLATFORM_IO_FAILED;
+   }
+
+   batch->outstanding--;
+}
+
+#if PLATFORM_IO_URING
+global b32 io_uring_unavailable;
+
+function b32 create_io_ring(unix_io_state *state)
+{
+   struct io_uring_params parameters = {0};
+   int ring = (int)syscall(__NR_io_uring_setup, PLATFORM_IO_BATCH_COUNT, &parameters);
+   if(ring < 0)
+   {
+      return(false);
+   }
+
+   state->ring = ring;
+   state->sq_ring_size = parameters.sq_off.array + (parameters.sq_entries * sizeof(u32));
+   state->cq_ring_size = parameters.cq_off.cqes + (parameters.cq_entries * sizeof(struct io_uring_cqe));
+   state->sqes_size = parameters.sq_entries * sizeof(struct io_uring_sqe);
+
+   // NOTE: Kernels with IORING_FEAT_SINGLE_MMAP share one mapping between the
+   // submission and completion rings.
+   b32 single_mapping = (parameters.features & IORING_FEAT_SINGLE_MMAP);
+   if(single_mapping)
+   {
+      state->sq_ring_size = MAXIMUM(state->sq_ring_size, state->cq_ring_size);
+      state->cq_ring_size = state->sq_ring_size;
+   }
+
+   int protection = PROT_READ|PROT_WRITE;
+   int flags = MAP_SHARED|MAP_POPULATE;
+
+   state->sq_ring = mmap(0, state->sq_ring_size, protection, flags, ring, IORING_OFF_SQ_RING);
+   state->cq_ring = single_mapping ? state->sq_ring : mmap(0, state->cq_ring_size, protection, flags, ring, IORING_OFF_CQ_RING);
+   state->sqes = mmap(0, state->sqes_size, protection, flags, ring, IORING_OFF_SQES);
+
+   if(state->sq_ring == MAP_FAILED || state->cq_ring == MAP_FAILED || state->sqes == MAP_FAILED)
+   {
+      if(state->sqes != MAP_FAILED)
+      {
+         munmap(state->sqes, state->sqes_size);
+      }
+      if(state->cq_ring != MAP_FAILED && !single_mapping)
+      {
+         munmap(state->cq_ring, state->cq_ring_size);
+      }
+      if(state->sq_ring != MAP_FAILED)
+      {
+         munmap(state->sq_ring, state->sq_ring_size);
+      }
+      close(ring);
+
+      return(false);
+   }
+
+   u8 *sq = (u8 *)state->sq_ring;
+   state->sq_tail  = (u32 *)(sq + parameters.sq_off.tail);
+   state->sq_mask  = (u32 *)(sq + parameters.sq_off.ring_mask);
+   state->sq_array = (u32 *)(sq + parameters.sq_off.array);
+
+   u8 *cq = (u8 *)state->cq_ring;
+   state->cq_head = (u32 *)(cq + parameters.cq_off.head);
+   state->cq_tail = (u32 *)(cq + parameters.cq_off.tail);
+   state->cq_mask = (u32 *)(cq + parameters.cq_off.ring_mask);
+   state->cqes    = (struct io_uring_cqe *)(cq + parameters.cq_off.cqes);
+
+   return(true);
+}
+
+function void destroy_io_ring(unix_io_state *state)
+{
+   munmap(state->sqes, state->sqes_size);
+   if(state->cq_ring != state->sq_ring)
+   {
+      munmap(state->cq_ring, state->cq_ring_size);
+   }
+   munmap(state->sq_ring, state->sq_ring_size);
+   close(state->ring);
+}
+
+function void queue_ring_transfer(unix_io_state *state, platform_io_batch *batch, u32 index)
+{
+   // NOTE: Also used to resubmit the remainder of a short transfer. The ring
+   // has an entry for every request in the batch, so it can't overflow.
+   platform_io_request *request = batch->requests + index;
+
+   struct iovec *vector = state->vectors + index;
+   vector->iov_base = request->contents.data + request->transferred;
+   vector->iov_len = request->contents.length - request->transferred;
+
+   u32 tail = *state->sq_tail;
+   u32 slot = tail & *state->sq_mask;
+
+   struct io_uring_sqe *entry = state->sqes + slot;
+   memset(entry, 0, sizeof(*entry));
+   entry->opcode = (request->type == PLATFORM_IO_LOAD) ? IORING_OP_READV : IORING_OP_WRITEV;
+   entry->fd = (int)request->handle;
+   entry->addr = (u64)(uintptr_t)vector;
+   entry->len = 1;
+   entry->off = request->transferred;
+   entry->user_data = index;
+
+   state->sq_array[slot] = slot;
+   __atomic_store_n(state->sq_tail, tail + 1, __ATOMIC_RELEASE);
+   state->unsubmitted++;
+}
+
+function void enter_io_ring(unix_io_state *state, u32 minimum_complete)
+{
+   u32 flags = (minimum_complete > 0) ? IORING_ENTER_GETEVENTS : 0;
+   long result = syscall(__NR_io_uring_enter, state->ring, state->unsubmitted, minimum_complete, flags, 0, 0);
+   if(result >= 0)
+   {
+      state->unsubmitted -= MINIMUM((u32)result, state->unsubmitted);
+   }
+}
+
+function u32 reap_io_ring(unix_io_state *state, platform_io_batch *batch)
+{
+   u32 result = 0;
+
+   u32 head = *state->cq_head;
+   u32 tail = __atomic_load_n(state->cq_tail, __ATOMIC_ACQUIRE);
+   while(head != tail)
+   {
+      struct io_uring_cqe *completion = state->cqes + (head & *state->cq_mask);
+      u32 index = (u32)completion->user_data;
+      s32 transferred = completion->res;
+      head++;
+
+      platform_io_request *request = batch->requests + index;
+      if(transferred == -EINTR || transferred == -EAGAIN)
+      {
+         queue_ring_transfer(state, batch, index);
+      }
+      else if(transferred < 0 || (transferred == 0 && request->type == PLATFORM_IO_SAVE))
+      {
+         end_file_io(batch, request, false);
+         result++;
+      }
+      else
+      {
+         request->transferred += transferred;
+         if(transferred > 0 && request->transferred < request->contents.length)
+         {
+            queue_ring_transfer(state, batch, index);
+         }
+         else
+         {
+            end_file_io(batch, request, true);
+            result++;
+         }
+      }
+   }
+   __atomic_store_n(state->cq_head, head, __ATOMIC_RELEASE);
+
+   return(result);
+}
+#endif
+
+function void *io_worker(void *parameter)
+{
+   unix_io_state *state = (unix_io_state *)parameter;
+   platform_io_batch *batch = state->batch;
+
+   pthread_mutex_lock(&state->mutex);
+   while(state->queued_index < state->queued_count)
+   {
+      u32 index = state->queued[state->queued_index++];
+      pthread_mutex_unlock(&state->mutex);
+
+      platform_io_request *request = batch->requests + index;
+      int file = (int)request->handle;
+      b32 success = true;
+      while(request->transferred < request->contents.length)
+      {
+         u8 *data = request->contents.data + request->transferred;
+         size remaining = request->contents.length - request->transferred;
+
+         ssize_t transferred = (request->type == PLATFORM_IO_LOAD)
+            ? pread(file, data, remaining, request->transferred)
+            : pwrite(file, data, remaining, request->transferred);
+
+         if(transferred > 0)
+         {
+            request->transferred += transferred;
+         }
+         else if(transferred == 0)
+         {
+            success = (request->type == PLATFORM_IO_LOAD);
+            break;
+         }
+         else if(errno != EINTR)
+         {
+            success = false;
+            break;
+         }
+      }
+
+      pthread_mutex_lock(&state->mutex);
+      state->succeeded[index] = success;
+      state->done[state->done_count++] = index;
+      pthread_cond_signal(&state->finished);
+   }
+   pthread_mutex_unlock(&state->mutex);
+
+   return(0);
+}
+
+function void destroy_io_state(platform_io_batch *batch)
+{
+   unix_io_state *state = (unix_io_state *)batch->platform;
+
+#if PLATFORM_IO_URING
+   if(state->uses_ring)
+   {
+      destroy_io_ring(state);
+   }
+#endif
+   if(!state->uses_ring)
+   {
+      for(u32 index = 0; index < state->worker_count; ++index)
+      {
+         pthread_join(state->workers[index], 0);
+      }
+      pthread_cond_destroy(&state->finished);
+      pthread_mutex_destroy(&state->mutex);
+   }
+
+   munmap(state, sizeof(*state));
+   batch->platform = 0;
+}
+
+PLATFORM_SUBMIT_IO(platform_submit_io)
+{
+   assert(!batch->platform);
+
+   u32 pending[PLATFORM_IO_BATCH_COUNT];
+   u32 pending_count = 0;
+
+   for(u32 index = 0; index < batch->count; ++index)
+   {
+      platform_io_request *request = batch->requests + index;
+      if(request->status == PLATFORM_IO_QUEUED)
+      {
+         begin_file_io(batch, request);
+         if(request->status == PLATFORM_IO_PENDING)
+         {
+            if(request->contents.length == 0)
+            {
+               end_file_io(batch, request, true);
+            }
+            else
+            {
+               pending[pending_count++] = index;
+            }
+         }
+      }
+   }
+
+   if(pending_count == 0)
+   {
+      return(true);
+   }
+
+   unix_io_state *state = mmap(0, sizeof(*state), PROT_READ|PROT_WRITE, MAP_ANONYMOUS|MAP_PRIVATE, -1, 0);
+   if(state == MAP_FAILED)
+   {
+      for(u32 index = 0; index < pending_count; ++index)
+      {
+         end_file_io(batch, batch->requests + pending[index], false);
+      }
+      return(false);
+   }
+   batch->platform = state;
+   state->batch = batch;
+
+#if PLATFORM_IO_URING
+   if(!io_uring_unavailable)
+   {
+      state->uses_ring = create_io_ring(state);
+      io_uring_unavailable = !state->uses_ring;
+   }
+
+   if(state->uses_ring)
+   {
+      for(u32 index = 0; index < pending_count; ++index)
+      {
+         queue_ring_transfer(state, batch, pending[index]);
+      }
+      enter_io_ring(state, 0);
+
+      return(true);
+   }
+#endif
+
+   pthread_mutex_init(&state->mutex, 0);
+   pthread_cond_init(&state->finished, 0);
+
+   state->queued_count = pending_count;
+   memcpy(state->queued, pending, pending_count * sizeof(u32));
+
+   // NOTE: Every worker takes requests until none are left, so it's fine for
+   // fewer of them to start than were asked for.
+   u32 worker_count = MINIMUM(pending_count, PLATFORM_IO_WORKER_COUNT);
+   for(u32 index = 0; index < worker_count; ++index)
+   {
+      if(pthread_create(state->workers + state->worker_count, 0, io_worker, state) == 0)
+      {
+         state->worker_count++;
+      }
+   }
+
+   if(state->worker_count == 0)
+   {
+      // NOTE: No threads to be had, so do the work right here.
+      io_worker(state);
+   }
+
+   return(true);
+}
+
+PLATFORM_POLL_IO(platform_poll_io)
+{
+   unix_io_state *state = (unix_io_state *)batch->platform;
+   if(!state)
+   {
+      return(batch->outstanding);
+   }
+
+#if PLATFORM_IO_URING
+   if(state->uses_ring)
+   {
+      u32 finished = 0;
+      do
+      {
+         finished += reap_io_ring(state, batch);
+         if(wait && !finished && batch->outstanding)
+         {
+            enter_io_ring(state, 1);
+         }
+         else if(state->unsubmitted)
+         {
+            enter_io_ring(state, 0);
+         }
+      } while(wait && !finished && batch->outstanding);
+   }
+#endif
+   if(!state->uses_ring)
+   {
+      pthread_mutex_lock(&state->mutex);
+      while(wait && state->done_index == state->done_count)
+      {
+         pthread_cond_wait(&state->finished, &state->mutex);
+      }
+      while(state->done_index < state->done_count)
+      {
+         u32 index = state->done[state->done_index++];
+         end_file_io(batch, batch->requests + index, state->succeeded[index]);
+      }
+      pthread_mutex_unlock(&state->mutex);
+   }
+
+   if(batch->outstanding == 0)
+   {
+      destroy_io_state(batch);
+   }
+
+   return(batch->outstanding);
+}
+
+// NOTE: Jobs. Every thread that runs or waits on jobs owns a Chase-Lev deque:
+// the owner pushes and pops jobs at the bottom without contention, while idle
+// threads steal from the top of someone else's. Workers that find nothing to
+// do after a short spin sleep on a futex that changes whenever jobs are queued,
+// and waiters sleep on the counter itself, which is woken when it reaches zero.
+// Deques are never freed, so jobs left behind by a thread that exits are still
+// stolen by the others.
+#define JOB_DEQUE_SIZE 4096
+#define JOB_DEQUE_MAXIMUM 256
+#define JOB_WORKER_MAXIMUM 64
+#define JOB_SPIN_COUNT 64
+#define JOB_WAIT_TIMEOUT_NS 1000000
+
+typedef struct {
+   // NOTE: top is changed by thieves and bottom only by the owner, so they're
+   // kept on separate cache lines.
+   s64 top;
+   u8 top_padding[64 - sizeof(s64)];
+   s64 bottom;
+   u8 bottom_padding[64 - sizeof(s64)];
+   job *jobs[JOB_DEQUE_SIZE];
+} job_deque;
+
+global job_deque *job_deques[JOB_DEQUE_MAXIMUM];
+global u32 job_deque_count;
+global THREAD_LOCAL job_deque *job_thread_deque;
+global THREAD_LOCAL u32 job_thread_random;
+
+global pthread_once_t job_once = PTHREAD_ONCE_INIT;
+global u32 job_worker_count;
+global u32 job_signal;
+global u32 job_sleepers;
+
+#if !defined(__linux__)
+global pthread_mutex_t job_wait_mutex = PTHREAD_MUTEX_INITIALIZER;
+global pthread_cond_t job_wait = PTHREAD_COND_INITIALIZER;
+#endif
+
+function void wait_on_address(u32 *address, u32 expected, s64 timeout_ns)
+{
+   // NOTE: Sleep while the value at address is still expected, for at most
+   // timeout_ns if it's non-zero. Spurious returns are allowed, so callers
+   // check their condition again in a loop.
+#if defined(__linux__)
+   struct timespec timeout = {timeout_ns / 1000000000, timeout_ns % 1000000000};
+   syscall(SYS_futex, address, FUTEX_WAIT_PRIVATE, expected, (timeout_ns) ? &timeout : 0, 0, 0);
+#else
+   pthread_mutex_lock(&job_wait_mutex);
+   if(__atomic_load_n(address, __ATOMIC_ACQUIRE) == expected)
+   {
+      if(timeout_ns)
+      {
+         struct timespec deadline;
+         clock_gettime(CLOCK_REALTIME, &deadline);
+         deadline.tv_nsec += timeout_ns;
+         deadline.tv_sec += deadline.tv_nsec / 1000000000L;
+         deadline.tv_nsec %= 1000000000L;
+         pthread_cond_timedwait(&job_wait, &job_wait_mutex, &deadline);
+      }
+      else
+      {
+         pthread_cond_wait(&job_wait, &job_wait_mutex);
+      }
+   }
+   pthread_mutex_unlock(&job_wait_mutex);
+#endif
+}
+
+function void wake_address(u32 *address, u32 count)
+{
+#if defined(__linux__)
+   syscall(SYS_futex, address, FUTEX_WAKE_PRIVATE, MINIMUM(count, 0x7FFFFFFF), 0, 0, 0);
+#else
+   (void)address;
+   (void)count;
+
+   pthread_mutex_lock(&job_wait_mutex);
+   pthread_cond_broadcast(&job_wait);
+   pthread_mutex_unlock(&job_wait_mutex);
+#endif
+}
+
+function job_deque *get_job_deque(void)
+{
+   // NOTE: Threads register a deque the first time they touch the job system.
+   // Once every slot is taken, further threads get none and run their jobs
+   // inline instead.
+   job_deque *result = job_thread_deque;
+   if(!result)
+   {
+      u32 index = __atomic_fetch_add(&job_deque_count, 1, __ATOMIC_RELAXED);
+      if(index < JOB_DEQUE_MAXIMUM)
+      {
+         void *memory = mmap(0, sizeof(job_deque), PROT_READ|PROT_WRITE, MAP_PRIVATE|MAP_ANONYMOUS, -1, 0);
+         if(memory != MAP_FAILED)
+         {
+            result = (job_deque *)memory;
+            job_thread_deque = result;
+            job_thread_random = (index * 2654435761u) | 1;
+            __atomic_store_n(job_deques + index, result, __ATOMIC_RELEASE);
+         }
+      }
+   }
+
+   return(result);
+}
+
+function b32 push_job(job_deque *deque, job *j)
+{
+   b32 result = false;
+
+   s64 bottom = __atomic_load_n(&deque->bottom, __ATOMIC_RELAXED);
+   s64 top = __atomic_load_n(&deque->top, __ATOMIC_ACQUIRE);
+   if(bottom - top < JOB_DEQUE_SIZE)
+   {
+      __atomic_store_n(deque->jobs + (bottom & (JOB_DEQUE_SIZE - 1)), j, __ATOMIC_RELAXED);
+      __atomic_store_n(&deque->bottom, bottom + 1, __ATOMIC_RELEASE);
+      result = true;
+   }
+
+   return(result);
+}
+
+function job *pop_job(job_deque *deque)
+{
+   job *result = 0;
+
+   // NOTE: Claim the bottom slot before looking at top, so that a thief racing
+   // for the last job either sees it's gone or the two of them settle it with
+   // the compare-exchange below.
+   s64 bottom = __atomic_load_n(&deque->bottom, __ATOMIC_RELAXED) - 1;
+   __atomic_store_n(&deque->bottom, bottom, __ATOMIC_SEQ_CST);
+   s64 top = __atomic_load_n(&deque->top, __ATOMIC_SEQ_CST);
+
+   if(top <= bottom)
+   {
+      result = __atomic_load_n(deque->jobs + (bottom & (JOB_DEQUE_SIZE - 1)), __ATOMIC_RELAXED);
+      if(top == bottom)
+      {
+         if(!__atomic_compare_exchange_n(&deque->top, &top, top + 1, false, __ATOMIC_SEQ_CST, __ATOMIC_RELAXED))
+         {
+            result = 0;
+         }
+         __atomic_store_n(&deque->bottom, bottom + 1, __ATOMIC_RELAXED);
+      }
+   }
+   else
+   {
+      __atomic_store_n(&deque->bottom, bottom + 1, __ATOMIC_RELAXED);
+   }
+
+   return(result);
+}
+
+function job *steal_job(job_deque *deque)
+{
+   job *result = 0;
+
+   s64 top = __atomic_load_n(&deque->top, __ATOMIC_SEQ_CST);
+   s64 bottom = __atomic_load_n(&deque->bottom, __ATOMIC_SEQ_CST);
+   if(top < bottom)
+   {
+      job *candidate = __atomic_load_n(deque->jobs + (top & (JOB_DEQUE_SIZE - 1)), __ATOMIC_RELAXED);
+      if(__atomic_compare_exchange_n(&deque->top, &top, top + 1, false, __ATOMIC_SEQ_CST, __ATOMIC_RELAXED))
+      {
+         result = candidate;
+      }
+   }
+
+   return(result);
+}
+
+function job *find_job(job_deque *own)
+{
+   // NOTE: Prefer our own most recent job, which is likely still in cache, and
+   // otherwise steal the oldest job from the other deques, starting at a random
+   // one so that thieves spread out.
+   job *result = (own) ? pop_job(own) : 0;
+   if(!result)
+   {
+      u32 count = MINIMUM(__atomic_load_n(&job_deque_count, __ATOMIC_ACQUIRE), JOB_DEQUE_MAXIMUM);
+      if(count)
+      {
+         job_thread_random ^= job_thread_random << 13;
+         job_thread_random ^= job_thread_random >> 17;
+         job_thread_random ^= job_thread_random << 5;
+
+         u32 start = job_thread_random % count;
+         for(u32 offset = 0; !result && offset < count; ++offset)
+         {
+            job_deque *victim = __atomic_load_n(job_deques + ((start + offset) % count), __ATOMIC_ACQUIRE);
+            if(victim && victim != own)
+            {
+               result = steal_job(victim);
+            }
+         }
+      }
+   }
+
+   return(result);
+}
+
+function void execute_job(job *j)
+{
+   // NOTE: The job may be freed as soon as its counter reaches zero, so don't
+   // touch it after the decrement.
+   job_counter *counter = j->counter;
+   j->procedure(j->data);
+
+   if(__atomic_sub_fetch(&counter->value, 1, __ATOMIC_ACQ_REL) == 0)
+   {
+      wake_address((u32 *)&counter->value, 0x7FFFFFFF);
+   }
+}
+
+function void *job_worker(void *parameter)
+{
+   (void)parameter;
+
+   job_deque *deque = get_job_deque();
+   for(;;)
+   {
+      // NOTE: Read the signal before looking for work, so that jobs queued
+      // after the search came up empty change it and the futex won't sleep.
+      u32 signal = __atomic_load_n(&job_signal, __ATOMIC_ACQUIRE);
+
+      job *j = 0;
+      for(u32 spin = 0; !j && spin < JOB_SPIN_COUNT; ++spin)
+      {
+         j = find_job(deque);
+      }
+
+      if(j)
+      {
+         execute_job(j);
+      }
+      else
+      {
+         __atomic_fetch_add(&job_sleepers, 1, __ATOMIC_SEQ_CST);
+         wait_on_address(&job_signal, signal, 0);
+         __atomic_fetch_sub(&job_sleepers, 1, __ATOMIC_SEQ_CST);
+      }
+   }
+
+   return(0);
+}
+
+function void initialize_jobs(void)
+{
+   // NOTE: The thread that submits jobs helps run them while it waits, so it
+   // takes the place of one worker.
+   long cores = sysconf(_SC_NPROCESSORS_ONLN);
+   u32 worker_count = (cores > 1) ? MINIMUM((u32)cores - 1, JOB_WORKER_MAXIMUM) : 0;
+
+   for(u32 index = 0; index < worker_count; ++index)
+   {
+      pthread_t worker;
+      if(pthread_create(&worker, 0, job_worker, 0) == 0)
+      {
+         pthread_detach(worker);
+         job_worker_count++;
+      }
+      else
+      {
+         log_warning("WARNING: Failed to create job worker %u.\n", index);
+         break;
+      }
+   }
+}
+
+PLATFORM_RUN_JOBS(platform_run_jobs)
+{
+   pthread_once(&job_once, initialize_jobs);
+
+   __atomic_add_fetch(&counter->value, (s32)count, __ATOMIC_RELAXED);
+
+   job_deque *deque = get_job_deque();
+   u32 pushed = 0;
+   for(; pushed < count; ++pushed)
+   {
+      jobs[pushed].counter = counter;
+      if(!deque || !push_job(deque, jobs + pushed))
+      {
+         break;
+      }
+   }
+
+   if(pushed)
+   {
+      __atomic_fetch_add(&job_signal, 1, __ATOMIC_SEQ_CST);
+      if(__atomic_load_n(&job_sleepers, __ATOMIC_SEQ_CST))
+      {
+         wake_address(&job_signal, pushed);
+      }
+   }
+
+   // NOTE: Whatever didn't fit in the deque runs right away.
+   for(u32 index = pushed; index < count; ++index)
+   {
+      jobs[index].counter = counter;
+      execute_job(jobs + index);
+   }
+}
+
+PLATFORM_WAIT_FOR_COUNTER(platform_wait_for_counter)
+{
+   job_deque *deque = get_job_deque();
+
+   u32 spin = 0;
+   for(;;)
+   {
+      s32 value = __atomic_load_n(&counter->value, __ATOMIC_ACQUIRE);
+      if(value == 0)
+      {
+         break;
+      }
+
+      job *j = find_job(deque);
+      if(j)
+      {
+         execute_job(j);
+         spin = 0;
+      }
+      else if(++spin >= JOB_SPIN_COUNT)
+      {
+         // NOTE: A steal can lose a race without the job having run yet, so
+         // don't sleep for long before looking again.
+         wait_on_address((u32 *)&counter->value, (u32)value, JOB_WAIT_TIMEOUT_NS);
+         spin = 0;
+      }
+   }
+}
+
+PLATFORM_GET_THREAD_COUNT(platform_get_thread_count)
+{
+   pthread_once(&job_once, initialize_jobs);
 
+   u32 result = job_worker_count + 1;
    return(result);
 }
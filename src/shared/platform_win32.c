@@ -10,7 +10,7 @@
 
 EXTERN_C PLATFORM_LOG(platform_log)
 {
-#if DEVELOPMENT_BUILD
+#if PLATFORM_LOG_LEVEL <= LOG_LEVEL_INFO
    char message[1024];
 
    va_list arguments;
@@ -26,12 +26,50 @@ EXTERN_C PLATFORM_LOG(platform_log)
 #endif
 }
 
+EXTERN_C PLATFORM_LOG_MESSAGE(platform_log_message)
+{
+   (void)level;
+
+   char message[1024];
+
+   va_list arguments;
+   va_start(arguments, format);
+   {
+      vsnprintf(message, sizeof(message), format, arguments);
+   }
+   va_end(arguments);
+
+   OutputDebugStringA(message);
+}
+
+EXTERN_C PLATFORM_FLUSH_LOG(platform_flush_log)
+{
+   // NOTE: OutputDebugString is synchronous, so there's nothing to flush.
+}
+
 EXTERN_C PLATFORM_ALLOCATE(platform_allocate)
 {
    void *result = VirtualAlloc(0, s, MEM_COMMIT|MEM_RESERVE, PAGE_READWRITE);
    return(result);
 }
 
+EXTERN_C PLATFORM_RESERVE(platform_reserve)
+{
+   void *result = VirtualAlloc(0, s, MEM_RESERVE, PAGE_NOACCESS);
+   return(result);
+}
+
+EXTERN_C PLATFORM_COMMIT(platform_commit)
+{
+   b32 result = (VirtualAlloc(address, s, MEM_COMMIT, PAGE_READWRITE) != 0);
+   return(result);
+}
+
+EXTERN_C PLATFORM_DECOMMIT(platform_decommit)
+{
+   VirtualFree(address, s, MEM_DECOMMIT);
+}
+
 PLATFORM_LOAD_FILE(platform_load_file)
 {
    s8 result = s8("");
@@ -40,7 +78,7 @@ PLATFORM_LOAD_FILE(platform_load_file)
    HANDLE find_file = FindFirstFileA(path, &file_data);
    if(find_file == INVALID_HANDLE_VALUE)
    {
-      platform_log("WARNING: Failed to find file \"%s\".\n", path);
+      log_warning("WARNING: Failed to find file \"%s\".\n", path);
       return(result);
    }
    FindClose(find_file);
@@ -54,7 +92,7 @@ PLATFORM_LOAD_FILE(platform_load_file)
    result.data = arena_allocate(a, u8, length + 1);
    if(!result.data)
    {
-      platform_log("ERROR: Failed to allocate memory for file \"%s\".\n", path);
+      log_error("ERROR: Failed to allocate memory for file \"%s\".\n", path);
       arena_marker_restore(marker);
 
       return(result);
@@ -73,7 +111,7 @@ PLATFORM_LOAD_FILE(platform_load_file)
    }
    else
    {
-      platform_log("ERROR: Failed to read file \"%s.\"\n", path);
+      log_error("ERROR: Failed to read file \"%s.\"\n", path);
       arena_marker_restore(marker);
    }
    CloseHandle(file);
@@ -81,6 +119,65 @@ PLATFORM_LOAD_FILE(platform_load_file)
    return(result);
 }
 
+EXTERN_C PLATFORM_MAP_FILE(platform_map_file)
+{
+   mapped_file result = {0};
+   result.contents = string8("");
+
+   HANDLE file = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, 0, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, 0);
+   if(file == INVALID_HANDLE_VALUE)
+   {
+      log_error("ERROR: Failed to open file \"%s\".\n", path);
+      return(result);
+   }
+
+   SYSTEM_INFO system_information;
+   GetSystemInfo(&system_information);
+   size page_size = system_information.dwPageSize;
+
+   // NOTE: Views are zero filled past the end of the file up to the end of its
+   // last page. Files that end exactly on a page boundary have no zero byte to
+   // spare, so those are read instead.
+   LARGE_INTEGER file_size;
+   if(GetFileSizeEx(file, &file_size) && file_size.QuadPart > 0 && (file_size.QuadPart % page_size) != 0)
+   {
+      HANDLE mapping = CreateFileMappingA(file, 0, PAGE_READONLY, 0, 0, 0);
+      if(mapping)
+      {
+         u8 *view = (u8 *)MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+         if(view)
+         {
+            result.contents.data = view;
+            result.contents.length = (size)file_size.QuadPart;
+            result.mapping = view;
+            result.mapping_size = (size)file_size.QuadPart;
+         }
+
+         // NOTE: The view keeps the mapping object alive on its own.
+         CloseHandle(mapping);
+      }
+   }
+   CloseHandle(file);
+
+   if(!result.mapping)
+   {
+      result.contents = platform_load_file(a, path);
+   }
+
+   return(result);
+}
+
+EXTERN_C PLATFORM_UNMAP_FILE(platform_unmap_file)
+{
+   if(file->mapping)
+   {
+      UnmapViewOfFile(file->mapping);
+   }
+
+   mapped_file cleared = {0};
+   *file = cleared;
+}
+
 PLATFORM_SAVE_FILE(platform_save_file)
 {
    bool result = false;
@@ -94,7 +191,7 @@ PLATFORM_SAVE_FILE(platform_save_file)
       result = (success && (s == (size)bytes_written));
       if(!result)
       {
-         platform_log("ERROR: Failed to write file \"%s.\"\n", path);
+         log_error("ERROR: Failed to write file \"%s.\"\n", path);
       }
 
       CloseHandle(file);
@@ -102,3 +199,442 @@ PLATFORM_SAVE_FILE(platform_save_file)
 
    return(result);
 }
+
+// NOTE: Asynchronous I/O. Files are opened for overlapped access on the
+// calling thread, and every file in a batch is associated with one I/O
+// completion port, keyed by its request index. ReadFile and WriteFile take
+// 32-bit lengths, so transfers are issued in chunks, with the next one going
+// out as each completes.
+#define WIN32_IO_CHUNK_SIZE MEGABYTES(64)
+
+typedef struct {
+   HANDLE port;
+   OVERLAPPED overlapped[PLATFORM_IO_BATCH_COUNT];
+} win32_io_state;
+
+function void begin_file_io(platform_io_batch *batch, platform_io_request *request)
+{
+   b32 load = (request->type == PLATFORM_IO_LOAD);
+
+   HANDLE file = (load)
+      ? CreateFileA(request->path, GENERIC_READ, FILE_SHARE_READ, 0, OPEN_EXISTING, FILE_FLAG_OVERLAPPED|FILE_FLAG_SEQUENTIAL_SCAN, 0)
+      : CreateFileA(request->path, GENERIC_WRITE, 0, 0, CREATE_ALWAYS, FILE_FLAG_OVERLAPPED, 0);
+   if(file == INVALID_HANDLE_VALUE)
+   {
+      log_error("ERROR: Failed to open file \"%s\".\n", request->path);
+      request->status = PLATFORM_IO_FAILED;
+      return;
+   }
+
+   if(load)
+   {
+      LARGE_INTEGER file_size;
+      u8 *data = 0;
+      if(GetFileSizeEx(file, &file_size))
+      {
+         data = arena_allocate(batch->a, u8, (size)file_size.QuadPart + 1);
+      }
+
+      if(!data)
+      {
+         log_error("ERROR: Failed to allocate memory for file \"%s\".\n", request->path);
+         request->status = PLATFORM_IO_FAILED;
+         CloseHandle(file);
+         return;
+      }
+
+      request->contents.data = data;
+      request->contents.length = (size)file_size.QuadPart;
+   }
+
+   request->handle = (intptr_t)file;
+   request->transferred = 0;
+   request->status = PLATFORM_IO_PENDING;
+   batch->outstanding++;
+}
+
+function void end_file_io(platform_io_batch *batch, platform_io_request *request, b32 success)
+{
+   CloseHandle((HANDLE)request->handle);
+   request->handle = -1;
+
+   if(request->type == PLATFORM_IO_LOAD)
+   {
+      // NOTE: A load that stops short at the end of the file keeps whatever
+      // was read, in case the file was truncated after it was opened.
+      request->contents.length = request->transferred;
+      request->contents.data[request->transferred] = 0;
+   }
+
+   if(success)
+   {
+      request->status = PLATFORM_IO_COMPLETE;
+   }
+   else
+   {
+      log_error("ERROR: Failed to %s file \"%s\".\n", (request->type == PLATFORM_IO_LOAD) ? "read" : "write", request->path);
+      request->status = PLATFORM_IO_FAILED;
+   }
+
+   batch->outstanding--;
+}
+
+function void issue_file_transfer(win32_io_state *state, platform_io_batch *batch, u32 index)
+{
+   // NOTE: Also used to issue the rest of a chunked or short transfer.
+   platform_io_request *request = batch->requests + index;
+
+   OVERLAPPED *overlapped = state->overlapped + index;
+   zero_memory(overlapped, sizeof(*overlapped));
+   overlapped->Offset = (DWORD)((u64)request->transferred & 0xFFFFFFFF);
+   overlapped->OffsetHigh = (DWORD)((u64)request->transferred >> 32);
+
+   HANDLE file = (HANDLE)request->handle;
+   u8 *data = request->contents.data + request->transferred;
+   DWORD length = (DWORD)MINIMUM(request->contents.length - request->transferred, WIN32_IO_CHUNK_SIZE);
+
+   BOOL started = (request->type == PLATFORM_IO_LOAD)
+      ? ReadFile(file, data, length, 0, overlapped)
+      : WriteFile(file, data, length, 0, overlapped);
+
+   // NOTE: Transfers that finish right away still post a completion packet, so
+   // only outright failures are handled here. Reading past the end of a file
+   // that shrank since it was opened isn't one.
+   DWORD error = (started) ? ERROR_SUCCESS : GetLastError();
+   if(error != ERROR_SUCCESS && error != ERROR_IO_PENDING)
+   {
+      end_file_io(batch, request, (request->type == PLATFORM_IO_LOAD && error == ERROR_HANDLE_EOF));
+   }
+}
+
+function void destroy_io_state(platform_io_batch *batch)
+{
+   win32_io_state *state = (win32_io_state *)batch->platform;
+
+   CloseHandle(state->port);
+   VirtualFree(state, 0, MEM_RELEASE);
+   batch->platform = 0;
+}
+
+EXTERN_C PLATFORM_SUBMIT_IO(platform_submit_io)
+{
+   assert(!batch->platform);
+
+   u32 pending[PLATFORM_IO_BATCH_COUNT];
+   u32 pending_count = 0;
+
+   for(u32 index = 0; index < batch->count; ++index)
+   {
+      platform_io_request *request = batch->requests + index;
+      if(request->status == PLATFORM_IO_QUEUED)
+      {
+         begin_file_io(batch, request);
+         if(request->status == PLATFORM_IO_PENDING)
+         {
+            if(request->contents.length == 0)
+            {
+               end_file_io(batch, request, true);
+            }
+            else
+            {
+               pending[pending_count++] = index;
+            }
+         }
+      }
+   }
+
+   if(pending_count == 0)
+   {
+      return(true);
+   }
+
+   win32_io_state *state = (win32_io_state *)VirtualAlloc(0, sizeof(*state), MEM_RESERVE|MEM_COMMIT, PAGE_READWRITE);
+   HANDLE port = (state) ? CreateIoCompletionPort(INVALID_HANDLE_VALUE, 0, 0, 1) : 0;
+   if(!port)
+   {
+      if(state)
+      {
+         VirtualFree(state, 0, MEM_RELEASE);
+      }
+      for(u32 index = 0; index < pending_count; ++index)
+      {
+         end_file_io(batch, batch->requests + pending[index], false);
+      }
+      return(false);
+   }
+   state->port = port;
+   batch->platform = state;
+
+   for(u32 index = 0; index < pending_count; ++index)
+   {
+      u32 request_index = pending[index];
+      platform_io_request *request = batch->requests + request_index;
+      if(CreateIoCompletionPort((HANDLE)request->handle, port, request_index, 0))
+      {
+         issue_file_transfer(state, batch, request_index);
+      }
+      else
+      {
+         end_file_io(batch, request, false);
+      }
+   }
+
+   if(batch->outstanding == 0)
+   {
+      destroy_io_state(batch);
+   }
+
+   return(true);
+}
+
+EXTERN_C PLATFORM_POLL_IO(platform_poll_io)
+{
+   win32_io_state *state = (win32_io_state *)batch->platform;
+   if(!state)
+   {
+      return(batch->outstanding);
+   }
+
+   // NOTE: Collect every completion that's already in, blocking for the first
+   // one only if asked to wait and nothing has finished yet.
+   u32 previous = batch->outstanding;
+   while(batch->outstanding)
+   {
+      DWORD timeout = (wait && batch->outstanding == previous) ? INFINITE : 0;
+
+      DWORD transferred = 0;
+      ULONG_PTR key = 0;
+      OVERLAPPED *overlapped = 0;
+      BOOL success = GetQueuedCompletionStatus(state->port, &transferred, &key, &overlapped, timeout);
+      if(!overlapped)
+      {
+         break;
+      }
+
+      platform_io_request *request = batch->requests + key;
+      b32 load = (request->type == PLATFORM_IO_LOAD);
+      if(!success)
+      {
+         end_file_io(batch, request, (load && GetLastError() == ERROR_HANDLE_EOF));
+      }
+      else if(transferred == 0)
+      {
+         end_file_io(batch, request, load);
+      }
+      else
+      {
+         request->transferred += transferred;
+         if(request->transferred < request->contents.length)
+         {
+            issue_file_transfer(state, batch, (u32)key);
+         }
+         else
+         {
+            end_file_io(batch, request, true);
+         }
+      }
+   }
+
+   if(batch->outstanding == 0)
+   {
+      destroy_io_state(batch);
+   }
+
+   return(batch->outstanding);
+}
+
+// NOTE: Jobs. These share a single queue guarded by a critical section, with
+// condition variables for workers waiting on new jobs and for waiters whose
+// counter hasn't reached zero yet. Waiters help run queued jobs in the
+// meantime, and only sleep when the queue is empty and the last of their jobs
+// is still running elsewhere.
+#define JOB_QUEUE_SIZE 4096
+#define JOB_WORKER_MAXIMUM 64
+
+typedef struct {
+   CRITICAL_SECTION lock;
+   CONDITION_VARIABLE queued;
+   CONDITION_VARIABLE finished;
+
+   u32 read_index;
+   u32 write_index;
+   job *jobs[JOB_QUEUE_SIZE];
+
+   u32 worker_count;
+} win32_job_queue;
+
+global INIT_ONCE job_once = INIT_ONCE_STATIC_INIT;
+global win32_job_queue job_queue;
+
+function job *pop_job(void)
+{
+   // NOTE: The job lock must be held by the caller.
+   job *result = 0;
+   if(job_queue.read_index != job_queue.write_index)
+   {
+      result = job_queue.jobs[job_queue.read_index++ & (JOB_QUEUE_SIZE - 1)];
+   }
+   return(result);
+}
+
+function void execute_job(job *j)
+{
+   // NOTE: The job may be freed as soon as its counter reaches zero, so don't
+   // touch it after the decrement.
+   job_counter *counter = j->counter;
+   j->procedure(j->data);
+
+   EnterCriticalSection(&job_queue.lock);
+   if(--counter->value == 0)
+   {
+      WakeAllConditionVariable(&job_queue.finished);
+   }
+   LeaveCriticalSection(&job_queue.lock);
+}
+
+function DWORD WINAPI job_worker(void *parameter)
+{
+   (void)parameter;
+
+   for(;;)
+   {
+      EnterCriticalSection(&job_queue.lock);
+      job *j = pop_job();
+      while(!j)
+      {
+         SleepConditionVariableCS(&job_queue.queued, &job_queue.lock, INFINITE);
+         j = pop_job();
+      }
+      LeaveCriticalSection(&job_queue.lock);
+
+      execute_job(j);
+   }
+
+   return(0);
+}
+
+function BOOL CALLBACK initialize_jobs(INIT_ONCE *once, void *parameter, void **context)
+{
+   (void)once;
+   (void)parameter;
+   (void)context;
+
+   InitializeCriticalSection(&job_queue.lock);
+   InitializeConditionVariable(&job_queue.queued);
+   InitializeConditionVariable(&job_queue.finished);
+
+   // NOTE: The thread that submits jobs helps run them while it waits, so it
+   // takes the place of one worker.
+   SYSTEM_INFO info;
+   GetSystemInfo(&info);
+   u32 cores = (u32)info.dwNumberOfProcessors;
+   u32 worker_count = (cores > 1) ? MINIMUM(cores - 1, JOB_WORKER_MAXIMUM) : 0;
+
+   for(u32 index = 0; index < worker_count; ++index)
+   {
+      HANDLE worker = CreateThread(0, 0, job_worker, 0, 0, 0);
+      if(worker)
+      {
+         CloseHandle(worker);
+         job_queue.worker_count++;
+      }
+      else
+      {
+         log_warning("WARNING: Failed to create job worker %u.\n", index);
+         break;
+      }
+   }
+
+   return(TRUE);
+}
+
+EXTERN_C PLATFORM_RUN_JOBS(platform_run_jobs)
+{
+   InitOnceExecuteOnce(&job_once, initialize_jobs, 0, 0);
+
+   EnterCriticalSection(&job_queue.lock);
+   counter->value += count;
+
+   u32 pushed = 0;
+   for(; pushed < count; ++pushed)
+   {
+      if(job_queue.write_index - job_queue.read_index == JOB_QUEUE_SIZE)
+      {
+         break;
+      }
+
+      jobs[pushed].counter = counter;
+      job_queue.jobs[job_queue.write_index++ & (JOB_QUEUE_SIZE - 1)] = jobs + pushed;
+   }
+   LeaveCriticalSection(&job_queue.lock);
+
+   if(pushed == 1)
+   {
+      WakeConditionVariable(&job_queue.queued);
+   }
+   else if(pushed > 1)
+   {
+      WakeAllConditionVariable(&job_queue.queued);
+   }
+
+   // NOTE: Whatever didn't fit in the queue runs right away.
+   for(u32 index = pushed; index < count; ++index)
+   {
+      jobs[index].counter = counter;
+      execute_job(jobs + index);
+   }
+}
+
+EXTERN_C PLATFORM_WAIT_FOR_COUNTER(platform_wait_for_counter)
+{
+   InitOnceExecuteOnce(&job_once, initialize_jobs, 0, 0);
+
+   EnterCriticalSection(&job_queue.lock);
+   while(counter->value != 0)
+   {
+      job *j = pop_job();
+      if(j)
+      {
+         LeaveCriticalSection(&job_queue.lock);
+         execute_job(j);
+         EnterCriticalSection(&job_queue.lock);
+      }
+      else
+      {
+         SleepConditionVariableCS(&job_queue.finished, &job_queue.lock, INFINITE);
+      }
+   }
+   LeaveCriticalSection(&job_queue.lock);
+}
+
+EXTERN_C PLATFORM_GET_THREAD_COUNT(platform_get_thread_count)
+{
+   InitOnceExecuteOnce(&job_once, initialize_jobs, 0, 0);
+
+   u32 result = job_queue.worker_count + 1;
+   return(result);
+}
+
+EXTERN_C PLATFORM_TIME_NS(platform_time_ns)
+{
+   LARGE_INTEGER frequency;
+   LARGE_INTEGER counter;
+   QueryPerformanceFrequency(&frequency);
+   QueryPerformanceCounter(&counter);
+
+   // NOTE: Split the conversion so the multiplication can't overflow.
+   u64 ticks = (u64)counter.QuadPart;
+   u64 rate = (u64)frequency.QuadPart;
+   u64 result = ((ticks / rate) * 1000000000ull) + (((ticks % rate) * 1000000000ull) / rate);
+
+   return(result);
+}
+
+// NOTE: Windows only exposes hardware counters to user code through ETW or a
+// kernel driver, so none are available on this platform. Callers fall back to
+// the clock and timestamp counter, as described in platform.h.
+EXTERN_C PLATFORM_READ_COUNTERS(platform_read_counters)
+{
+   zero_memory(counters, sizeof(*counters));
+   return(false);
+}
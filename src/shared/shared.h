@@ -18,6 +18,27 @@
 #define MAXIMUM(a, b) (((a) > (b)) ? (a) : (b))
 #define MINIMUM(a, b) (((a) < (b)) ? (a) : (b))
 
+// NOTE: The alignment of a type, as required when placing it in memory.
+#if defined(__cplusplus)
+#   define ALIGNOF(type) alignof(type)
+#elif defined(_MSC_VER)
+#   define ALIGNOF(type) __alignof(type)
+#else
+#   define ALIGNOF(type) _Alignof(type)
+#endif
+
+// NOTE: Thread-local storage. Freestanding builds have no threads, so there it's
+// just a plain global.
+#if defined(__STDC_HOSTED__) && (__STDC_HOSTED__ == 0)
+#   define THREAD_LOCAL
+#elif defined(__cplusplus)
+#   define THREAD_LOCAL thread_local
+#elif defined(_MSC_VER)
+#   define THREAD_LOCAL __declspec(thread)
+#else
+#   define THREAD_LOCAL _Thread_local
+#endif
+
 // NOTE: Technically these should be KIBI, MEBI, etc. Oh well :)
 #define KILOBYTES(v) ((v) * 1024LL)
 #define MEGABYTES(v) (KILOBYTES(v) * 1024LL)
@@ -91,20 +112,163 @@ typedef union {
    float elements[16];
 } mat4;
 
+// NOTE: Memory primitives. The bulk of a span is written a word at a time (or
+// a vector at a time where SSE2 is available), between byte-wise heads and
+// tails that bring the destination up to alignment. On x86, large spans use the
+// rep string instructions instead, which CPUs with enhanced rep movsb/stosb run
+// at full bandwidth without any alignment handling on our side.
+#if defined(__i386__) || defined(__x86_64__) || defined(_M_IX86) || defined(_M_X64)
+#   define MEMORY_REP_STRINGS 1
+#else
+#   define MEMORY_REP_STRINGS 0
+#endif
+#define MEMORY_REP_THRESHOLD 512
+
+#if defined(__SSE2__)
+#   include <emmintrin.h>
+#   define MEMORY_ALIGNMENT 16
+#else
+#   define MEMORY_ALIGNMENT sizeof(uintptr_t)
+#endif
+
+// NOTE: Word access to memory of any type has to be exempt from strict
+// aliasing. MSVC doesn't enforce it in the first place.
+#if defined(_MSC_VER)
+typedef uintptr_t memory_word;
+#else
+typedef uintptr_t __attribute__((may_alias)) memory_word;
+#endif
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
 function void zero_memory(void *address, size count)
 {
    u8 *bytes = (u8 *)address;
-   for(size index = 0; index < count; index++)
+
+#if MEMORY_REP_STRINGS
+   if(count >= MEMORY_REP_THRESHOLD)
+   {
+#   if defined(_MSC_VER)
+      __stosb(bytes, 0, count);
+#   else
+      __asm__ volatile("rep stosb" : "+D"(bytes), "+c"(count) : "a"(0) : "memory");
+#   endif
+      return;
+   }
+#endif
+
+   while(count > 0 && ((uintptr_t)bytes & (MEMORY_ALIGNMENT - 1)))
+   {
+      *bytes++ = 0;
+      count--;
+   }
+
+#if defined(__SSE2__)
+   __m128i zero = _mm_setzero_si128();
+   for(; count >= 16; count -= 16, bytes += 16)
+   {
+      _mm_store_si128((__m128i *)bytes, zero);
+   }
+#endif
+
+   for(; count >= (size)sizeof(memory_word); count -= sizeof(memory_word), bytes += sizeof(memory_word))
    {
-	  bytes[index] = 0;
+      *(memory_word *)bytes = 0;
    }
+
+   while(count > 0)
+   {
+      *bytes++ = 0;
+      count--;
+   }
+}
+
+// NOTE: Index of the lowest set bit. The value must not be zero.
+function u32 find_lowest_set_bit(u64 value)
+{
+#if defined(_MSC_VER)
+   unsigned long result;
+   _BitScanForward64(&result, value);
+   return((u32)result);
+#else
+   return((u32)__builtin_ctzll(value));
+#endif
+}
+
+// NOTE: Atomic operations on memory sizes, used by arenas shared between
+// threads. Only the atomicity of each operation is guaranteed, not any ordering
+// with the memory around it.
+function size atomic_add_size(size *pointer, size value)
+{
+   // NOTE: Returns the value from before the addition.
+#if defined(_MSC_VER)
+   size result = (size)_InterlockedExchangeAdd64((volatile __int64 *)pointer, value);
+#else
+   size result = __atomic_fetch_add(pointer, value, __ATOMIC_RELAXED);
+#endif
+
+   return(result);
 }
 
-// NOTE: A basic arena allocator.
+function b32 atomic_compare_exchange_size(size *pointer, size expected, size desired)
+{
+#if defined(_MSC_VER)
+   b32 result = (_InterlockedCompareExchange64((volatile __int64 *)pointer, desired, expected) == expected);
+#else
+   b32 result = __atomic_compare_exchange_n(pointer, &expected, desired, false, __ATOMIC_RELAXED, __ATOMIC_RELAXED);
+#endif
+
+   return(result);
+}
+
+function size atomic_load_size(size *pointer)
+{
+#if defined(_MSC_VER)
+   size result = *(volatile size *)pointer;
+#else
+   size result = __atomic_load_n(pointer, __ATOMIC_RELAXED);
+#endif
+
+   return(result);
+}
+
+function void atomic_maximum_size(size *pointer, size value)
+{
+   size current = atomic_load_size(pointer);
+   while(current < value && !atomic_compare_exchange_size(pointer, current, value))
+   {
+      current = atomic_load_size(pointer);
+   }
+}
+
+// NOTE: A basic arena allocator. An arena either wraps a fixed block of memory,
+// or reserves a large range of address space up front and commits it in
+// ARENA_COMMIT_CHUNK sized steps as allocations reach past the committed end.
+// Committing goes through hooks, so that this file doesn't depend on the
+// platform layer (see arena_reserve in platform.h).
+#define ARENA_COMMIT_CHUNK KILOBYTES(64)
+
+typedef b32 arena_commit_hook(void *address, size s);
+typedef void arena_decommit_hook(void *address, size s);
+
 typedef struct {
    u8 *base;
    size cap;
    size used;
+
+   // NOTE: Reserved arenas only have [base, base + committed) backed by memory.
+   // Fixed arenas are fully committed and have no hooks.
+   size committed;
+   arena_commit_hook *commit;
+   arena_decommit_hook *decommit;
+
+   // NOTE: Usage statistics, accumulated over the arena's lifetime. Resets and
+   // markers rewind used, but not these.
+   size high_water;
+   size allocation_count;
+   size padding;
 } arena;
 
 function void arena_initialize(arena *a, u8 *base, size cap)
@@ -112,20 +276,65 @@ function void arena_initialize(arena *a, u8 *base, size cap)
    a->base = base;
    a->cap = cap;
    a->used = 0;
+
+   a->committed = cap;
+   a->commit = 0;
+   a->decommit = 0;
+
+   a->high_water = 0;
+   a->allocation_count = 0;
+   a->padding = 0;
 }
 
-#define arena_allocate(a, type, count) (type *)arena_allocate_((a), sizeof(type), (count))
-#define arena_allocate_size(a, size) arena_allocate_((a), (size), 1)
+// NOTE: Typed allocations are aligned for their type. Untyped ones get the
+// default alignment, which suits any of the basic types, unless asked for
+// something stricter like a cache line.
+#define ARENA_DEFAULT_ALIGNMENT 16
+
+#define arena_allocate(a, type, count) (type *)arena_allocate_((a), sizeof(type), (count), ALIGNOF(type))
+#define arena_allocate_size(a, size) arena_allocate_((a), (size), 1, ARENA_DEFAULT_ALIGNMENT)
+#define arena_allocate_aligned(a, size, alignment) arena_allocate_((a), (size), 1, (alignment))
+
+function b32 arena_commit_to(arena *a, size end)
+{
+   // NOTE: Round up to whole chunks, so that a run of small allocations only
+   // occasionally calls into the platform layer.
+   b32 result = false;
+   if(a->commit)
+   {
+      size committed = MINIMUM((end + ARENA_COMMIT_CHUNK - 1) & ~(ARENA_COMMIT_CHUNK - 1), a->cap);
+      if(a->commit(a->base + a->committed, committed - a->committed))
+      {
+         a->committed = committed;
+         result = true;
+      }
+   }
+
+   return(result);
+}
 
-function void *arena_allocate_(arena *a, size unit_size, size count)
+function void *arena_allocate_(arena *a, size unit_size, size count, size alignment)
 {
+   // NOTE: The alignment must be a power of two. It applies to the address
+   // rather than the offset into the arena, so it holds regardless of how the
+   // base is aligned.
+   assert(alignment > 0 && (alignment & (alignment - 1)) == 0);
+
    void *result = 0;
 
-   size allocation_size = unit_size * count;
-   if((a->used + allocation_size) <= a->cap)
+   uintptr_t address = (uintptr_t)(a->base + a->used);
+   size padding = (size)((0 - address) & (uintptr_t)(alignment - 1));
+
+   size begin = a->used + padding;
+   size end = begin + (unit_size * count);
+   if(end <= a->cap && (end <= a->committed || arena_commit_to(a, end)))
    {
-      result = a->base + a->used;
-      a->used += allocation_size;
+      result = a->base + begin;
+      a->used = end;
+
+      a->high_water = MAXIMUM(a->high_water, end);
+      a->allocation_count++;
+      a->padding += padding;
    }
 
    return(result);
@@ -134,6 +343,63 @@ function void *arena_allocate_(arena *a, size unit_size, size count)
 function void arena_reset(arena *a)
 {
    a->used = 0;
+
+   // NOTE: Give back everything but the first chunk of a reserved arena. The
+   // first chunk stays committed, so that arenas reset in a loop don't pay for
+   // a round trip through the platform layer every time.
+   if(a->decommit && a->committed > ARENA_COMMIT_CHUNK)
+   {
+      a->decommit(a->base + ARENA_COMMIT_CHUNK, a->committed - ARENA_COMMIT_CHUNK);
+      a->committed = ARENA_COMMIT_CHUNK;
+   }
+}
+
+// NOTE: Allocation from an arena shared between threads. Each allocation is a
+// single fetch-add on used, so threads never wait on each other. Since the
+// final offset isn't known up front, the worst case padding for the alignment
+// is always reserved. Once the arena is exhausted, used is left past cap and
+// every later allocation fails until it's reset. Resetting, markers and the
+// single-threaded allocation functions must not race with shared allocation.
+#define arena_allocate_shared(a, type, count) (type *)arena_allocate_shared_((a), sizeof(type), (count), ALIGNOF(type))
+#define arena_allocate_shared_size(a, size) arena_allocate_shared_((a), (size), 1, ARENA_DEFAULT_ALIGNMENT)
+
+function void *arena_allocate_shared_(arena *a, size unit_size, size count, size alignment)
+{
+   assert(alignment > 0 && (alignment & (alignment - 1)) == 0);
+
+   void *result = 0;
+
+   size request = (unit_size * count) + (alignment - 1);
+   size begin = atomic_add_size(&a->used, request);
+   size end = begin + request;
+   if(end > a->cap)
+   {
+      return(result);
+   }
+
+   // NOTE: Threads that race past the committed end each commit the range they
+   // need. Committing already committed pages is harmless, so the only shared
+   // state to settle is the new committed size.
+   size committed = atomic_load_size(&a->committed);
+   if(end > committed)
+   {
+      size target = MINIMUM((end + ARENA_COMMIT_CHUNK - 1) & ~(ARENA_COMMIT_CHUNK - 1), a->cap);
+      if(!a->commit || !a->commit(a->base + committed, target - committed))
+      {
+         return(result);
+      }
+      atomic_maximum_size(&a->committed, target);
+   }
+
+   uintptr_t address = (uintptr_t)(a->base + begin);
+   size padding = (size)((0 - address) & (uintptr_t)(alignment - 1));
+   result = a->base + begin + padding;
+
+   atomic_maximum_size(&a->high_water, end);
+   atomic_add_size(&a->allocation_count, 1);
+   atomic_add_size(&a->padding, request - (unit_size * count));
+
+   return(result);
 }
 
 typedef struct {
@@ -199,20 +465,349 @@ function string8 string8allocate(arena *a, u8 *data, size length)
    return(result);
 }
 
+// NOTE: Little-endian loads from unaligned memory. Compilers fold the byte
+// shuffling back into single loads on targets that allow it.
+function u32 read_u32(u8 *data)
+{
+   u32 result = ((u32)data[0] <<  0) | ((u32)data[1] <<  8) |
+                ((u32)data[2] << 16) | ((u32)data[3] << 24);
+   return(result);
+}
+
+function u64 read_u64(u8 *data)
+{
+   u64 result = (u64)read_u32(data) | ((u64)read_u32(data + 4) << 32);
+   return(result);
+}
+
+// NOTE: Full 64x64->128 bit multiply, returning the low half in *a and the high
+// half in *b.
+function void multiply_u128(u64 *a, u64 *b)
+{
+#if defined(__SIZEOF_INT128__)
+   unsigned __int128 product = (unsigned __int128)*a * *b;
+   *a = (u64)product;
+   *b = (u64)(product >> 64);
+#elif defined(_MSC_VER) && defined(_M_X64)
+   *a = _umul128(*a, *b, b);
+#else
+   u64 ahigh = *a >> 32, alow = (u32)*a;
+   u64 bhigh = *b >> 32, blow = (u32)*b;
+
+   u64 hh = ahigh * bhigh;
+   u64 hl = ahigh * blow;
+   u64 lh = alow * bhigh;
+   u64 ll = alow * blow;
+
+   u64 middle = (ll >> 32) + (u32)hl + (u32)lh;
+   *a = (middle << 32) | (u32)ll;
+   *b = hh + (hl >> 32) + (lh >> 32) + (middle >> 32);
+#endif
+}
+
+function u64 hash_mix(u64 a, u64 b)
+{
+   multiply_u128(&a, &b);
+   return(a ^ b);
+}
+
+// NOTE: A 64-bit hash over arbitrary bytes, following wyhash: inputs up to 16
+// bytes are read as a few overlapping loads with no loop at all, and longer
+// inputs are consumed 48 bytes per iteration across three independent lanes.
+global u64 hash_secret[4] =
+{
+   0x2d358dccaa6c78a5ULL, 0x8bb84b93962eacc9ULL,
+   0x4b33a62ed433d4a3ULL, 0x4d5a2da51de1aa47ULL,
+};
+
+function u64 hash_memory(void *memory, size count, u64 seed)
+{
+   u8 *data = (u8 *)memory;
+   u64 a = 0;
+   u64 b = 0;
+
+   seed ^= hash_mix(seed ^ hash_secret[0], hash_secret[1]);
+
+   if(count <= 16)
+   {
+      if(count >= 4)
+      {
+         size offset = (count >> 3) << 2;
+         a = ((u64)read_u32(data) << 32) | read_u32(data + offset);
+         b = ((u64)read_u32(data + count - 4) << 32) | read_u32(data + count - 4 - offset);
+      }
+      else if(count > 0)
+      {
+         a = ((u64)data[0] << 16) | ((u64)data[count >> 1] << 8) | data[count - 1];
+      }
+   }
+   else
+   {
+      size remaining = count;
+      if(remaining >= 48)
+      {
+         u64 seed1 = seed;
+         u64 seed2 = seed;
+         do
+         {
+            seed  = hash_mix(read_u64(data +  0) ^ hash_secret[1], read_u64(data +  8) ^ seed);
+            seed1 = hash_mix(read_u64(data + 16) ^ hash_secret[2], read_u64(data + 24) ^ seed1);
+            seed2 = hash_mix(read_u64(data + 32) ^ hash_secret[3], read_u64(data + 40) ^ seed2);
+            data += 48;
+            remaining -= 48;
+         } while(remaining >= 48);
+
+         seed ^= seed1 ^ seed2;
+      }
+
+      while(remaining > 16)
+      {
+         seed = hash_mix(read_u64(data) ^ hash_secret[1], read_u64(data + 8) ^ seed);
+         data += 16;
+         remaining -= 16;
+      }
+
+      a = read_u64(data + remaining - 16);
+      b = read_u64(data + remaining - 8);
+   }
+
+   a ^= hash_secret[1];
+   b ^= seed;
+   multiply_u128(&a, &b);
+
+   u64 result = hash_mix(a ^ hash_secret[0] ^ (u64)count, b ^ hash_secret[1]);
+   return(result);
+}
+
+function u64 string8hash(string8 string)
+{
+   u64 result = hash_memory(string.data, string.length, 0);
+   return(result);
+}
+
+// NOTE: A string paired with its hash, for strings that are looked up or
+// compared often enough that hashing them once up front pays off.
+typedef struct {
+   string8 string;
+   u64 hash;
+} hashed_string8;
+
+function hashed_string8 string8hashed(string8 string)
+{
+   hashed_string8 result;
+   result.string = string;
+   result.hash = string8hash(string);
+
+   return(result);
+}
+
 function b32 string8equals(string8 a, string8 b)
 {
    if(a.length != b.length)
    {
       return(false);
    }
+   if(a.data == b.data)
+   {
+      return(true);
+   }
+
+   u8 *left = a.data;
+   u8 *right = b.data;
+   size count = a.length;
+
+   // NOTE: Spans of 16 bytes or more are compared in blocks, with the final
+   // block pulled back to overlap the previous one instead of handling a tail.
+   // Anything shorter is covered by two overlapping loads of the largest width
+   // that fits.
+#if defined(__SSE2__)
+   if(count >= 16)
+   {
+      for(size index = 0; index < count; index += 16)
+      {
+         size offset = MINIMUM(index, count - 16);
+         __m128i l = _mm_loadu_si128((__m128i *)(left + offset));
+         __m128i r = _mm_loadu_si128((__m128i *)(right + offset));
+         if(_mm_movemask_epi8(_mm_cmpeq_epi8(l, r)) != 0xffff)
+         {
+            return(false);
+         }
+      }
+      return(true);
+   }
+#else
+   if(count >= 16)
+   {
+      for(size index = 0; index < count; index += 8)
+      {
+         size offset = MINIMUM(index, count - 8);
+         if(read_u64(left + offset) != read_u64(right + offset))
+         {
+            return(false);
+         }
+      }
+      return(true);
+   }
+#endif
 
-   for(size index = 0; index < a.length; index++)
+   b32 result;
+   if(count >= 8)
    {
-      if(a.data[index] != b.data[index])
+      result = (read_u64(left) == read_u64(right) &&
+                read_u64(left + count - 8) == read_u64(right + count - 8));
+   }
+   else if(count >= 4)
+   {
+      result = (read_u32(left) == read_u32(right) &&
+                read_u32(left + count - 4) == read_u32(right + count - 4));
+   }
+   else
+   {
+      result = true;
+      for(size index = 0; index < count; index++)
       {
-         return(false);
+         result &= (left[index] == right[index]);
       }
    }
 
+   return(result);
+}
+
+function b32 hashed_string8equals(hashed_string8 a, hashed_string8 b)
+{
+   b32 result = (a.hash == b.hash && string8equals(a.string, b.string));
+   return(result);
+}
+
+// NOTE: String searching. Indices are returned relative to the start of the
+// searched string, or -1 if nothing was found.
+function size string8find_byte(string8 string, u8 byte)
+{
+   u8 *data = string.data;
+   size count = string.length;
+   size index = 0;
+
+#if defined(__SSE2__)
+   __m128i pattern = _mm_set1_epi8((char)byte);
+   for(; index + 16 <= count; index += 16)
+   {
+      __m128i block = _mm_loadu_si128((__m128i *)(data + index));
+      u32 mask = (u32)_mm_movemask_epi8(_mm_cmpeq_epi8(block, pattern));
+      if(mask)
+      {
+         return(index + find_lowest_set_bit(mask));
+      }
+   }
+#else
+   // NOTE: Skip whole words that can't contain the byte. A word contains it
+   // when xoring in the pattern leaves a zero byte.
+   u64 pattern = byte * 0x0101010101010101ULL;
+   for(; index + 8 <= count; index += 8)
+   {
+      u64 word = read_u64(data + index) ^ pattern;
+      if((word - 0x0101010101010101ULL) & ~word & 0x8080808080808080ULL)
+      {
+         break;
+      }
+   }
+#endif
+
+   for(; index < count; index++)
+   {
+      if(data[index] == byte)
+      {
+         return(index);
+      }
+   }
+
+   return(-1);
+}
+
+function size string8find(string8 string, string8 needle)
+{
+   if(needle.length == 0)
+   {
+      return(0);
+   }
+
+   // NOTE: Scan for the first byte of the needle, then check the rest of it
+   // wherever that lands.
+   size last = string.length - needle.length;
+   size index = 0;
+   while(index <= last)
+   {
+      string8 window = {string.data + index, last - index + 1};
+      size found = string8find_byte(window, needle.data[0]);
+      if(found < 0)
+      {
+         break;
+      }
+
+      index += found;
+      string8 candidate = {string.data + index, needle.length};
+      if(string8equals(candidate, needle))
+      {
+         return(index);
+      }
+      index++;
+   }
+
+   return(-1);
+}
+
+function b32 string8starts_with(string8 string, string8 prefix)
+{
+   b32 result = false;
+   if(string.length >= prefix.length)
+   {
+      string8 head = {string.data, prefix.length};
+      result = string8equals(head, prefix);
+   }
+
+   return(result);
+}
+
+// NOTE: Returns the bytes [begin, end) of string, with both ends clamped to
+// its length.
+function string8 string8slice(string8 string, size begin, size end)
+{
+   end = MINIMUM(MAXIMUM(end, 0), string.length);
+   begin = MINIMUM(MAXIMUM(begin, 0), end);
+
+   string8 result = {string.data + begin, end - begin};
+   return(result);
+}
+
+// NOTE: Splits the next token off the front of *remaining at delimiter,
+// without allocating. Tokens point into the original string. Returns false
+// once the final token has been handed out; the usual loop is:
+//
+//    string8 token;
+//    while(string8split(&remaining, ',', &token)) { ... }
+//
+// Consecutive delimiters produce empty tokens, and a string without any
+// delimiters produces itself.
+function b32 string8split(string8 *remaining, u8 delimiter, string8 *token)
+{
+   if(!remaining->data)
+   {
+      return(false);
+   }
+
+   size found = string8find_byte(*remaining, delimiter);
+   if(found < 0)
+   {
+      *token = *remaining;
+      remaining->data = 0;
+      remaining->length = 0;
+   }
+   else
+   {
+      token->data = remaining->data;
+      token->length = found;
+      remaining->data += found + 1;
+      remaining->length -= found + 1;
+   }
+
    return(true);
 }